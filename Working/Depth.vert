@@ -0,0 +1,11 @@
+#version 450
+
+layout (location = 0) in vec3 a_position;
+
+uniform mat4 u_viewProjection;
+uniform mat4 u_modelMatrix;
+
+void main()
+{
+	gl_Position = u_viewProjection * u_modelMatrix * vec4(a_position, 1);
+}
@@ -5,8 +5,16 @@ layout (location = 0) in vec3 a_position;
 uniform mat4 u_projectionMatrix;
 uniform mat4 u_viewMatrix;
 uniform mat4 u_modelMatrix;
+// indirect draws take the model matrix from the instance the culling pass kept
+uniform bool u_indirect;
+layout (location = 6) in uint a_instance;
+layout (std430, binding = 0) readonly buffer Transforms
+{
+	mat4 transforms[];
+};
 
 void main()
 {
-	gl_Position = (u_projectionMatrix * u_viewMatrix * u_modelMatrix) * vec4(a_position, 1);
+	mat4 modelMatrix = u_indirect ? transforms[a_instance] : u_modelMatrix;
+	gl_Position = (u_projectionMatrix * u_viewMatrix * modelMatrix) * vec4(a_position, 1);
 }
\ No newline at end of file
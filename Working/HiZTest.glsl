@@ -0,0 +1,38 @@
+// Hierarchical z test shared by Occlusion.comp and Cull.comp, pulled in with #include.
+// The including shader sets u_viewProjection and binds the pyramid OcclusionCulling builds.
+
+uniform mat4 u_viewProjection;
+uniform sampler2D u_pyramid;
+uniform int u_pyramidLevels;
+
+// the box is hidden when its nearest point is behind the farthest depth of every texel it covers
+bool Occluded(vec3 boundsMin, vec3 boundsMax)
+{
+	vec2 minUV = vec2(1.0);
+	vec2 maxUV = vec2(0.0);
+	float nearest = 1.0;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = mix(boundsMin, boundsMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+		vec4 clip = u_viewProjection * vec4(corner, 1.0);
+		// crossing the near plane, the projected rectangle means nothing
+		if (clip.w <= 0.0) return false;
+		vec3 ndc = clip.xyz / clip.w;
+		minUV = min(minUV, ndc.xy * 0.5 + 0.5);
+		maxUV = max(maxUV, ndc.xy * 0.5 + 0.5);
+		nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+	minUV = clamp(minUV, 0.0, 1.0);
+	maxUV = clamp(maxUV, 0.0, 1.0);
+
+	// the level where the rectangle spans at most two texels each way
+	ivec2 baseSize = textureSize(u_pyramid, 0);
+	vec2 size = (maxUV - minUV) * vec2(baseSize);
+	int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, u_pyramidLevels - 1);
+	ivec2 levelSize = max(baseSize >> level, ivec2(1));
+	ivec2 a = min(ivec2(minUV * vec2(levelSize)), levelSize - 1);
+	ivec2 b = min(ivec2(maxUV * vec2(levelSize)), levelSize - 1);
+	float farthest = max(max(texelFetch(u_pyramid, a, level).r, texelFetch(u_pyramid, ivec2(b.x, a.y), level).r),
+		max(texelFetch(u_pyramid, ivec2(a.x, b.y), level).r, texelFetch(u_pyramid, b, level).r));
+	return nearest > farthest;
+}
@@ -12,24 +12,125 @@ uniform sampler2D u_normalTexture;
 uniform sampler2D u_specularTexture;
 uniform vec3 u_tint;
 uniform vec3 u_cameraPos;
+uniform mat4 u_viewMatrix;
+
+// same grid as ClusteredLighting
+const ivec3 CLUSTER_GRID = ivec3(16, 9, 24);
+const int MAX_LIGHTS_PER_CLUSTER = 128;
+
+struct Light
+{
+	// xyz position, w range
+	vec4 position;
+	// rgb colour times intensity, w cosine of the spot's inner angle
+	vec4 color;
+	// xyz direction the light points, w cosine of the spot's outer angle
+	vec4 direction;
+	vec4 bounds;
+};
+
+layout (std430, binding = 7) readonly buffer Lights
+{
+	Light lights[];
+};
+
+layout (std430, binding = 8) readonly buffer Clusters
+{
+	uint clusters[];
+};
+
+uniform vec2 u_clusterDepth;
+uniform vec4 u_clusterViewport;
+uniform int u_directionalLights;
+
+// same cascade count as ShadowMaps, the first directional light is the one that casts
+const int SHADOW_CASCADES = 4;
+uniform sampler2DArrayShadow u_shadowMap;
+uniform mat4 u_shadowMatrices[SHADOW_CASCADES];
+// far end of each cascade in view depth
+uniform vec4 u_cascadeSplits;
+uniform vec4 u_cascadeTexelSizes;
+// 0 when there is no shadow casting light
+uniform int u_shadowCascades;
+
+vec3 Shade(vec3 radiance, vec3 toLight, vec3 normal, vec3 toCamera, vec3 kd, vec3 ks)
+{
+	float cosTheta = dot(normal, toLight);
+	vec3 ld = kd * radiance * max(0, cosTheta);
+
+	vec3 h = normalize(toCamera + toLight);
+	float spec = dot(normal, h);
+	// pow is exp2 of a log, keep it away from zero and the odd sample where h comes out degenerate
+	vec3 ls = spec > 0 ? ks * radiance * pow(spec, 150) : vec3(0);
+	return ld + ls;
+}
+
+float Shadow(vec3 normal, float depth)
+{
+	if (u_shadowCascades == 0 || depth > u_cascadeSplits[u_shadowCascades - 1]) return 1.0;
+	int cascade = 0;
+	while (depth > u_cascadeSplits[cascade]) cascade++;
+
+	// pushed out along the normal by about a texel so a surface does not shadow itself
+	vec3 position = v_modelPosition + normal * u_cascadeTexelSizes[cascade] * 1.5;
+	vec3 coord = (u_shadowMatrices[cascade] * vec4(position, 1)).xyz * 0.5 + 0.5;
+	// casters were clamped onto the near plane, so a receiver past it is lit by nothing in front
+	coord.z = min(coord.z, 1.0);
+	vec2 texel = 1.0 / vec2(textureSize(u_shadowMap, 0).xy);
+	float lit = 0;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			lit += texture(u_shadowMap, vec4(coord.xy + vec2(x, y) * texel, cascade, coord.z));
+		}
+	}
+	return lit / 9.0;
+}
+
+vec3 ShadeLocal(Light light, vec3 normal, vec3 toCamera, vec3 kd, vec3 ks)
+{
+	vec3 offset = light.position.xyz - v_modelPosition;
+	float d2 = dot(offset, offset);
+	// froxels are coarse, plenty of the lights listed in one are out of reach of this fragment
+	float ratio = d2 / (light.position.w * light.position.w);
+	if (ratio >= 1.0) return vec3(0);
+	vec3 toLight = offset * inversesqrt(max(d2, 1e-8));
+	// inverse square, windowed so it reaches zero at the range the clusters were built with
+	float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+	float falloff = window * window / max(d2, 1e-4);
+	// spot cone, point lights carry cosines that make this one everywhere
+	float cone = clamp((dot(-toLight, light.direction.xyz) - light.direction.w) / (light.color.w - light.direction.w), 0.0, 1.0);
+	return Shade(light.color.rgb * falloff * cone * cone, toLight, normal, toCamera, kd, ks);
+}
 
 void main()
 {
 	vec4 normalTap = texture(u_normalTexture, v_uv);
 	vec3 mapNormal = normalTap.xyz * 2 - 1;
 	vec3 normal = u_hasNormal ? normalize(vec4(v_tbn * mapNormal, 0)).xyz : v_tbn[2];
-	vec3 lightPos = vec3(0, 3, 5);
 	vec3 kd = texture(u_diffuseTexture, v_uv).xyz;
 	vec3 ks = texture(u_specularTexture, v_uv).xyz;
-	
-	vec3 toLight = normalize(lightPos - v_modelPosition);
-	float d2 = dot(lightPos - v_modelPosition, lightPos - v_modelPosition); 
-	float cosTheta = dot(normal, toLight);
-	vec3 ld = kd * (50 / d2) * max(0, cosTheta);
-
 	vec3 toCamera = normalize(u_cameraPos - v_modelPosition);
-	vec3 h = normalize(toCamera + toLight);
-	float spec = dot(normal, h);
-	vec3 ls = ks * (50 / d2) * pow(max(0, spec), 150);
-	f_color = vec4(u_tint, 1) * vec4(ld + ls, 1);
-}
\ No newline at end of file
+
+	float depth = -(u_viewMatrix * vec4(v_modelPosition, 1)).z;
+
+	vec3 color = vec3(0);
+	for (int i = 0; i < u_directionalLights; i++)
+	{
+		float shadow = i == 0 ? Shadow(normal, depth) : 1.0;
+		color += shadow * Shade(lights[i].color.rgb, -lights[i].direction.xyz, normal, toCamera, kd, ks);
+	}
+
+	// the froxel this fragment falls in, slices are exponential in view depth
+	ivec2 tile = ivec2((gl_FragCoord.xy - u_clusterViewport.xy) / u_clusterViewport.zw * vec2(CLUSTER_GRID.xy));
+	int slice = int(floor(log(depth / u_clusterDepth.x) / log(u_clusterDepth.y / u_clusterDepth.x) * float(CLUSTER_GRID.z)));
+	ivec3 cell = clamp(ivec3(tile, slice), ivec3(0), CLUSTER_GRID - 1);
+	uint base = uint(cell.x + CLUSTER_GRID.x * (cell.y + CLUSTER_GRID.y * cell.z)) * uint(MAX_LIGHTS_PER_CLUSTER + 1);
+	uint count = clusters[base];
+	for (uint i = 0u; i < count; i++)
+	{
+		color += ShadeLocal(lights[clusters[base + 1u + i]], normal, toCamera, kd, ks);
+	}
+	f_color = vec4(u_tint, 1) * vec4(color, 1);
+}
@@ -10,6 +10,13 @@ layout (location = 5) in vec2 a_uv;
 uniform mat4 u_projectionMatrix;
 uniform mat4 u_viewMatrix;
 uniform mat4 u_modelMatrix;
+// indirect draws take the model matrix from the instance the culling pass kept
+uniform bool u_indirect;
+layout (location = 6) in uint a_instance;
+layout (std430, binding = 0) readonly buffer Transforms
+{
+    mat4 transforms[];
+};
 
 out vec2 v_uv;
 out mat3 v_tbn;
@@ -18,12 +25,13 @@ out vec3 v_modelPosition;
 
 void main()
 {
-    vec3 t = normalize(vec3(u_modelMatrix * vec4(a_tangent, 0.0)));
-    vec3 b = normalize(vec3(u_modelMatrix * vec4(a_bitangent, 0.0)));
-    vec3 n = normalize(vec3(transpose(inverse(u_modelMatrix)) * vec4(a_normal, 0.0)));
+    mat4 modelMatrix = u_indirect ? transforms[a_instance] : u_modelMatrix;
+    vec3 t = normalize(vec3(modelMatrix * vec4(a_tangent, 0.0)));
+    vec3 b = normalize(vec3(modelMatrix * vec4(a_bitangent, 0.0)));
+    vec3 n = normalize(vec3(transpose(inverse(modelMatrix)) * vec4(a_normal, 0.0)));
 
     v_tbn = mat3(t, b, n);
-    v_modelPosition = (u_modelMatrix * vec4(a_position, 1)).xyz;
+    v_modelPosition = (modelMatrix * vec4(a_position, 1)).xyz;
     v_uv = a_uv;    
-    gl_Position = (u_projectionMatrix * u_viewMatrix * u_modelMatrix) * vec4(a_position, 1);
+    gl_Position = (u_projectionMatrix * u_viewMatrix * modelMatrix) * vec4(a_position, 1);
 }
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include "AssetArchive.h"
+#include "AssetDatabase.h"
+#include "BinaryStream.h"
+#include "JobSystem.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+AssetArchive::~AssetArchive()
+{
+	Close();
+}
+
+bool AssetArchive::Open(std::string path)
+{
+	Close();
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	size = (size_t)fileSize.QuadPart;
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping) data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	file = open(path.c_str(), O_RDONLY);
+	if (file == -1) return false;
+	struct stat status;
+	fstat(file, &status);
+	size = (size_t)status.st_size;
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (view != MAP_FAILED)
+	{
+		data = (const char*)view;
+		// lookups jump around the file, read ahead would mostly fetch pages nobody asked for
+		madvise(view, size, MADV_RANDOM);
+	}
+#endif
+	if (!data)
+	{
+		std::cout << "Failed to map asset archive " << path << std::endl;
+		Close();
+		return false;
+	}
+
+	BinaryReader in(data, size);
+	uint32_t magic = in.Read<uint32_t>();
+	uint32_t version = in.Read<uint32_t>();
+	uint32_t count = in.Read<uint32_t>();
+	uint64_t tocOffset = in.Read<uint64_t>();
+	if (magic != Magic || version != Version || tocOffset > size)
+	{
+		std::cout << "Asset archive " << path << " is not supported" << std::endl;
+		Close();
+		return false;
+	}
+	in.Skip((size_t)tocOffset - in.offset);
+	entries.reserve(count);
+	for (uint32_t i = 0; i < count && in.ok; i++)
+	{
+		Entry entry;
+		entry.hash = in.Read<uint64_t>();
+		entry.offset = in.Read<uint64_t>();
+		entry.storedSize = in.Read<uint64_t>();
+		entry.size = in.Read<uint64_t>();
+		entry.compression = (Compression)in.Read<uint32_t>();
+		entry.path = in.ReadString();
+		if (entry.offset > size || entry.storedSize > size - entry.offset)
+		{
+			in.ok = false;
+			break;
+		}
+		entries.push_back(entry);
+	}
+	if (!in.ok)
+	{
+		std::cout << "Asset archive " << path << " is truncated" << std::endl;
+		Close();
+		return false;
+	}
+	std::cout << "Mapped asset archive " << path << " (" << entries.size() << " entries, " << size / 1024 << "KB)" << std::endl;
+	return true;
+}
+
+void AssetArchive::Close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data) munmap((void*)data, size);
+	if (file != -1) close(file);
+	file = -1;
+#endif
+	data = nullptr;
+	size = 0;
+	entries.clear();
+}
+
+std::string AssetArchive::Normalise(std::string path)
+{
+	return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+ArchiveSlice AssetArchive::Find(std::string path)
+{
+	std::string key = Normalise(path);
+	uint64_t hash = AssetDatabase::Hash(key.data(), key.size());
+	auto it = std::lower_bound(entries.begin(), entries.end(), hash, [](const Entry& entry, uint64_t hash) { return entry.hash < hash; });
+	for (; it != entries.end() && it->hash == hash; it++)
+	{
+		if (it->path != key) continue;
+		if (it->compression == Compression::None)
+		{
+			ArchiveSlice slice;
+			slice.data = data + it->offset;
+			slice.size = (size_t)it->size;
+			return slice;
+		}
+		return Inflate(*it);
+	}
+	return ArchiveSlice();
+}
+
+ArchiveSlice AssetArchive::Inflate(const Entry& entry)
+{
+	struct Block
+	{
+		const char* source;
+		size_t storedSize;
+		size_t offset;
+		size_t size;
+	};
+	BinaryReader in(data + entry.offset, (size_t)entry.storedSize);
+	uint32_t blockCount = in.Read<uint32_t>();
+	std::vector<Block> blocks;
+	size_t offset = 0;
+	for (uint32_t i = 0; i < blockCount && in.ok; i++)
+	{
+		Block block;
+		block.storedSize = in.Read<uint32_t>();
+		block.size = in.Read<uint32_t>();
+		block.offset = offset;
+		offset += block.size;
+		blocks.push_back(block);
+	}
+	for (auto& block : blocks)
+	{
+		block.source = in.Current();
+		in.Skip(block.storedSize);
+	}
+	if (!in.ok || offset != entry.size || entry.compression != Compression::LZ4)
+	{
+		std::cout << "Asset archive entry " << entry.path << " is corrupt" << std::endl;
+		return ArchiveSlice();
+	}
+
+	ArchiveSlice slice;
+	slice.storage = std::make_shared<std::vector<char>>((size_t)entry.size);
+	char* output = slice.storage->data();
+	std::atomic<bool> ok = true;
+	JobSystem::GetSingleton().ParallelFor(blocks.size(), 1, [&](size_t i)
+		{
+			if (!DecompressBlock(blocks[i].source, blocks[i].storedSize, output + blocks[i].offset, blocks[i].size)) ok = false;
+		}
+	);
+	if (!ok)
+	{
+		std::cout << "Asset archive entry " << entry.path << " failed to decompress" << std::endl;
+		return ArchiveSlice();
+	}
+	slice.data = output;
+	slice.size = (size_t)entry.size;
+	return slice;
+}
+
+ArchiveSlice AssetArchive::FindPacked(std::string path)
+{
+	AssetArchive* archive = GetSingletonPtr();
+	if (!archive || !archive->data) return ArchiveSlice();
+	return archive->Find(path);
+}
+
+ArchiveSlice AssetArchive::Read(std::string path)
+{
+	ArchiveSlice slice = FindPacked(path);
+	if (slice) return slice;
+	return ReadFile(path);
+}
+
+ArchiveSlice AssetArchive::ReadFile(std::string path)
+{
+	ArchiveSlice slice;
+	std::ifstream fin(path, std::ios::binary | std::ios::ate);
+	if (!fin.is_open()) return slice;
+	slice.storage = std::make_shared<std::vector<char>>((size_t)fin.tellg());
+	fin.seekg(0);
+	fin.read(slice.storage->data(), slice.storage->size());
+	fin.close();
+	// an empty file still reads as found
+	static const char empty = 0;
+	slice.data = slice.storage->empty() ? &empty : slice.storage->data();
+	slice.size = slice.storage->size();
+	return slice;
+}
+
+bool AssetArchive::Build(std::string root, std::string output, bool compress)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::error_code error;
+	std::error_code outputError;
+	std::filesystem::path outputPath = std::filesystem::absolute(output, outputError);
+
+	// everything under the root goes in apart from editor and save side files
+	std::vector<std::string> paths;
+	for (auto it = std::filesystem::recursive_directory_iterator(root, error); it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		if (error) break;
+		if (!it->is_regular_file(error)) continue;
+		std::string extension = it->path().extension().string();
+		if (extension == ".tmp" || extension == ".journal" || extension == ".pak") continue;
+		if (it->path().filename() == "imgui.ini") continue;
+		if (std::filesystem::equivalent(it->path(), outputPath, outputError)) continue;
+		// a binary scene older than its yaml would shadow the newer edits
+		if (extension == ".bscene")
+		{
+			std::filesystem::path scenePath = it->path();
+			scenePath.replace_extension(".scene");
+			if (std::filesystem::exists(scenePath, error) && it->last_write_time(error) < std::filesystem::last_write_time(scenePath, error)) continue;
+		}
+		paths.push_back(Normalise(std::filesystem::relative(it->path(), root, error).generic_string()));
+	}
+	std::sort(paths.begin(), paths.end());
+
+	BinaryWriter out;
+	out.Write<uint32_t>(Magic);
+	out.Write<uint32_t>(Version);
+	out.Write<uint32_t>((uint32_t)paths.size());
+	size_t tocOffset = out.Reserve<uint64_t>();
+
+	std::vector<Entry> toc;
+	size_t totalSize = 0;
+	for (auto& path : paths)
+	{
+		ArchiveSlice file = ReadFile((std::filesystem::path(root) / path).string());
+		if (!file)
+		{
+			std::cout << "Failed to read " << path << ", leaving it out of the archive" << std::endl;
+			continue;
+		}
+		out.buffer.resize((out.Size() + Alignment - 1) / Alignment * Alignment);
+
+		Entry entry;
+		entry.path = path;
+		entry.hash = AssetDatabase::Hash(path.data(), path.size());
+		entry.offset = out.Size();
+		entry.size = file.size;
+		entry.compression = Compression::None;
+		totalSize += file.size;
+
+		std::vector<std::vector<char>> blocks;
+		if (compress && file.size > 0)
+		{
+			blocks.resize((file.size + BlockSize - 1) / BlockSize);
+			JobSystem::GetSingleton().ParallelFor(blocks.size(), 1, [&](size_t i)
+				{
+					size_t offset = i * BlockSize;
+					CompressBlock(file.data + offset, std::min(BlockSize, file.size - offset), blocks[i]);
+				}
+			);
+			size_t compressedSize = 0;
+			for (auto& block : blocks) compressedSize += block.size();
+			// not worth inflating at load time unless it saves at least an eighth
+			if (compressedSize < file.size - file.size / 8) entry.compression = Compression::LZ4;
+		}
+
+		if (entry.compression == Compression::LZ4)
+		{
+			out.Write<uint32_t>((uint32_t)blocks.size());
+			for (size_t i = 0; i < blocks.size(); i++)
+			{
+				out.Write<uint32_t>((uint32_t)blocks[i].size());
+				out.Write<uint32_t>((uint32_t)std::min(BlockSize, file.size - i * BlockSize));
+			}
+			for (auto& block : blocks)
+			{
+				out.WriteBytes(block.data(), block.size());
+			}
+		}
+		else
+		{
+			out.WriteBytes(file.data, file.size);
+		}
+		entry.storedSize = out.Size() - entry.offset;
+		toc.push_back(entry);
+	}
+
+	std::sort(toc.begin(), toc.end(), [](const Entry& a, const Entry& b) { return a.hash < b.hash; });
+	out.Patch<uint32_t>(sizeof(uint32_t) * 2, (uint32_t)toc.size());
+	out.Patch<uint64_t>(tocOffset, (uint64_t)out.Size());
+	for (auto& entry : toc)
+	{
+		out.Write<uint64_t>(entry.hash);
+		out.Write<uint64_t>(entry.offset);
+		out.Write<uint64_t>(entry.storedSize);
+		out.Write<uint64_t>(entry.size);
+		out.Write<uint32_t>((uint32_t)entry.compression);
+		out.WriteString(entry.path);
+	}
+
+	std::string tempPath = output + ".tmp";
+	std::ofstream fout(tempPath, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to write asset archive " << output << std::endl;
+		return false;
+	}
+	fout.write(out.buffer.data(), out.buffer.size());
+	fout.close();
+	if (fout.fail()) return false;
+	std::filesystem::rename(tempPath, output, error);
+	if (error)
+	{
+		std::cout << "Failed to replace " << output << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Packed " << toc.size() << " files into " << output << ": " << totalSize / 1024 << "KB -> " << out.Size() / 1024 << "KB in " << elapsed.count() << "ms" << std::endl;
+	return true;
+}
+
+static const size_t MinMatch = 4;
+// the format wants the last 5 bytes as literals and no match starting in the last 12
+static const size_t LastLiterals = 5;
+static const size_t MatchLimit = 12;
+static const int HashBits = 12;
+
+static uint32_t Read32(const char* source)
+{
+	uint32_t value;
+	std::memcpy(&value, source, sizeof(value));
+	return value;
+}
+
+static void WriteLength(std::vector<char>& output, size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		output.push_back((char)255);
+	}
+	output.push_back((char)length);
+}
+
+void AssetArchive::CompressBlock(const char* source, size_t size, std::vector<char>& output)
+{
+	output.clear();
+	output.reserve(size + size / 255 + 16);
+	std::vector<int32_t> table((size_t)1 << HashBits, -1);
+
+	size_t position = 0;
+	size_t anchor = 0;
+	while (size > MatchLimit && position < size - MatchLimit)
+	{
+		uint32_t sequence = Read32(source + position);
+		uint32_t hash = (sequence * 2654435761u) >> (32 - HashBits);
+		int32_t candidate = table[hash];
+		table[hash] = (int32_t)position;
+		if (candidate < 0 || position - candidate > 65535 || Read32(source + candidate) != sequence)
+		{
+			position++;
+			continue;
+		}
+
+		size_t matchLength = MinMatch;
+		while (position + matchLength < size - LastLiterals && source[candidate + matchLength] == source[position + matchLength])
+		{
+			matchLength++;
+		}
+
+		size_t literalLength = position - anchor;
+		size_t extraLength = matchLength - MinMatch;
+		output.push_back((char)((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(extraLength, 15)));
+		if (literalLength >= 15) WriteLength(output, literalLength - 15);
+		output.insert(output.end(), source + anchor, source + position);
+		uint16_t offset = (uint16_t)(position - candidate);
+		output.push_back((char)(offset & 0xFF));
+		output.push_back((char)(offset >> 8));
+		if (extraLength >= 15) WriteLength(output, extraLength - 15);
+
+		position += matchLength;
+		anchor = position;
+	}
+
+	size_t literalLength = size - anchor;
+	output.push_back((char)(std::min<size_t>(literalLength, 15) << 4));
+	if (literalLength >= 15) WriteLength(output, literalLength - 15);
+	output.insert(output.end(), source + anchor, source + size);
+}
+
+bool AssetArchive::DecompressBlock(const char* source, size_t size, char* output, size_t outputSize)
+{
+	const unsigned char* in = (const unsigned char*)source;
+	const unsigned char* end = in + size;
+	size_t written = 0;
+	auto readLength = [&](size_t& length)
+	{
+		unsigned char byte;
+		do
+		{
+			if (in >= end) return false;
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	};
+
+	while (in < end)
+	{
+		unsigned char token = *in++;
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(literalLength)) return false;
+		if (literalLength > (size_t)(end - in) || literalLength > outputSize - written) return false;
+		std::memcpy(output + written, in, literalLength);
+		in += literalLength;
+		written += literalLength;
+		// the last sequence has literals only
+		if (in == end) break;
+
+		if (end - in < 2) return false;
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > written) return false;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(matchLength)) return false;
+		matchLength += MinMatch;
+		if (matchLength > outputSize - written) return false;
+		// matches may overlap their own output, copied a byte at a time
+		char* destination = output + written;
+		const char* match = destination - offset;
+		for (size_t i = 0; i < matchLength; i++)
+		{
+			destination[i] = match[i];
+		}
+		written += matchLength;
+	}
+	return written == outputSize;
+}
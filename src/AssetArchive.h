@@ -0,0 +1,85 @@
+#pragma once
+#include "Singleton.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Bytes of one archive entry. Stored entries point straight into the mapped
+// archive, compressed ones own the inflated copy.
+struct ArchiveSlice
+{
+	const char* data = nullptr;
+	size_t size = 0;
+	std::shared_ptr<std::vector<char>> storage;
+
+	explicit operator bool() const { return data != nullptr; }
+};
+
+/*
+	Read-only pack of the asset files for shipping builds, written by --pack.
+	The archive is memory mapped and entries are found by a hash of their
+	relative path, so loading an asset touches only the pages it lives in.
+
+	.pak layout
+	  header   magic, version, entry count, toc offset (uint64)
+	  data     entries, each starting on an Alignment boundary
+	  toc      sorted by path hash: hash, offset, stored size, size, compression, path
+	A compressed entry is a block count, a table of (stored size, size) pairs and
+	the blocks themselves, each at most BlockSize before compression. Blocks of
+	one entry are inflated in parallel.
+*/
+class AssetArchive : public Singleton<AssetArchive>
+{
+public:
+	enum class Compression : uint32_t
+	{
+		None = 0,
+		LZ4 = 1,
+	};
+
+	static const uint32_t Magic = 0x4B415041; // "APAK"
+	static const uint32_t Version = 1;
+	static const size_t Alignment = 64;
+	static const size_t BlockSize = 64 << 10;
+
+	~AssetArchive();
+	bool Open(std::string path);
+	void Close();
+	ArchiveSlice Find(std::string path);
+	size_t GetEntryCount() const { return entries.size(); }
+
+	// entry from the open archive, empty if there is none or it is not packed
+	static ArchiveSlice FindPacked(std::string path);
+	// entry from the open archive, otherwise the loose file read into memory
+	static ArchiveSlice Read(std::string path);
+	static bool Build(std::string root, std::string output, bool compress);
+	static std::string Normalise(std::string path);
+
+	// LZ4 block format, output is readable by any LZ4 block decoder
+	static void CompressBlock(const char* source, size_t size, std::vector<char>& output);
+	static bool DecompressBlock(const char* source, size_t size, char* output, size_t outputSize);
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+		Compression compression;
+		std::string path;
+	};
+
+	ArchiveSlice Inflate(const Entry& entry);
+	static ArchiveSlice ReadFile(std::string path);
+
+	const char* data = nullptr;
+	size_t size = 0;
+	std::vector<Entry> entries;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
@@ -0,0 +1,410 @@
+#include "AssetDatabase.h"
+#include "BinaryStream.h"
+#include "AssetArchive.h"
+#include "Shader.h"
+#include "components/Serialiser.h"
+#include "YAMLUtil.h"
+#include "yaml-cpp/yaml.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+
+bool AssetDatabase::Open(std::string indexPath, std::string root)
+{
+	this->indexPath = indexPath;
+	this->root = root;
+	// a packed index describes the packed files, there is nothing on disk to scan
+	if (AssetArchive::FindPacked(indexPath))
+	{
+		bool read = ReadIndex();
+		BuildLookup();
+		return read;
+	}
+	ReadIndex();
+	return Refresh();
+}
+
+bool AssetDatabase::GetType(std::string extension, ResourceManager::ResourceType& type)
+{
+	static const std::unordered_map<std::string, ResourceManager::ResourceType> types = {
+		{ ".texture", ResourceManager::ResourceType::Texture },
+		{ ".shader", ResourceManager::ResourceType::Shader },
+		{ ".material", ResourceManager::ResourceType::BaseMaterial },
+		{ ".mi", ResourceManager::ResourceType::Material },
+		{ ".mesh", ResourceManager::ResourceType::Mesh },
+		{ ".model", ResourceManager::ResourceType::Model },
+	};
+	auto it = types.find(extension);
+	if (it == types.end()) return false;
+	type = it->second;
+	return true;
+}
+
+uint64_t AssetDatabase::Hash(const char* data, size_t size)
+{
+	// 64 bit FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool AssetDatabase::ReadIndex()
+{
+	records.clear();
+	ArchiveSlice file = AssetArchive::Read(indexPath);
+	if (!file) return false;
+
+	BinaryReader in(file.data, file.size);
+	if (in.Read<uint32_t>() != Magic || in.Read<uint32_t>() != Version)
+	{
+		std::cout << "Asset index " << indexPath << " is out of date, rebuilding" << std::endl;
+		return false;
+	}
+	uint32_t count = in.Read<uint32_t>();
+	for (uint32_t i = 0; i < count && in.ok; i++)
+	{
+		AssetRecord record;
+		record.uuid = in.ReadString();
+		record.type = (ResourceManager::ResourceType)in.Read<uint32_t>();
+		record.path = in.ReadString();
+		record.hash = in.Read<uint64_t>();
+		record.size = in.Read<uint64_t>();
+		record.writeTime = in.Read<int64_t>();
+		uint32_t dependencyCount = in.Read<uint32_t>();
+		for (uint32_t d = 0; d < dependencyCount && in.ok; d++)
+		{
+			record.dependencies.push_back(in.ReadString());
+		}
+		record.bounds.min = in.Read<glm::vec3>();
+		record.bounds.max = in.Read<glm::vec3>();
+		records.push_back(record);
+	}
+	if (!in.ok)
+	{
+		std::cout << "Asset index " << indexPath << " is truncated, rebuilding" << std::endl;
+		records.clear();
+		return false;
+	}
+	return true;
+}
+
+bool AssetDatabase::Save()
+{
+	BinaryWriter out;
+	out.Write<uint32_t>(Magic);
+	out.Write<uint32_t>(Version);
+	out.Write<uint32_t>((uint32_t)records.size());
+	for (auto& record : records)
+	{
+		out.WriteString(record.uuid);
+		out.Write<uint32_t>((uint32_t)record.type);
+		out.WriteString(record.path);
+		out.Write<uint64_t>(record.hash);
+		out.Write<uint64_t>(record.size);
+		out.Write<int64_t>(record.writeTime);
+		out.Write<uint32_t>((uint32_t)record.dependencies.size());
+		for (auto& dependency : record.dependencies)
+		{
+			out.WriteString(dependency);
+		}
+		out.Write<glm::vec3>(record.bounds.min);
+		out.Write<glm::vec3>(record.bounds.max);
+	}
+
+	std::ofstream fout(indexPath, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to write asset index " << indexPath << std::endl;
+		return false;
+	}
+	fout.write(out.buffer.data(), out.buffer.size());
+	fout.close();
+	return !fout.fail();
+}
+
+bool AssetDatabase::Refresh()
+{
+	auto start = std::chrono::steady_clock::now();
+	std::unordered_map<std::string, size_t> byPath;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		byPath[records[i].path] = i;
+	}
+
+	// a file whose size and write time match the index is trusted without opening it
+	std::vector<AssetRecord> found;
+	int scanned = 0;
+	bool changed = false;
+	std::error_code error;
+	for (auto it = std::filesystem::recursive_directory_iterator(root, error); it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		if (error) break;
+		if (!it->is_regular_file(error)) continue;
+		ResourceManager::ResourceType type;
+		if (!GetType(it->path().extension().string(), type)) continue;
+
+		AssetRecord record;
+		record.type = type;
+		record.path = std::filesystem::relative(it->path(), root, error).generic_string();
+		record.size = it->file_size(error);
+		record.writeTime = it->last_write_time(error).time_since_epoch().count();
+
+		auto existing = byPath.find(record.path);
+		if (existing != byPath.end())
+		{
+			AssetRecord& old = records[existing->second];
+			if (old.size == record.size && old.writeTime == record.writeTime && old.type == record.type)
+			{
+				found.push_back(old);
+				continue;
+			}
+		}
+		if (!ScanAsset(record)) continue;
+		scanned++;
+		changed = true;
+		found.push_back(record);
+	}
+	changed |= found.size() != records.size();
+
+	// stable order so the index only changes on disk when the assets do
+	std::sort(found.begin(), found.end(), [](const AssetRecord& a, const AssetRecord& b) { return a.path < b.path; });
+	records = found;
+	BuildLookup();
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Asset database: " << records.size() << " assets, " << scanned << " rescanned in " << elapsed.count() << "ms" << std::endl;
+	return changed ? Save() : true;
+}
+
+void AssetDatabase::BuildLookup()
+{
+	lookup.clear();
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if (lookup.find(records[i].uuid) != lookup.end())
+		{
+			std::cout << "Duplicate asset uuid " << records[i].uuid << " in " << records[i].path << std::endl;
+			continue;
+		}
+		lookup[records[i].uuid] = i;
+	}
+}
+
+bool AssetDatabase::ScanAsset(AssetRecord& record)
+{
+	std::string path = (std::filesystem::path(root) / record.path).string();
+	std::ifstream fin(path, std::ios::binary);
+	if (!fin.is_open()) return false;
+	std::string contents((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+	fin.close();
+
+	// an older mesh gets its levels of detail written once here, rather than simplified on every load
+	if (record.type == ResourceManager::ResourceType::Mesh && contents.find("\nLODs:") == std::string::npos && MeshSerialiser::AddLods(path))
+	{
+		fin.open(path, std::ios::binary);
+		if (!fin.is_open()) return false;
+		contents.assign((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		fin.close();
+		std::error_code error;
+		record.size = contents.size();
+		record.writeTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	}
+	record.hash = Hash(contents.data(), contents.size());
+
+	// meshes have no references and are large, only their header is looked at
+	if (record.type == ResourceManager::ResourceType::Mesh)
+	{
+		size_t begin = contents.find("\nUUID:");
+		if (begin == std::string::npos) return false;
+		begin += 6;
+		size_t end = contents.find('\n', begin);
+		record.uuid = contents.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+		record.uuid.erase(0, record.uuid.find_first_not_of(" \t"));
+		record.uuid.erase(record.uuid.find_last_not_of(" \t\r") + 1);
+
+		// older files have no bounds line, those entities get a stand-in box until the mesh loads
+		size_t vertices = contents.find("\nVertices:");
+		begin = contents.find("\nBounds:");
+		if (begin != std::string::npos && begin < vertices)
+		{
+			begin += 8;
+			end = contents.find('\n', begin);
+			float values[6];
+			try
+			{
+				YAML::Node node = YAML::Load(contents.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+				if (YAMLUtil::ParseFlow(node, values, 6))
+				{
+					record.bounds = AABB(glm::vec3(values[0], values[1], values[2]), glm::vec3(values[3], values[4], values[5]));
+				}
+			}
+			catch (YAML::Exception& e)
+			{
+				std::cout << "Failed to parse the bounds of " << path << ": " << e.what() << std::endl;
+			}
+		}
+		return !record.uuid.empty();
+	}
+
+	YAML::Node file;
+	try
+	{
+		file = YAML::Load(contents);
+	}
+	catch (YAML::Exception& e)
+	{
+		std::cout << "Failed to parse asset " << path << ": " << e.what() << std::endl;
+		return false;
+	}
+	if (!file["UUID"]) return false;
+	record.uuid = file["UUID"].as<std::string>();
+
+	// any other uuid shaped scalar in the file is a reference to another asset
+	auto isUUID = [](const std::string& value)
+	{
+		if (value.size() != 36) return false;
+		for (int i = 0; i < 36; i++)
+		{
+			bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+			if (dash != (value[i] == '-')) return false;
+			if (!dash && !std::isxdigit((unsigned char)value[i])) return false;
+		}
+		return true;
+	};
+	std::function<void(const YAML::Node&)> collect = [&](const YAML::Node& node)
+	{
+		if (node.IsScalar())
+		{
+			const std::string& value = node.Scalar();
+			if (value != record.uuid && isUUID(value) &&
+				std::find(record.dependencies.begin(), record.dependencies.end(), value) == record.dependencies.end())
+			{
+				record.dependencies.push_back(value);
+			}
+		}
+		else if (node.IsSequence())
+		{
+			for (auto child : node) collect(child);
+		}
+		else if (node.IsMap())
+		{
+			for (auto child : node) collect(child.second);
+		}
+	};
+	collect(file);
+	return true;
+}
+
+const AssetRecord* AssetDatabase::Find(std::string uuid)
+{
+	auto it = lookup.find(uuid);
+	if (it == lookup.end()) return nullptr;
+	return &records[it->second];
+}
+
+bool AssetDatabase::GetBounds(std::string uuid, AABB& bounds)
+{
+	const AssetRecord* record = Find(uuid);
+	if (!record || !record->bounds.IsValid()) return false;
+	bounds = record->bounds;
+	return true;
+}
+
+std::vector<const AssetRecord*> AssetDatabase::GetRecords(ResourceManager::ResourceType type)
+{
+	std::vector<const AssetRecord*> result;
+	for (auto& record : records)
+	{
+		if (record.type == type) result.push_back(&record);
+	}
+	return result;
+}
+
+bool AssetDatabase::IsLoaded(const AssetRecord& record)
+{
+	ResourceManager& resources = ResourceManager::GetSingleton();
+	switch (record.type)
+	{
+	case ResourceManager::ResourceType::Texture:
+		return resources.GetResourceIndex(record.uuid, resources.textures) != -1;
+	case ResourceManager::ResourceType::Shader:
+		return resources.GetResourceIndex(record.uuid, resources.shaders) != -1;
+	case ResourceManager::ResourceType::BaseMaterial:
+		return resources.GetResourceIndex(record.uuid, resources.materials) != -1;
+	case ResourceManager::ResourceType::Material:
+		return resources.GetResourceIndex(record.uuid, resources.materialInstances) != -1;
+	case ResourceManager::ResourceType::Mesh:
+		return resources.GetResourceIndex(record.uuid, resources.meshes) != -1;
+	case ResourceManager::ResourceType::Model:
+		return resources.GetResourceIndex(record.uuid, resources.models) != -1;
+	default:
+		return false;
+	}
+}
+
+bool AssetDatabase::Load(std::string uuid)
+{
+	const AssetRecord* found = Find(uuid);
+	if (!found) return false;
+	// copied, loading dependencies below must not leave us holding a pointer into records
+	AssetRecord record = *found;
+	if (IsLoaded(record)) return true;
+	if (loading.find(uuid) != loading.end()) return false;
+	loading.insert(uuid);
+
+	for (auto& dependency : record.dependencies)
+	{
+		const AssetRecord* dependencyRecord = Find(dependency);
+		if (dependencyRecord && !IsLoaded(*dependencyRecord))
+		{
+			Load(dependency);
+		}
+	}
+
+	std::string path = (std::filesystem::path(root) / record.path).string();
+	switch (record.type)
+	{
+	case ResourceManager::ResourceType::Texture:
+		TextureSerialiser::Deserialise(path);
+		break;
+	case ResourceManager::ResourceType::Shader:
+	{
+		ShaderSerialiser::Deserialise(path);
+		// shaders that arrive after startup are linked right away
+		ResourceManager& resources = ResourceManager::GetSingleton();
+		int index = resources.GetResourceIndex(record.uuid, resources.shaders);
+		if (index != -1) resources.shaders[index]->Link();
+		break;
+	}
+	case ResourceManager::ResourceType::BaseMaterial:
+		MaterialSerialiser::Deserialise(path);
+		break;
+	case ResourceManager::ResourceType::Material:
+		MaterialInstanceSerialiser::Deserialise(path);
+		break;
+	case ResourceManager::ResourceType::Mesh:
+		MeshSerialiser::Deserialise(path);
+		break;
+	case ResourceManager::ResourceType::Model:
+		ModelSerialiser::Deserialise(path);
+		break;
+	default:
+		break;
+	}
+	loading.erase(uuid);
+	return IsLoaded(record);
+}
+
+void AssetDatabase::LoadAll(ResourceManager::ResourceType type)
+{
+	for (auto record : GetRecords(type))
+	{
+		Load(record->uuid);
+	}
+}
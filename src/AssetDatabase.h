@@ -0,0 +1,58 @@
+#pragma once
+#include "Singleton.h"
+#include "ResourceManager.h"
+#include "Bounds.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+struct AssetRecord
+{
+	std::string uuid;
+	ResourceManager::ResourceType type;
+	std::string path;
+	uint64_t hash = 0;
+	uint64_t size = 0;
+	int64_t writeTime = 0;
+	std::vector<std::string> dependencies;
+	// meshes only, read from the file's header so an entity can be bounded before the mesh is loaded
+	AABB bounds;
+};
+
+// Index of every asset file under the project folder, keyed by uuid. The index
+// is kept in a binary file so startup only stats the folder; asset files are
+// opened when they are new or changed, and loaded when something asks the
+// ResourceManager for their uuid.
+class AssetDatabase : public Singleton<AssetDatabase>
+{
+public:
+	static const uint32_t Magic = 0x49424441; // "ADBI"
+	static const uint32_t Version = 3;
+
+	bool Open(std::string indexPath, std::string root = ".");
+	bool Refresh();
+	bool Save();
+
+	bool Load(std::string uuid);
+	void LoadAll(ResourceManager::ResourceType type);
+	bool IsLoaded(const AssetRecord& record);
+	const AssetRecord* Find(std::string uuid);
+	// false when the asset is not indexed or its header has no bounds
+	bool GetBounds(std::string uuid, AABB& bounds);
+	std::vector<const AssetRecord*> GetRecords(ResourceManager::ResourceType type);
+
+	static bool GetType(std::string extension, ResourceManager::ResourceType& type);
+	static uint64_t Hash(const char* data, size_t size);
+private:
+	bool ReadIndex();
+	void BuildLookup();
+	bool ScanAsset(AssetRecord& record);
+
+	std::string indexPath;
+	std::string root;
+	std::vector<AssetRecord> records;
+	std::unordered_map<std::string, size_t> lookup;
+	// uuids being loaded right now, breaks dependency cycles
+	std::unordered_set<std::string> loading;
+};
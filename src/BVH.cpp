@@ -0,0 +1,363 @@
+#include "BVH.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+AABB BVH::Fatten(const AABB& bounds)
+{
+	glm::vec3 margin = (bounds.max - bounds.min) * FatFraction;
+	return AABB(bounds.min - margin, bounds.max + margin);
+}
+
+int BVH::AllocateNode()
+{
+	if (freeNodes.empty())
+	{
+		nodes.emplace_back();
+		return (int)nodes.size() - 1;
+	}
+	int node = freeNodes.back();
+	freeNodes.pop_back();
+	nodes[node] = Node();
+	return node;
+}
+
+void BVH::FreeNode(int node)
+{
+	nodes[node] = Node();
+	freeNodes.push_back(node);
+}
+
+int BVH::Insert(const AABB& bounds, Entity* entity)
+{
+	int leaf = AllocateNode();
+	nodes[leaf].bounds = Fatten(bounds);
+	nodes[leaf].objectBounds = bounds;
+	nodes[leaf].entity = entity;
+	InsertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void BVH::Remove(int leaf)
+{
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	leafCount--;
+}
+
+bool BVH::Move(int leaf, const AABB& bounds)
+{
+	nodes[leaf].objectBounds = bounds;
+	if (nodes[leaf].bounds.Contains(bounds)) return false;
+	RemoveLeaf(leaf);
+	nodes[leaf].bounds = Fatten(bounds);
+	InsertLeaf(leaf);
+	return true;
+}
+
+void BVH::Clear()
+{
+	nodes.clear();
+	freeNodes.clear();
+	root = NullNode;
+	leafCount = 0;
+}
+
+void BVH::InsertLeaf(int leaf)
+{
+	if (root == NullNode)
+	{
+		root = leaf;
+		nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	// walk down while pushing the leaf further is cheaper than pairing it here
+	AABB leafBounds = nodes[leaf].bounds;
+	int sibling = root;
+	while (!nodes[sibling].IsLeaf())
+	{
+		const Node& node = nodes[sibling];
+		float area = node.bounds.SurfaceArea();
+		float combinedArea = AABB::Union(node.bounds, leafBounds).SurfaceArea();
+		float cost = 2.0f * combinedArea;
+		// every ancestor below here grows by this much either way
+		float inheritance = 2.0f * (combinedArea - area);
+		auto childCost = [&](int child)
+		{
+			float grown = AABB::Union(nodes[child].bounds, leafBounds).SurfaceArea();
+			if (nodes[child].IsLeaf()) return grown + inheritance;
+			return grown - nodes[child].bounds.SurfaceArea() + inheritance;
+		};
+		float leftCost = childCost(node.left);
+		float rightCost = childCost(node.right);
+		if (cost < leftCost && cost < rightCost) break;
+		sibling = leftCost < rightCost ? node.left : node.right;
+	}
+
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].bounds = AABB::Union(leafBounds, nodes[sibling].bounds);
+	nodes[newParent].left = sibling;
+	nodes[newParent].right = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == NullNode)
+	{
+		root = newParent;
+		return;
+	}
+	if (nodes[oldParent].left == sibling) nodes[oldParent].left = newParent;
+	else nodes[oldParent].right = newParent;
+	Refit(oldParent);
+}
+
+void BVH::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = NullNode;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+	nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+	nodes[leaf].parent = NullNode;
+
+	if (grandParent == NullNode)
+	{
+		root = sibling;
+		return;
+	}
+	if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+	else nodes[grandParent].right = sibling;
+	Refit(grandParent);
+}
+
+void BVH::Refit(int node)
+{
+	while (node != NullNode)
+	{
+		nodes[node].bounds = AABB::Union(nodes[nodes[node].left].bounds, nodes[nodes[node].right].bounds);
+		node = nodes[node].parent;
+	}
+}
+
+void BVH::CollectLeaves(int node, std::vector<int>& leaves, std::vector<int>& internals) const
+{
+	std::vector<int> stack = { node };
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+		if (nodes[index].IsLeaf())
+		{
+			leaves.push_back(index);
+			continue;
+		}
+		internals.push_back(index);
+		stack.push_back(nodes[index].left);
+		stack.push_back(nodes[index].right);
+	}
+}
+
+void BVH::Rebuild()
+{
+	if (root == NullNode) return;
+	std::vector<int> leaves, internals;
+	leaves.reserve(leafCount);
+	internals.reserve(leafCount);
+	CollectLeaves(root, leaves, internals);
+	// a binary tree over n leaves always has n - 1 internal nodes, the rebuild reuses them
+	std::atomic<int> nextInternal = 0;
+	root = Build(leaves.data(), (int)leaves.size(), NullNode, internals.data(), nextInternal);
+}
+
+int BVH::Build(int* leaves, int count, int parent, const int* internals, std::atomic<int>& nextInternal)
+{
+	if (count == 1)
+	{
+		nodes[leaves[0]].parent = parent;
+		return leaves[0];
+	}
+
+	AABB centroids;
+	for (int i = 0; i < count; i++)
+	{
+		centroids.Grow(nodes[leaves[i]].bounds.GetCenter());
+	}
+	glm::vec3 size = centroids.max - centroids.min;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+	int middle = count / 2;
+	if (size[axis] > 0)
+	{
+		// bin the centroids along the widest axis and split where the SAH cost is lowest
+		AABB binBounds[SAHBins];
+		int binCounts[SAHBins] = {};
+		float scale = SAHBins / size[axis];
+		auto binOf = [&](int leaf)
+		{
+			int bin = (int)((nodes[leaf].bounds.GetCenter()[axis] - centroids.min[axis]) * scale);
+			return std::min(bin, SAHBins - 1);
+		};
+		for (int i = 0; i < count; i++)
+		{
+			int bin = binOf(leaves[i]);
+			binBounds[bin].Grow(nodes[leaves[i]].bounds);
+			binCounts[bin]++;
+		}
+
+		float rightAreas[SAHBins];
+		AABB right;
+		for (int i = SAHBins - 1; i > 0; i--)
+		{
+			right.Grow(binBounds[i]);
+			rightAreas[i] = right.IsValid() ? right.SurfaceArea() : 0.0f;
+		}
+		float bestCost = FLT_MAX;
+		int bestSplit = 1;
+		AABB left;
+		int leftCount = 0;
+		for (int i = 1; i < SAHBins; i++)
+		{
+			left.Grow(binBounds[i - 1]);
+			leftCount += binCounts[i - 1];
+			if (leftCount == 0 || leftCount == count) continue;
+			float cost = left.SurfaceArea() * leftCount + rightAreas[i] * (count - leftCount);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+		middle = (int)(std::partition(leaves, leaves + count, [&](int leaf) { return binOf(leaf) < bestSplit; }) - leaves);
+	}
+	// every centroid in the same place, any even split is as good as another
+	if (middle == 0 || middle == count)
+	{
+		middle = count / 2;
+	}
+
+	int node = internals[nextInternal++];
+	nodes[node].parent = parent;
+	nodes[node].entity = nullptr;
+	int leftChild, rightChild;
+	if (count > ParallelBuildSize)
+	{
+		JobSystem& jobs = JobSystem::GetSingleton();
+		JobSystem::Counter leftBuilt;
+		jobs.Run([&]() { leftChild = Build(leaves, middle, node, internals, nextInternal); }, &leftBuilt);
+		rightChild = Build(leaves + middle, count - middle, node, internals, nextInternal);
+		jobs.Wait(leftBuilt);
+	}
+	else
+	{
+		leftChild = Build(leaves, middle, node, internals, nextInternal);
+		rightChild = Build(leaves + middle, count - middle, node, internals, nextInternal);
+	}
+	nodes[node].left = leftChild;
+	nodes[node].right = rightChild;
+	nodes[node].bounds = AABB::Union(nodes[leftChild].bounds, nodes[rightChild].bounds);
+	return node;
+}
+
+void BVH::AddSubtree(int node, std::vector<Entity*>& result) const
+{
+	std::vector<int> stack = { node };
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+		if (nodes[index].IsLeaf())
+		{
+			result.push_back(nodes[index].entity);
+			continue;
+		}
+		stack.push_back(nodes[index].left);
+		stack.push_back(nodes[index].right);
+	}
+}
+
+void BVH::QueryFrustum(const Frustum& frustum, std::vector<Entity*>& result) const
+{
+	if (root == NullNode) return;
+	std::vector<int> stack = { root };
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+		if (node.IsLeaf())
+		{
+			if (frustum.Test(node.objectBounds) != Frustum::Result::Outside) result.push_back(node.entity);
+			continue;
+		}
+		Frustum::Result test = frustum.Test(node.bounds);
+		if (test == Frustum::Result::Outside) continue;
+		// nothing below a node fully inside can be culled, skip the plane tests
+		if (test == Frustum::Result::Inside)
+		{
+			AddSubtree(index, result);
+			continue;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+}
+
+void BVH::QueryAABB(const AABB& bounds, std::vector<Entity*>& result) const
+{
+	if (root == NullNode) return;
+	std::vector<int> stack = { root };
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+		if (!node.bounds.Intersects(bounds)) continue;
+		if (node.IsLeaf())
+		{
+			if (node.objectBounds.Intersects(bounds)) result.push_back(node.entity);
+			continue;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+}
+
+Entity* BVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
+{
+	Entity* hit = nullptr;
+	if (root == NullNode) return hit;
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float closest = maxDistance;
+	std::vector<int> stack = { root };
+	while (!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+		float enter;
+		// closest shrinks as hits come in, boxes further away are skipped
+		if (!node.bounds.Raycast(origin, inverseDirection, closest, enter)) continue;
+		if (node.IsLeaf())
+		{
+			if (node.objectBounds.Raycast(origin, inverseDirection, closest, enter) && enter < closest)
+			{
+				closest = enter;
+				hit = node.entity;
+			}
+			continue;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+	distance = closest;
+	return hit;
+}
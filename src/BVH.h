@@ -0,0 +1,73 @@
+#pragma once
+#include "Bounds.h"
+#include <vector>
+#include <atomic>
+
+class Entity;
+
+/*
+	Dynamic bounding volume hierarchy over entity bounds. Leaves store a fat box
+	around the real bounds, so small moves only refit the leaf's ancestors when
+	the object leaves its fat box. Leaves are inserted next to the sibling that
+	grows the total surface area least. After large edits Rebuild recreates all
+	internal nodes with a binned SAH split, large subtrees on worker threads.
+	Leaf ids stay the same across a rebuild.
+*/
+class BVH
+{
+public:
+	static const int NullNode = -1;
+	// fat boxes grow by this fraction of their size on each side
+	static constexpr float FatFraction = 0.1f;
+	static const int SAHBins = 12;
+	// subtrees with more leaves than this build their halves as separate jobs
+	static const int ParallelBuildSize = 2048;
+
+	int Insert(const AABB& bounds, Entity* entity);
+	void Remove(int leaf);
+	// true when the leaf left its fat box and was reinserted
+	bool Move(int leaf, const AABB& bounds);
+	void Rebuild();
+	void Clear();
+
+	void QueryFrustum(const Frustum& frustum, std::vector<Entity*>& result) const;
+	void QueryAABB(const AABB& bounds, std::vector<Entity*>& result) const;
+	// closest entity whose box the ray enters, nullptr if none within maxDistance
+	Entity* Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+	int GetLeafCount() const { return leafCount; }
+	// fattened bounds around every leaf, invalid when the tree is empty
+	AABB GetRootBounds() const { return root == NullNode ? AABB() : nodes[root].bounds; }
+	// exact bounds and entity of a leaf, nullptr for an id that is no longer a leaf
+	const AABB& GetBounds(int leaf) const { return nodes[leaf].objectBounds; }
+	Entity* GetEntity(int leaf) const { return leaf >= 0 && leaf < (int)nodes.size() ? nodes[leaf].entity : nullptr; }
+private:
+	struct Node
+	{
+		// fat box for leaves, union of the children for internal nodes
+		AABB bounds;
+		// exact box of the entity, only set on leaves
+		AABB objectBounds;
+		int parent = NullNode;
+		int left = NullNode;
+		int right = NullNode;
+		Entity* entity = nullptr;
+
+		bool IsLeaf() const { return left == NullNode; }
+	};
+
+	int AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void Refit(int node);
+	void CollectLeaves(int node, std::vector<int>& leaves, std::vector<int>& internals) const;
+	void AddSubtree(int node, std::vector<Entity*>& result) const;
+	int Build(int* leaves, int count, int parent, const int* internals, std::atomic<int>& nextInternal);
+	static AABB Fatten(const AABB& bounds);
+
+	std::vector<Node> nodes;
+	std::vector<int> freeNodes;
+	int root = NullNode;
+	int leafCount = 0;
+};
@@ -0,0 +1,476 @@
+#include "Benchmark.h"
+#include "OpenGLRenderer.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+#include "Util.h"
+#include "components/Scene.h"
+#include "yaml-cpp/yaml.h"
+#include "YAMLUtil.h"
+#include "components/Serialiser.h"
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <cmath>
+#include <thread>
+
+Benchmark::Benchmark(BenchmarkSettings settings) : settings(settings)
+{
+	if (!settings.cameraPath.empty())
+	{
+		path = LoadCameraPath(settings.cameraPath);
+	}
+	if (path.size() < 2)
+	{
+		path = DefaultCameraPath();
+	}
+}
+
+bool Benchmark::Run(std::shared_ptr<Scene> scene, GLFWwindow* window)
+{
+	if (!scene) return false;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	Profiler& profiler = Profiler::GetSingleton();
+
+	renderer.camera.aspect = (float)settings.width / settings.height;
+	scene->gpuDriven = settings.gpuCulling;
+	scene->occlusion.enabled = settings.occlusion;
+	scene->occlusion.latency = settings.occlusionLatency;
+	renderer.antiAliasing = settings.temporalAA ? OpenGLRenderer::AntiAliasing::Temporal : OpenGLRenderer::AntiAliasing::MSAA;
+	if (settings.lights > 0) AddLights(scene);
+	glViewport(0, 0, settings.width, settings.height);
+	glfwSwapInterval(0);
+
+	int frameCount = settings.warmupFrames + settings.frames;
+	unsigned long long lastResolved = profiler.frameIndex;
+	auto runStart = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		auto frameStart = std::chrono::steady_clock::now();
+		profiler.BeginFrame();
+		renderer.ResetStats();
+		renderer.InvalidateState();
+		UpdateCamera(frame, frameCount);
+		scene->Update(1.0f / 60.0f);
+		renderer.graph.Reset();
+		renderer.graph.Present(scene->AddPasses(renderer.graph, settings.width, settings.height, settings.samples));
+		renderer.graph.Execute();
+		renderer.UnbindTexture();
+		profiler.EndFrame();
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+		scene->CleanUp();
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+		if (frame >= settings.warmupFrames)
+		{
+			cpuFrameMs.push_back(elapsed.count());
+			frameStats.push_back(renderer.stats);
+		}
+		// gpu results arrive a few frames late, pick each one up once
+		if (profiler.latest.frame != lastResolved && profiler.latest.frame >= (unsigned long long)settings.warmupFrames)
+		{
+			lastResolved = profiler.latest.frame;
+			gpuFrameMs.push_back(profiler.GetTotal(profiler.latest, "Pass", true));
+		}
+	}
+	glFinish();
+	std::chrono::duration<double> total = std::chrono::steady_clock::now() - runStart;
+	totalSeconds = total.count();
+
+	return WriteReport();
+}
+
+void Benchmark::UpdateCamera(int frame, int frameCount)
+{
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	float t = (float)frame / std::max(frameCount - 1, 1) * (path.size() - 1);
+	int index = std::min((int)t, (int)path.size() - 2);
+	float alpha = t - index;
+
+	glm::vec3 position = glm::mix(path[index].position, path[index + 1].position, alpha);
+	glm::vec3 target = glm::mix(path[index].target, path[index + 1].target, alpha);
+	glm::vec3 forward = glm::normalize(target - position);
+
+	renderer.camera.position = position;
+	renderer.camera.phi = std::asin(glm::clamp(forward.y, -1.0f, 1.0f));
+	renderer.camera.theta = std::atan2(forward.z, forward.x);
+}
+
+void Benchmark::AddLights(std::shared_ptr<Scene> scene)
+{
+	scene->UpdateBounds();
+	AABB bounds = scene->bvh.GetRootBounds();
+	if (!bounds.IsValid()) bounds = AABB(glm::vec3(-10), glm::vec3(10));
+	// fixed seed so every run lights the scene the same way
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float range = glm::length(bounds.GetExtents()) * 0.25f;
+	for (int i = 0; i < settings.lights; i++)
+	{
+		std::shared_ptr<Entity> entity = std::make_shared<Entity>("Light");
+		entity->GetComponent<TransformComponent>()->translation = bounds.min + glm::vec3(unit(random), unit(random), unit(random)) * (bounds.max - bounds.min);
+		std::shared_ptr<LightComponent> light = std::make_shared<LightComponent>();
+		light->color = glm::vec3(unit(random), unit(random), unit(random));
+		light->intensity = range * range * 0.25f;
+		light->range = range;
+		entity->AddComponent(light);
+		scene->AddEntity(entity);
+	}
+	scene->CleanUp();
+}
+
+bool Benchmark::WriteReport()
+{
+	std::ofstream fout(settings.output);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to write benchmark report " << settings.output << std::endl;
+		return false;
+	}
+
+	size_t memory = 0, peakMemory = 0;
+	Util::GetMemoryUsage(memory, peakMemory);
+
+	auto writeTimes = [&](std::string name, std::vector<double>& values, bool last)
+	{
+		double sum = 0;
+		for (double v : values) sum += v;
+		fout << "  \"" << name << "\": {\n";
+		fout << "    \"samples\": " << values.size() << ",\n";
+		fout << "    \"mean\": " << (values.size() ? sum / values.size() : 0.0) << ",\n";
+		fout << "    \"p50\": " << Percentile(values, 50) << ",\n";
+		fout << "    \"p90\": " << Percentile(values, 90) << ",\n";
+		fout << "    \"p95\": " << Percentile(values, 95) << ",\n";
+		fout << "    \"p99\": " << Percentile(values, 99) << ",\n";
+		fout << "    \"max\": " << Percentile(values, 100) << "\n";
+		fout << "  }" << (last ? "\n" : ",\n");
+	};
+
+	auto writeStat = [&](std::string name, std::function<double(const RenderStats&)> get, bool last = false)
+	{
+		double sum = 0, max = 0;
+		for (auto& stats : frameStats)
+		{
+			sum += get(stats);
+			max = std::max(max, get(stats));
+		}
+		fout << "    \"" << name << "\": { \"mean\": " << (frameStats.size() ? sum / frameStats.size() : 0.0) << ", \"max\": " << max << " }" << (last ? "\n" : ",\n");
+	};
+
+	fout << "{\n";
+	fout << "  \"scene\": \"" << settings.scenePath << "\",\n";
+	fout << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\",\n";
+	fout << "  \"width\": " << settings.width << ",\n";
+	fout << "  \"height\": " << settings.height << ",\n";
+	fout << "  \"samples\": " << settings.samples << ",\n";
+	fout << "  \"gpu_culling\": " << (settings.gpuCulling ? "true" : "false") << ",\n";
+	fout << "  \"occlusion\": " << (settings.occlusion ? "true" : "false") << ",\n";
+	fout << "  \"occlusion_latency\": " << (settings.occlusionLatency ? "true" : "false") << ",\n";
+	fout << "  \"taa\": " << (settings.temporalAA ? "true" : "false") << ",\n";
+	fout << "  \"lights\": " << settings.lights << ",\n";
+	fout << "  \"frames\": " << settings.frames << ",\n";
+	fout << "  \"seconds\": " << totalSeconds << ",\n";
+	fout << "  \"memory_bytes\": " << memory << ",\n";
+	fout << "  \"peak_memory_bytes\": " << peakMemory << ",\n";
+	fout << "  \"per_frame\": {\n";
+	writeStat("draw_calls", [](const RenderStats& s) { return s.drawCalls; });
+	writeStat("state_changes", [](const RenderStats& s) { return s.GetStateChanges(); });
+	writeStat("program_binds", [](const RenderStats& s) { return s.programBinds; });
+	writeStat("texture_binds", [](const RenderStats& s) { return s.textureBinds; });
+	writeStat("redundant_calls", [](const RenderStats& s) { return s.redundantCalls; });
+	writeStat("material_binds", [](const RenderStats& s) { return s.materialBinds; });
+	writeStat("uniform_uploads", [](const RenderStats& s) { return s.uniformUploads; });
+	writeStat("uniform_bytes", [](const RenderStats& s) { return (double)s.uniformBytes; });
+	writeStat("buffer_upload_bytes", [](const RenderStats& s) { return (double)s.bufferUploadBytes; });
+	writeStat("culled", [](const RenderStats& s) { return s.culled; });
+	writeStat("occluded", [](const RenderStats& s) { return s.occluded; });
+	writeStat("lights", [](const RenderStats& s) { return s.lights; });
+	writeStat("triangles", [](const RenderStats& s) { return (double)s.triangles; }, true);
+	fout << "  },\n";
+	writeTimes("cpu_frame_ms", cpuFrameMs, false);
+	writeTimes("gpu_frame_ms", gpuFrameMs, true);
+	fout << "}\n";
+	fout.close();
+
+	std::cout << "Benchmark written to " << settings.output
+		<< " (p50 " << Percentile(cpuFrameMs, 50) << "ms, p99 " << Percentile(cpuFrameMs, 99) << "ms)" << std::endl;
+	return true;
+}
+
+std::vector<CameraKeyframe> Benchmark::LoadCameraPath(std::string path)
+{
+	/*
+		Keyframes:
+		  - Position: [0, 2, 10]
+		    Target: [0, 2, 0]
+	*/
+	std::vector<CameraKeyframe> keyframes;
+	if (!Util::FileExists(path))
+	{
+		std::cout << "Camera path " << path << " not found, using default orbit" << std::endl;
+		return keyframes;
+	}
+
+	YAML::Node file = YAML::LoadFile(path);
+	YAML::Node keyframeNodes = file["Keyframes"];
+	for (size_t i = 0; i < keyframeNodes.size(); i++)
+	{
+		std::vector<float> position = keyframeNodes[i]["Position"].as<std::vector<float>>();
+		std::vector<float> target = keyframeNodes[i]["Target"].as<std::vector<float>>();
+		if (position.size() != 3 || target.size() != 3) continue;
+		keyframes.push_back({ { position[0], position[1], position[2] }, { target[0], target[1], target[2] } });
+	}
+	return keyframes;
+}
+
+std::vector<CameraKeyframe> Benchmark::DefaultCameraPath()
+{
+	// one orbit around the origin, slightly above the ground plane
+	std::vector<CameraKeyframe> keyframes;
+	int steps = 16;
+	float radius = 12.0f;
+	for (int i = 0; i <= steps; i++)
+	{
+		float angle = glm::two_pi<float>() * i / steps;
+		keyframes.push_back({ { std::cos(angle) * radius, 4.0f, std::sin(angle) * radius }, { 0, 3.0f, 0 } });
+	}
+	return keyframes;
+}
+
+double Benchmark::Percentile(std::vector<double> values, double percentile)
+{
+	if (values.empty()) return 0;
+	std::sort(values.begin(), values.end());
+	size_t index = (size_t)std::ceil(percentile / 100.0 * values.size());
+	index = std::clamp<size_t>(index, 1, values.size());
+	return values[index - 1];
+}
+
+bool Benchmark::RunSerialiser(BenchmarkSettings settings)
+{
+	// compares yaml-cpp's stream based float conversion with the to_chars/from_chars path
+	// on the vertex list of a mesh file, no GL context needed
+	if (!Util::FileExists(settings.meshPath))
+	{
+		std::cout << "Mesh " << settings.meshPath << " not found" << std::endl;
+		return false;
+	}
+	using Clock = std::chrono::steady_clock;
+	auto milliseconds = [](Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	auto start = Clock::now();
+	YAML::Node file = YAML::LoadFile(settings.meshPath);
+	double parseMs = milliseconds(start);
+	YAML::Node vertexNodes = file["Vertices"];
+	size_t vertexCount = vertexNodes.size();
+	int sizes[] = { 3, 3, 3, 3, 4, 2 };
+
+	std::vector<Vertex> legacyVertices(vertexCount);
+	std::vector<Vertex> fastVertices(vertexCount);
+	std::vector<double> legacyDecode, fastDecode, legacyEncode, fastEncode;
+	size_t legacyBytes = 0, fastBytes = 0;
+	for (int iteration = 0; iteration < settings.iterations; iteration++)
+	{
+		start = Clock::now();
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			float* values = &legacyVertices[i].position.x;
+			for (int a = 0; a < 6; a++)
+			{
+				YAML::Node attribute = vertexNodes[i][a];
+				for (int c = 0; c < sizes[a]; c++)
+				{
+					*values++ = attribute[c].as<float>();
+				}
+			}
+		}
+		legacyDecode.push_back(milliseconds(start));
+
+		start = Clock::now();
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			MeshSerialiser::DeserialiseVertex(vertexNodes[i], fastVertices[i]);
+		}
+		fastDecode.push_back(milliseconds(start));
+
+		start = Clock::now();
+		YAML::Emitter out;
+		out << YAML::BeginSeq;
+		for (auto& vertex : legacyVertices)
+		{
+			const float* values = &vertex.position.x;
+			out << YAML::Flow << YAML::BeginSeq;
+			for (int a = 0; a < 6; a++)
+			{
+				out << YAML::Flow << YAML::BeginSeq;
+				for (int c = 0; c < sizes[a]; c++)
+				{
+					out << *values++;
+				}
+				out << YAML::EndSeq;
+			}
+			out << YAML::EndSeq;
+		}
+		out << YAML::EndSeq;
+		legacyBytes = out.size();
+		legacyEncode.push_back(milliseconds(start));
+
+		start = Clock::now();
+		std::string text;
+		text.reserve(vertexCount * 200);
+		MeshSerialiser serialiser(nullptr);
+		for (auto& vertex : fastVertices)
+		{
+			serialiser.SerialiseVertex(text, vertex);
+		}
+		fastBytes = text.size();
+		fastEncode.push_back(milliseconds(start));
+	}
+
+	// the fast path has to read back exactly what it wrote
+	std::string text;
+	MeshSerialiser serialiser(nullptr);
+	for (auto& vertex : fastVertices)
+	{
+		serialiser.SerialiseVertex(text, vertex);
+	}
+	YAML::Node reparsed = YAML::Load(text);
+	size_t mismatches = 0;
+	for (size_t i = 0; i < vertexCount && i < reparsed.size(); i++)
+	{
+		Vertex vertex;
+		if (!MeshSerialiser::DeserialiseVertex(reparsed[i], vertex)) mismatches++;
+		else if (std::memcmp(&vertex, &fastVertices[i], sizeof(Vertex)) != 0) mismatches++;
+	}
+	if (reparsed.size() != vertexCount) mismatches += vertexCount;
+
+	std::ofstream fout(settings.output);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to write benchmark report " << settings.output << std::endl;
+		return false;
+	}
+	auto writeTimes = [&](std::string name, std::vector<double>& values, bool last)
+	{
+		fout << "  \"" << name << "\": { \"p50\": " << Percentile(values, 50) << ", \"min\": " << Percentile(values, 0) << " }" << (last ? "\n" : ",\n");
+	};
+	fout << "{\n";
+	fout << "  \"mesh\": \"" << settings.meshPath << "\",\n";
+	fout << "  \"vertices\": " << vertexCount << ",\n";
+	fout << "  \"floats\": " << vertexCount * 18 << ",\n";
+	fout << "  \"iterations\": " << settings.iterations << ",\n";
+	fout << "  \"parse_ms\": " << parseMs << ",\n";
+	fout << "  \"legacy_bytes\": " << legacyBytes << ",\n";
+	fout << "  \"fast_bytes\": " << fastBytes << ",\n";
+	fout << "  \"round_trip_mismatches\": " << mismatches << ",\n";
+	writeTimes("legacy_decode_ms", legacyDecode, false);
+	writeTimes("fast_decode_ms", fastDecode, false);
+	writeTimes("legacy_encode_ms", legacyEncode, false);
+	writeTimes("fast_encode_ms", fastEncode, true);
+	fout << "}\n";
+	fout.close();
+
+	std::cout << settings.meshPath << ": " << vertexCount << " vertices, yaml parse " << parseMs << "ms" << std::endl;
+	std::cout << "  decode  legacy " << Percentile(legacyDecode, 50) << "ms  fast " << Percentile(fastDecode, 50) << "ms" << std::endl;
+	std::cout << "  encode  legacy " << Percentile(legacyEncode, 50) << "ms  fast " << Percentile(fastEncode, 50) << "ms" << std::endl;
+	std::cout << "  round trip mismatches " << mismatches << std::endl;
+	return mismatches == 0;
+}
+
+bool Benchmark::RunJobs(BenchmarkSettings settings)
+{
+	// the jobs do next to nothing so what is timed is the scheduler itself, no GL context needed
+	JobSystem& jobs = JobSystem::GetSingleton();
+	using Clock = std::chrono::steady_clock;
+	auto nanoseconds = [](Clock::time_point start, int count)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+	};
+	auto milliseconds = [](Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+	int count = std::max(1, settings.jobs);
+	std::vector<float> values(count * 16);
+	for (size_t i = 0; i < values.size(); i++) values[i] = (float)i;
+	std::vector<double> spawnNs, stealNs, chainNs, parallelMs, serialMs;
+	long long stolen = 0;
+	double sink = 0;
+	for (int iteration = 0; iteration < settings.iterations; iteration++)
+	{
+		// spawned and waited on from one thread, which pops most of them back itself
+		auto start = Clock::now();
+		JobSystem::Counter spawned;
+		for (int i = 0; i < count; i++) jobs.Run([]() {}, &spawned);
+		jobs.Wait(spawned);
+		spawnNs.push_back(nanoseconds(start, count));
+
+		// the spawning thread only watches, so every job has to be stolen by a worker
+		if (jobs.GetWorkerCount() > 0)
+		{
+			long long stolenBefore = jobs.stats.stolen;
+			start = Clock::now();
+			JobSystem::Counter stealable;
+			for (int i = 0; i < count; i++) jobs.Run([]() {}, &stealable);
+			while (!stealable.IsDone()) std::this_thread::yield();
+			jobs.Wait(stealable);
+			stealNs.push_back(nanoseconds(start, count));
+			stolen += jobs.stats.stolen - stolenBefore;
+		}
+
+		// each job a continuation of the one before, the latency of a dependency counter
+		int links = std::min(count, 10000);
+		std::unique_ptr<JobSystem::Counter[]> chain(new JobSystem::Counter[links]);
+		start = Clock::now();
+		jobs.Run([]() {}, &chain[0]);
+		for (int i = 1; i < links; i++) jobs.RunAfter(chain[i - 1], []() {}, &chain[i]);
+		jobs.Wait(chain[links - 1]);
+		chainNs.push_back(nanoseconds(start, links));
+
+		// a light loop over a few megabytes, split into jobs and on one thread
+		std::vector<double> partial(values.size() / 1024 + 1);
+		start = Clock::now();
+		jobs.ParallelFor(values.size(), 1024, [&](size_t i) { partial[i / 1024] += std::sqrt(values[i]); });
+		parallelMs.push_back(milliseconds(start));
+		for (double value : partial) sink += value;
+		double sum = 0;
+		start = Clock::now();
+		for (size_t i = 0; i < values.size(); i++) sum += std::sqrt(values[i]);
+		serialMs.push_back(milliseconds(start));
+		sink -= sum;
+	}
+
+	std::ofstream fout(settings.output);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to write benchmark report " << settings.output << std::endl;
+		return false;
+	}
+	auto writeTimes = [&](std::string name, std::vector<double>& values, bool last)
+	{
+		fout << "  \"" << name << "\": { \"p50\": " << Percentile(values, 50) << ", \"min\": " << Percentile(values, 0) << " }" << (last ? "\n" : ",\n");
+	};
+	fout << "{\n";
+	fout << "  \"threads\": " << jobs.GetThreadCount() << ",\n";
+	fout << "  \"jobs\": " << count << ",\n";
+	fout << "  \"iterations\": " << settings.iterations << ",\n";
+	fout << "  \"stolen\": " << stolen << ",\n";
+	writeTimes("spawn_ns", spawnNs, false);
+	writeTimes("steal_ns", stealNs, false);
+	writeTimes("chain_ns", chainNs, false);
+	writeTimes("parallel_for_ms", parallelMs, false);
+	writeTimes("serial_for_ms", serialMs, true);
+	fout << "}\n";
+	fout.close();
+
+	std::cout << jobs.GetThreadCount() << " threads, " << count << " jobs" << std::endl;
+	std::cout << "  spawn " << Percentile(spawnNs, 50) << "ns  steal " << Percentile(stealNs, 50) << "ns  chain " << Percentile(chainNs, 50) << "ns per job" << std::endl;
+	std::cout << "  parallel for " << Percentile(parallelMs, 50) << "ms  serial " << Percentile(serialMs, 50) << "ms" << std::endl;
+	// keeps the loops from being optimised away, the two sums match up to rounding
+	return std::isfinite(sink);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "Graphics.h"
+#include "OpenGLRenderer.h"
+#include <string>
+#include <vector>
+#include <memory>
+
+class Scene;
+
+struct BenchmarkSettings
+{
+	std::string scenePath = "scenes/UntitledScene.scene";
+	std::string cameraPath;
+	std::string output = "benchmark.json";
+	int frames = 600;
+	int warmupFrames = 30;
+	int width = 1280;
+	int height = 720;
+	int samples = 4;
+	// --taa, single sampled targets resolved by temporal anti-aliasing instead of MSAA
+	bool temporalAA = false;
+	// --gpu-culling, cull and build draws in a compute pass
+	bool gpuCulling = false;
+	// --occlusion, hierarchical z culling against a depth pre-pass of the largest occluders
+	bool occlusion = false;
+	// --occlusion-sync, the CPU path waits up to OcclusionCulling::MaxWaitNanoseconds for this frame's occlusion results
+	bool occlusionLatency = true;
+	// --lights n, scatters this many point lights over the scene for clustered shading
+	int lights = 0;
+	// --bench-serialiser, times the YAML float converters on a mesh file
+	std::string meshPath = "meshes/defaultobject.mesh";
+	int iterations = 10;
+	// --bench-jobs, times spawning, stealing and chaining this many empty jobs per iteration
+	int jobs = 100000;
+};
+
+struct CameraKeyframe
+{
+	glm::vec3 position;
+	glm::vec3 target;
+};
+
+// Renders a scene offscreen for a fixed number of frames while flying the
+// camera along a path, then writes frame time percentiles and resource usage
+// as JSON. Needs a current GL context but no visible window.
+class Benchmark
+{
+public:
+	Benchmark(BenchmarkSettings settings);
+	bool Run(std::shared_ptr<Scene> scene, GLFWwindow* window);
+
+	static std::vector<CameraKeyframe> LoadCameraPath(std::string path);
+	static std::vector<CameraKeyframe> DefaultCameraPath();
+	static double Percentile(std::vector<double> values, double percentile);
+	static bool RunSerialiser(BenchmarkSettings settings);
+	static bool RunJobs(BenchmarkSettings settings);
+private:
+	void UpdateCamera(int frame, int frameCount);
+	void AddLights(std::shared_ptr<Scene> scene);
+	bool WriteReport();
+
+	BenchmarkSettings settings;
+	std::vector<CameraKeyframe> path;
+	std::vector<double> cpuFrameMs;
+	std::vector<double> gpuFrameMs;
+	std::vector<RenderStats> frameStats;
+	double totalSeconds = 0;
+};
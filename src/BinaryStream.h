@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+// Little helpers for the binary file formats. Values are written in the
+// native byte order of the machine, which is little endian on everything we ship.
+class BinaryWriter
+{
+public:
+	template<typename T>
+	void Write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "BinaryWriter can only write plain data");
+		WriteBytes(&value, sizeof(T));
+	}
+
+	void WriteBytes(const void* data, size_t size)
+	{
+		const char* bytes = static_cast<const char*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	void WriteString(const std::string& value)
+	{
+		Write<uint32_t>((uint32_t)value.size());
+		WriteBytes(value.data(), value.size());
+	}
+
+	// reserves space for a value that is only known later, see Patch
+	template<typename T>
+	size_t Reserve()
+	{
+		size_t offset = buffer.size();
+		buffer.resize(buffer.size() + sizeof(T));
+		return offset;
+	}
+
+	template<typename T>
+	void Patch(size_t offset, const T& value)
+	{
+		std::memcpy(buffer.data() + offset, &value, sizeof(T));
+	}
+
+	size_t Size() const { return buffer.size(); }
+	std::vector<char> buffer;
+};
+
+// Reads from a block of memory the reader does not own. Reading past the end
+// fails softly: the value is zeroed and ok is cleared, callers check it once
+// after a block of reads instead of after every value.
+class BinaryReader
+{
+public:
+	BinaryReader(const char* data, size_t size) : data(data), size(size) {};
+
+	template<typename T>
+	T Read()
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "BinaryReader can only read plain data");
+		T value;
+		ReadBytes(&value, sizeof(T));
+		return value;
+	}
+
+	void ReadBytes(void* destination, size_t count)
+	{
+		if (!ok || count > size - offset)
+		{
+			std::memset(destination, 0, count);
+			ok = false;
+			return;
+		}
+		std::memcpy(destination, data + offset, count);
+		offset += count;
+	}
+
+	std::string ReadString()
+	{
+		uint32_t length = Read<uint32_t>();
+		if (!ok || length > size - offset)
+		{
+			ok = false;
+			return std::string();
+		}
+		std::string value(data + offset, length);
+		offset += length;
+		return value;
+	}
+
+	void Skip(size_t count)
+	{
+		if (count > size - offset)
+		{
+			ok = false;
+			offset = size;
+			return;
+		}
+		offset += count;
+	}
+
+	const char* Current() const { return data + offset; }
+	size_t Remaining() const { return size - offset; }
+
+	const char* data;
+	size_t size;
+	size_t offset = 0;
+	bool ok = true;
+};
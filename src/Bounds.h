@@ -0,0 +1,126 @@
+#pragma once
+#include "Matrices.h"
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+struct AABB
+{
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	AABB() = default;
+	AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max) {};
+
+	bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+	glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+	glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+	float SurfaceArea() const
+	{
+		glm::vec3 size = max - min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	void Grow(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void Grow(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	static AABB Union(const AABB& a, const AABB& b)
+	{
+		return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+	}
+
+	bool Contains(const AABB& other) const
+	{
+		return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+	}
+
+	bool Intersects(const AABB& other) const
+	{
+		return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+	}
+
+	// box around this box after the transform, without transforming all eight corners
+	AABB Transform(const glm::mat4& transform) const
+	{
+		glm::vec3 center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
+		glm::vec3 extents = GetExtents();
+		glm::vec3 worldExtents(0);
+		for (int i = 0; i < 3; i++)
+		{
+			worldExtents += glm::abs(glm::vec3(transform[i])) * extents[i];
+		}
+		return AABB(center - worldExtents, center + worldExtents);
+	}
+
+	// slab test, distance is where the ray enters the box (0 if it starts inside)
+	bool Raycast(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const
+	{
+		glm::vec3 t0 = (min - origin) * inverseDirection;
+		glm::vec3 t1 = (max - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		distance = enter;
+		return enter <= exit;
+	}
+};
+
+// six planes pointing inwards, taken from a view projection matrix
+struct Frustum
+{
+	enum class Result
+	{
+		Outside,
+		Intersects,
+		Inside
+	};
+
+	glm::vec4 planes[6];
+
+	Frustum() = default;
+	Frustum(const glm::mat4& viewProjection)
+	{
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+		{
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[3] + rows[2];
+		planes[5] = rows[3] - rows[2];
+		for (auto& plane : planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+	}
+
+	Result Test(const AABB& box) const
+	{
+		Result result = Result::Inside;
+		glm::vec3 center = box.GetCenter();
+		glm::vec3 extents = box.GetExtents();
+		for (auto& plane : planes)
+		{
+			glm::vec3 normal = glm::vec3(plane);
+			float distance = glm::dot(normal, center) + plane.w;
+			float radius = glm::dot(glm::abs(normal), extents);
+			if (distance < -radius) return Result::Outside;
+			if (distance < radius) result = Result::Intersects;
+		}
+		return result;
+	}
+};
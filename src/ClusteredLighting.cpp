@@ -0,0 +1,121 @@
+#include "ClusteredLighting.h"
+#include "OpenGLRenderer.h"
+#include "components/Scene.h"
+#include <algorithm>
+
+ClusteredLighting::~ClusteredLighting()
+{
+	if (!initialised) return;
+	glDeleteBuffers(1, &lightBuffer);
+	glDeleteBuffers(1, &clusterBuffer);
+}
+
+bool ClusteredLighting::Init()
+{
+	if (initialised) return true;
+	clusterShader = std::make_shared<Shader>();
+	clusterShader->LoadShaderFromFile(GL_COMPUTE_SHADER, "LightClusters.comp");
+	clusterShader->Link();
+
+	glCreateBuffers(1, &lightBuffer);
+	glCreateBuffers(1, &clusterBuffer);
+	glNamedBufferData(clusterBuffer, (size_t)ClusterCount * (MaxLightsPerCluster + 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+	initialised = true;
+	return true;
+}
+
+void ClusteredLighting::Update(Scene& scene, const glm::mat4& view, const glm::mat4& projection, float near, float far, const glm::vec4& viewport)
+{
+	if (!initialised && !Init()) return;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+
+	lights.clear();
+	std::vector<Light> local;
+	for (auto& entity : scene.entities)
+	{
+		if (!entity) continue;
+		LightComponent* lightComponent = entity->GetComponent<LightComponent>();
+		TransformComponent* transformComponent = entity->GetComponent<TransformComponent>();
+		if (!lightComponent || !transformComponent) continue;
+
+		glm::mat4 transform = transformComponent->GetTransform();
+		glm::vec3 position = transform[3];
+		glm::vec3 direction = glm::normalize(glm::vec3(transform * glm::vec4(0, 0, -1, 0)));
+		float range = std::max(lightComponent->range, 0.001f);
+		Light light;
+		light.position = glm::vec4(position, range);
+		light.color = glm::vec4(lightComponent->color * lightComponent->intensity, 0);
+		light.direction = glm::vec4(direction, 0);
+		light.bounds = glm::vec4(position, range);
+
+		switch (lightComponent->type)
+		{
+		case LightType::Directional:
+			lights.push_back(light);
+			continue;
+		case LightType::Point:
+			// cosines no angle can fall below, the cone factor comes out as one in every direction
+			light.color.w = -1.0f;
+			light.direction.w = -2.0f;
+			break;
+		case LightType::Spot:
+		{
+			float outer = glm::radians(glm::clamp(lightComponent->outerAngle, 0.1f, 179.0f));
+			float inner = glm::radians(glm::clamp(lightComponent->innerAngle, 0.0f, glm::degrees(outer) - 0.05f));
+			light.color.w = std::cos(inner);
+			light.direction.w = std::cos(outer);
+			// the smallest sphere around the cone, past a right angle it is the whole range
+			if (outer < glm::quarter_pi<float>())
+			{
+				float radius = range / (2.0f * std::cos(outer));
+				light.bounds = glm::vec4(position + direction * radius, radius);
+			}
+			else if (outer < glm::half_pi<float>())
+			{
+				light.bounds = glm::vec4(position + direction * range * std::cos(outer), range * std::sin(outer));
+			}
+			break;
+		}
+		}
+		local.push_back(light);
+	}
+	directionalCount = (int)lights.size();
+	lights.insert(lights.end(), local.begin(), local.end());
+	renderer.stats.lights += (int)lights.size();
+
+	// never empty, a buffer with no storage cannot be bound
+	size_t bytes = std::max<size_t>(lights.size(), 1) * sizeof(Light);
+	if (bytes > lightCapacity)
+	{
+		lightCapacity = std::max(bytes, lightCapacity * 2);
+		glNamedBufferData(lightBuffer, lightCapacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (!lights.empty())
+	{
+		glNamedBufferSubData(lightBuffer, 0, lights.size() * sizeof(Light), lights.data());
+		renderer.stats.bufferUploadBytes += lights.size() * sizeof(Light);
+	}
+
+	this->viewport = viewport;
+	depthRange = glm::vec2(near, far);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LightBinding, lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ClusterBinding, clusterBuffer);
+	glm::mat4 viewMatrix = view;
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	clusterShader->Use();
+	clusterShader->SetUniform("u_viewMatrix", viewMatrix, 1);
+	clusterShader->SetUniform("u_inverseProjection", inverseProjection, 1);
+	clusterShader->SetUniform("u_clusterDepth", depthRange, 1);
+	clusterShader->SetUniform("u_lightCount", (int)lights.size());
+	clusterShader->SetUniform("u_directionalLights", directionalCount);
+	// the render graph puts the barrier in front of the passes that read the clusters
+	glDispatchCompute((ClusterCount + GroupSize - 1) / GroupSize, 1, 1);
+}
+
+void ClusteredLighting::Bind(std::shared_ptr<Shader> shader)
+{
+	shader->SetUniform("u_clusterDepth", depthRange, 1);
+	shader->SetUniform("u_clusterViewport", viewport, 1);
+	shader->SetUniform("u_directionalLights", directionalCount);
+}
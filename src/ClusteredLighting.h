@@ -0,0 +1,69 @@
+#pragma once
+#include "Graphics.h"
+#include <vector>
+#include <memory>
+
+class Scene;
+class Shader;
+
+/*
+	Clustered forward lighting. The view frustum is cut into froxels, a
+	ClusterX by ClusterY grid of screen tiles times ClusterZ depth slices spaced
+	exponentially between the near and far planes. Every frame the scene's lights
+	are uploaded and a compute pass lists, for each froxel, the point and spot
+	lights whose range reaches it. A lit fragment works out its froxel from its
+	screen position and depth and shades only the lights listed there, so its
+	cost follows how many lights overlap it rather than how many exist.
+	Directional lights reach everywhere and are shaded by every fragment.
+*/
+class ClusteredLighting
+{
+public:
+	struct Light
+	{
+		// xyz world position, w range
+		glm::vec4 position;
+		// rgb colour times intensity, w cosine of the spot's inner angle
+		glm::vec4 color;
+		// xyz direction the light points, w cosine of the spot's outer angle
+		glm::vec4 direction;
+		// sphere around everything the light reaches, what the froxels are tested against
+		glm::vec4 bounds;
+	};
+
+	// the grid and list size are repeated in LightClusters.comp and Phong.frag
+	static const int ClusterX = 16;
+	static const int ClusterY = 9;
+	static const int ClusterZ = 24;
+	static const int ClusterCount = ClusterX * ClusterY * ClusterZ;
+	// each froxel holds a count followed by this many light indices
+	static const int MaxLightsPerCluster = 128;
+	static const int GroupSize = 64;
+	// shader storage bindings, clear of the ones the culling passes use
+	static const int LightBinding = 7;
+	static const int ClusterBinding = 8;
+
+	~ClusteredLighting();
+	// creates the buffers, safe to call every frame
+	bool Init();
+	// gathers the scene's lights and rebuilds the froxel light lists for this camera and viewport
+	void Update(Scene& scene, const glm::mat4& view, const glm::mat4& projection, float near, float far, const glm::vec4& viewport);
+	// uniforms a lit shader needs to find its froxel
+	void Bind(std::shared_ptr<Shader> shader);
+	int GetLightCount() const { return (int)lights.size(); }
+	GLuint GetLightBuffer() const { return lightBuffer; }
+	GLuint GetClusterBuffer() const { return clusterBuffer; }
+private:
+
+	std::shared_ptr<Shader> clusterShader;
+	GLuint lightBuffer = 0;
+	GLuint clusterBuffer = 0;
+	size_t lightCapacity = 0;
+	bool initialised = false;
+
+	// directional lights first, then the point and spot lights the froxels index
+	std::vector<Light> lights;
+	int directionalCount = 0;
+	glm::vec2 depthRange;
+	glm::vec4 viewport;
+};
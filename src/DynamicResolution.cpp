@@ -0,0 +1,103 @@
+#include "DynamicResolution.h"
+#include "OpenGLRenderer.h"
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::~DynamicResolution()
+{
+	if (!initialised) return;
+	glDeleteQueries(FrameLatency, queries);
+}
+
+void DynamicResolution::BeginFrame()
+{
+	if (!enabled)
+	{
+		// started over when turned back on, results queued from before say nothing about the frames since
+		scale = MaxScale;
+		samples = 0;
+		gpuMs = 0.0f;
+		settle = FrameLatency;
+		return;
+	}
+	if (!initialised)
+	{
+		glCreateQueries(GL_TIME_ELAPSED, FrameLatency, queries);
+		initialised = true;
+	}
+	// the oldest query is the one reused, the newest result that could have finished
+	if (pending[current])
+	{
+		GLuint available = 0;
+		glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+		// a driver that far behind leaves this frame untimed rather than waiting
+		if (!available) return;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &elapsed);
+		pending[current] = false;
+		Adjust(elapsed / 1000000.0f);
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	timing = true;
+}
+
+void DynamicResolution::EndFrame()
+{
+	if (!timing) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = (current + 1) % FrameLatency;
+	timing = false;
+}
+
+void DynamicResolution::Adjust(float ms)
+{
+	if (settle > 0)
+	{
+		settle--;
+		return;
+	}
+	gpuMs = gpuMs > 0.0f ? gpuMs + (ms - gpuMs) * Smoothing : ms;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	// TAA draws single sampled, only the scale is left to adjust
+	bool temporal = renderer.antiAliasing == OpenGLRenderer::AntiAliasing::Temporal;
+	int maxSamples = temporal ? 1 : renderer.samples;
+	int sampleCount = temporal ? 1 : GetSamples();
+	float load = gpuMs / targetMs;
+	if (load > 1.0f)
+	{
+		if (scale > MinScale)
+		{
+			scale = std::max(MinScale, scale - std::min(MaxStep, scale - scale / std::sqrt(load)));
+		}
+		else if (sampleCount > 1)
+		{
+			samples = sampleCount / 2;
+			settle = FrameLatency;
+			gpuMs = 0.0f;
+		}
+	}
+	else if (load < Headroom && scale < MaxScale)
+	{
+		scale = std::min(MaxScale, scale + std::min(MaxStep, scale / std::sqrt(load) - scale));
+	}
+	else if (load < SampleHeadroom && sampleCount < maxSamples)
+	{
+		samples = std::min(sampleCount * 2, maxSamples);
+		settle = FrameLatency;
+		gpuMs = 0.0f;
+	}
+}
+
+int DynamicResolution::GetSize(int size) const
+{
+	if (!enabled) return size;
+	return std::max(1, (int)std::round(size * scale));
+}
+
+int DynamicResolution::GetSamples() const
+{
+	int maxSamples = OpenGLRenderer::GetSingleton().samples;
+	if (!enabled || samples <= 0) return maxSamples;
+	return std::min(samples, maxSamples);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "Graphics.h"
+
+/*
+	Scales the size and sample count the scene is rendered at to hold a target
+	GPU frame time. Each frame's GPU work is timed with a GL_TIME_ELAPSED query,
+	and the queries sit in a ring of FrameLatency frames so a result is only
+	read once it is available and the pipeline never stalls on it.
+
+	The pixel count goes with the square of the scale, so it is moved by the
+	square root of how far the smoothed time is from the target, a limited
+	step at a time. Once the scale is at MinScale and the frame is still too
+	slow the sample count is halved, and it is only doubled again with plenty
+	of headroom at full scale. The scene is drawn into the corner of the
+	graph's bucketed targets and stretched to the panel by RenderGraph::AddUpscale.
+*/
+class DynamicResolution
+{
+public:
+	static const int FrameLatency = 3;
+	static constexpr float MinScale = 0.5f;
+	static constexpr float MaxScale = 1.0f;
+	// the scale only grows below this fraction of the target, the gap keeps it from hunting
+	static constexpr float Headroom = 0.85f;
+	// samples are only doubled below this fraction, doubling them can cost most of a frame
+	static constexpr float SampleHeadroom = 0.5f;
+	// largest change of the scale from one result to the next
+	static constexpr float MaxStep = 0.05f;
+	// weight of a new result in the smoothed frame time
+	static constexpr float Smoothing = 0.2f;
+
+	~DynamicResolution();
+	// starts timing the frame, first adjusting the scale to the newest finished one
+	void BeginFrame();
+	void EndFrame();
+	// size the scene is rendered at for an output dimension
+	int GetSize(int size) const;
+	// never more than the renderer's samples
+	int GetSamples() const;
+
+	bool enabled = false;
+	float targetMs = 1000.0f / 60.0f;
+	float scale = MaxScale;
+	// smoothed GPU time of finished frames
+	float gpuMs = 0.0f;
+private:
+	void Adjust(float ms);
+
+	GLuint queries[FrameLatency] = {};
+	bool pending[FrameLatency] = {};
+	int current = 0;
+	bool timing = false;
+	bool initialised = false;
+	// 0 until the controller first lowers it, the renderer's samples then
+	int samples = 0;
+	// results to skip, ones still in flight from before the last sample count change and the first
+	// frames after starting, which carry startup work
+	int settle = FrameLatency;
+};
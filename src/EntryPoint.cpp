@@ -1,9 +1,92 @@
 //These includes are specific to the way weve set up GLFW and GLAD.
 #include "Program.h"
+#include "JobSystem.h"
 
-int main(void)
+int main(int argc, char** argv)
 {
     Program program;
+
+    // App --benchmark [scene] [--frames n] [--warmup n] [--size w h] [--samples n] [--camera file] [--out file] [--gpu-culling] [--occlusion] [--occlusion-sync] [--lights n] [--taa] [--packed]
+    // App --bench-serialiser [mesh] [--iterations n] [--out file]
+    // App --bench-jobs [--jobs n] [--iterations n] [--out file]
+    // App --pack [archive] [--compress]
+    // App [--packed], reads assets.pak written by --pack instead of the loose files
+    BenchmarkSettings settings;
+    bool benchmark = false;
+    bool serialiserBenchmark = false;
+    bool jobBenchmark = false;
+    bool pack = false;
+    bool compress = false;
+    std::string packPath = "assets.pak";
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--benchmark")
+        {
+            benchmark = true;
+            if (hasValue && argv[i + 1][0] != '-') settings.scenePath = argv[++i];
+        }
+        else if (arg == "--bench-serialiser")
+        {
+            serialiserBenchmark = true;
+            if (hasValue && argv[i + 1][0] != '-') settings.meshPath = argv[++i];
+        }
+        else if (arg == "--bench-jobs") jobBenchmark = true;
+        else if (arg == "--pack")
+        {
+            pack = true;
+            if (hasValue && argv[i + 1][0] != '-') packPath = argv[++i];
+        }
+        else if (arg == "--compress") compress = true;
+        else if (arg == "--packed") program.packed = true;
+        else if (arg == "--gpu-culling") settings.gpuCulling = true;
+        else if (arg == "--occlusion") settings.occlusion = true;
+        else if (arg == "--occlusion-sync") settings.occlusionLatency = false;
+        else if (arg == "--taa") settings.temporalAA = true;
+        else if (arg == "--lights" && hasValue) settings.lights = std::stoi(argv[++i]);
+        else if (arg == "--jobs" && hasValue) settings.jobs = std::stoi(argv[++i]);
+        else if (arg == "--iterations" && hasValue) settings.iterations = std::stoi(argv[++i]);
+        else if (arg == "--frames" && hasValue) settings.frames = std::stoi(argv[++i]);
+        else if (arg == "--warmup" && hasValue) settings.warmupFrames = std::stoi(argv[++i]);
+        else if (arg == "--samples" && hasValue) settings.samples = std::stoi(argv[++i]);
+        else if (arg == "--camera" && hasValue) settings.cameraPath = argv[++i];
+        else if (arg == "--out" && hasValue) settings.output = argv[++i];
+        else if (arg == "--size" && i + 2 < argc)
+        {
+            settings.width = std::stoi(argv[++i]);
+            settings.height = std::stoi(argv[++i]);
+        }
+    }
+
+    // asset decode, scene loading and the render queue all run on it
+    JobSystem::Create();
+
+    if (pack)
+    {
+        // the asset index is packed too, a shipping build never scans for loose files
+        AssetDatabase::Create().Open("assets.index");
+        return AssetArchive::Build(".", packPath, compress) ? 0 : 1;
+    }
+
+    if (serialiserBenchmark)
+    {
+        return Benchmark::RunSerialiser(settings) ? 0 : 1;
+    }
+
+    if (jobBenchmark)
+    {
+        return Benchmark::RunJobs(settings) ? 0 : 1;
+    }
+
+    if (benchmark)
+    {
+        if (!program.InitHeadless(settings)) return 1;
+        bool success = program.RunBenchmark(settings);
+        program.End();
+        return success ? 0 : 1;
+    }
+
     program.Init(1280, 720, "App");
     program.Update();
     program.End();
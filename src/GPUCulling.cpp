@@ -0,0 +1,319 @@
+#include "GPUCulling.h"
+#include "OpenGLRenderer.h"
+#include "Profiler.h"
+#include "OcclusionCulling.h"
+#include "components/Scene.h"
+#include <map>
+
+GPUCulling::~GPUCulling()
+{
+	if (!initialised) return;
+	if (countFence) glDeleteSync(countFence);
+	glDeleteBuffers(BufferCount, buffers);
+	glDeleteBuffers(1, &countReadback);
+}
+
+bool GPUCulling::Init()
+{
+	cullShader = std::make_shared<Shader>();
+	cullShader->LoadShaderFromFile(GL_COMPUTE_SHADER, "Cull.comp");
+	cullShader->Link();
+	glCreateBuffers(BufferCount, buffers);
+	glCreateBuffers(1, &countReadback);
+	initialised = true;
+	return true;
+}
+
+void GPUCulling::Upload(int buffer, const void* data, size_t bytes)
+{
+	// grows by doubling so a scene that keeps adding entities does not reallocate every rebuild
+	if (bytes > capacities[buffer])
+	{
+		capacities[buffer] = std::max(bytes, capacities[buffer] * 2);
+		glNamedBufferData(buffers[buffer], capacities[buffer], nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (data && bytes) glNamedBufferSubData(buffers[buffer], 0, bytes, data);
+	OpenGLRenderer::GetSingleton().stats.bufferUploadBytes += data ? bytes : 0;
+}
+
+void GPUCulling::ReadCounts()
+{
+	if (!countFence) return;
+	GLenum status = glClientWaitSync(countFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED) return;
+	glDeleteSync(countFence);
+	countFence = nullptr;
+
+	std::vector<GLuint> counts(countedBatches);
+	glGetNamedBufferSubData(countReadback, 0, counts.size() * sizeof(GLuint), counts.data());
+	size_t drawn = 0;
+	for (GLuint count : counts) drawn += count;
+	// frustum and occlusion rejections are not told apart on the GPU, both count as culled
+	culled = (int)(countedInstances - std::min(drawn, countedInstances));
+}
+
+void GPUCulling::WriteInstance(int slot, const glm::mat4& transform, const Mesh& mesh)
+{
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	AABB bounds = mesh.bounds.Transform(transform);
+	Instance& instance = instances[slot];
+	instance.boundsMin = glm::vec4(bounds.min, 0);
+	instance.boundsMax = glm::vec4(bounds.max, 0);
+	instance.sphere = glm::vec4(glm::vec3(transform * glm::vec4(mesh.boundsCenter, 1.0f)), mesh.boundsRadius * scale);
+	transforms[slot] = transform;
+}
+
+bool GPUCulling::SameAssignment(const EntitySlots& slots, Entity* entity)
+{
+	TransformComponent* transformComponent = entity->GetComponent<TransformComponent>();
+	MeshRendererComponent* meshRendererComponent = entity->GetComponent<MeshRendererComponent>();
+	if (!transformComponent || !meshRendererComponent) return slots.meshes.empty() && slots.materials.empty();
+	if (meshRendererComponent->meshes.size() != slots.meshes.size() || meshRendererComponent->materials.size() != slots.materials.size()) return false;
+	for (size_t i = 0; i < slots.meshes.size(); i++)
+	{
+		if (meshRendererComponent->meshes[i].GetId() != slots.meshes[i]) return false;
+	}
+	for (size_t i = 0; i < slots.materials.size(); i++)
+	{
+		if (meshRendererComponent->materials[i].GetId() != slots.materials[i]) return false;
+	}
+	return true;
+}
+
+void GPUCulling::Rebuild(Scene& scene)
+{
+	instances.clear();
+	transforms.clear();
+	slots.clear();
+	pending.clear();
+	batches.clear();
+	batchMaterials.clear();
+	batchMeshes.clear();
+	batchSizes.clear();
+	std::vector<GLuint> lods;
+	std::map<std::pair<MaterialInstance*, Mesh*>, GLuint> lookup;
+
+	for (auto& entity : scene.entities)
+	{
+		if (!entity) continue;
+		// every entity gets a record, one that has none was added since and means a rebuild
+		EntitySlots& entitySlots = slots[entity.get()];
+		entitySlots.first = (int)instances.size();
+		TransformComponent* transformComponent = entity->GetComponent<TransformComponent>();
+		MeshRendererComponent* meshRendererComponent = entity->GetComponent<MeshRendererComponent>();
+		if (!transformComponent || !meshRendererComponent) continue;
+		for (auto& mesh : meshRendererComponent->meshes) entitySlots.meshes.push_back(mesh.GetId());
+		for (auto& material : meshRendererComponent->materials) entitySlots.materials.push_back(material.GetId());
+		glm::mat4 transform = transformComponent->GetTransform();
+
+		for (size_t i = 0; i < meshRendererComponent->meshes.size() && i < meshRendererComponent->materials.size(); i++)
+		{
+			// only what is already resident, the rest is loaded when the entity comes into view
+			const ResourceHandle<Mesh>& meshHandle = meshRendererComponent->meshes[i];
+			const ResourceHandle<MaterialInstance>& materialHandle = meshRendererComponent->materials[i];
+			if (!meshHandle.IsLoaded() || !materialHandle.IsLoaded() || !materialHandle.lock()->shader.IsLoaded())
+			{
+				if (pending.empty() || pending.back() != entity.get()) pending.push_back(entity.get());
+				continue;
+			}
+			std::shared_ptr<Mesh> mesh = meshHandle.lock();
+			std::shared_ptr<MaterialInstance> material = materialHandle.lock();
+			if (!mesh->bounds.IsValid()) continue;
+
+			auto key = std::make_pair(material.get(), mesh.get());
+			auto it = lookup.find(key);
+			if (it == lookup.end())
+			{
+				it = lookup.emplace(key, (GLuint)batches.size()).first;
+				Batch batch = {};
+				const std::vector<Mesh::Lod>& meshLods = mesh->GetLods();
+				batch.lodCount = (GLuint)std::min(meshLods.size(), (size_t)MeshSimplifier::MaxLods + 1);
+				for (GLuint lod = 0; lod < batch.lodCount; lod++)
+				{
+					batch.lods[lod][0] = meshLods[lod].count;
+					batch.lods[lod][1] = (GLuint)(meshLods[lod].offset / sizeof(unsigned short));
+				}
+				batches.push_back(batch);
+				batchMaterials.push_back(material);
+				batchMeshes.push_back(mesh);
+				batchSizes.push_back(0);
+			}
+
+			int slot = (int)instances.size();
+			instances.push_back({});
+			transforms.push_back(transform);
+			WriteInstance(slot, transform, *mesh);
+			instances[slot].batch = it->second;
+			entitySlots.count++;
+			// carry on from the level the CPU path last picked so switching paths does not pop
+			lods.push_back(i < meshRendererComponent->lods.size() ? meshRendererComponent->lods[i] : 0);
+			batchSizes[it->second]++;
+		}
+	}
+
+	// each batch owns a command range large enough for all of its instances
+	GLuint firstCommand = 0;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		batches[i].firstCommand = firstCommand;
+		firstCommand += batchSizes[i];
+	}
+
+	Upload(TransformBuffer, transforms.data(), transforms.size() * sizeof(glm::mat4));
+	Upload(InstanceBuffer, instances.data(), instances.size() * sizeof(Instance));
+	Upload(BatchBuffer, batches.data(), batches.size() * sizeof(Batch));
+	Upload(LodBuffer, lods.data(), lods.size() * sizeof(GLuint));
+	Upload(CommandBuffer, nullptr, instances.size() * sizeof(DrawCommand));
+	Upload(CountBuffer, nullptr, batches.size() * sizeof(GLuint));
+	Upload(VisibleBuffer, nullptr, instances.size() * sizeof(GLuint));
+	version = scene.entityVersion;
+	scene.movedEntities.clear();
+	scene.movedOverflow = false;
+}
+
+bool GPUCulling::UpdateMoved(Scene& scene)
+{
+	if (scene.movedOverflow) return false;
+	std::vector<std::pair<int, int>> ranges;
+	size_t moved = 0;
+	for (Entity* entity : scene.movedEntities)
+	{
+		auto it = slots.find(entity);
+		if (it == slots.end() || !SameAssignment(it->second, entity)) return false;
+		const EntitySlots& entitySlots = it->second;
+		if (entitySlots.count == 0) continue;
+		glm::mat4 transform = entity->GetComponent<TransformComponent>()->GetTransform();
+		for (int slot = entitySlots.first; slot < entitySlots.first + entitySlots.count; slot++)
+		{
+			WriteInstance(slot, transform, *batchMeshes[instances[slot].batch]);
+		}
+		ranges.push_back({ entitySlots.first, entitySlots.count });
+		moved += entitySlots.count;
+	}
+	scene.movedEntities.clear();
+	if (ranges.empty()) return true;
+
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	if (moved > instances.size() * UploadAllFraction)
+	{
+		Upload(TransformBuffer, transforms.data(), transforms.size() * sizeof(glm::mat4));
+		Upload(InstanceBuffer, instances.data(), instances.size() * sizeof(Instance));
+		return true;
+	}
+	// an entity that moved twice since the last frame is written twice, which is harmless
+	for (auto& range : ranges)
+	{
+		glNamedBufferSubData(buffers[TransformBuffer], range.first * sizeof(glm::mat4), range.second * sizeof(glm::mat4), &transforms[range.first]);
+		glNamedBufferSubData(buffers[InstanceBuffer], range.first * sizeof(Instance), range.second * sizeof(Instance), &instances[range.first]);
+		renderer.stats.bufferUploadBytes += range.second * (sizeof(glm::mat4) + sizeof(Instance));
+	}
+	return true;
+}
+
+bool GPUCulling::LoadPending(Scene& scene, const Frustum& frustum)
+{
+	bool loaded = false;
+	for (size_t i = 0; i < pending.size();)
+	{
+		Entity* entity = pending[i];
+		if (entity->boundsProxy < 0 || frustum.Test(scene.bvh.GetBounds(entity->boundsProxy)) == Frustum::Result::Outside)
+		{
+			i++;
+			continue;
+		}
+		// tried once per rebuild, a uuid that does not resolve is not asked for again every frame
+		MeshRendererComponent* meshRendererComponent = entity->GetComponent<MeshRendererComponent>();
+		for (size_t m = 0; meshRendererComponent && m < meshRendererComponent->meshes.size() && m < meshRendererComponent->materials.size(); m++)
+		{
+			const ResourceHandle<Mesh>& meshHandle = meshRendererComponent->meshes[m];
+			const ResourceHandle<MaterialInstance>& materialHandle = meshRendererComponent->materials[m];
+			if (meshHandle.IsLoaded() && materialHandle.IsLoaded() && materialHandle.lock()->shader.IsLoaded()) continue;
+			std::shared_ptr<MaterialInstance> material = materialHandle.lock();
+			if (meshHandle.lock() && material && material->shader.lock()) loaded = true;
+		}
+		pending[i] = pending.back();
+		pending.pop_back();
+	}
+	return loaded;
+}
+
+void GPUCulling::Draw(Scene& scene, const glm::mat4& viewProjection, glm::vec3 cameraPosition, float tanHalfFovY, OcclusionCulling* occlusion)
+{
+	if (!initialised && !Init()) return;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	Frustum frustum(viewProjection);
+	// pending entities are only safe to touch while no entity has been removed since the rebuild
+	bool rebuild = version != scene.entityVersion || LoadPending(scene, frustum);
+	if (!rebuild)
+	{
+		ProfileScope scope("GPUCullingUpdate");
+		rebuild = !UpdateMoved(scene);
+	}
+	if (rebuild)
+	{
+		ProfileScope scope("GPUCullingRebuild");
+		Rebuild(scene);
+	}
+	if (instances.empty()) return;
+	ReadCounts();
+	renderer.stats.culled += culled;
+
+	{
+		ProfileScope scope("GPUCulling");
+		GLuint zero = 0;
+		glClearNamedBufferSubData(buffers[CountBuffer], GL_R32UI, 0, batches.size() * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		// issued as maxDraws commands, the ones nothing was written to must draw nothing
+		if (!renderer.HasIndirectCount())
+		{
+			glClearNamedBufferSubData(buffers[CommandBuffer], GL_R32UI, 0, instances.size() * sizeof(DrawCommand), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		}
+
+		cullShader->Use();
+		cullShader->SetUniform("u_instanceCount", (int)instances.size());
+		cullShader->SetUniform("u_planes", frustum.planes[0], 6);
+		cullShader->SetUniform("u_cameraPos", cameraPosition, 1);
+		cullShader->SetUniform("u_tanHalfFovY", tanHalfFovY);
+		cullShader->SetUniform("u_lodScreenSize", Mesh::LodScreenSize);
+		cullShader->SetUniform("u_lodHysteresis", Mesh::LodHysteresis);
+		cullShader->SetUniform("u_occlusion", occlusion ? 1 : 0);
+		if (occlusion)
+		{
+			glm::mat4 vp = viewProjection;
+			cullShader->SetUniform("u_viewProjection", vp, 1);
+			occlusion->BindPyramid(cullShader, 0);
+		}
+		for (int i = InstanceBuffer; i < BufferCount; i++)
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, buffers[i]);
+		}
+		glDispatchCompute((GLuint)(instances.size() + GroupSize - 1) / GroupSize, 1, 1);
+		// the commands, counts and visible list are read by the draws below, and the counts copied for the stats
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		if (!countFence)
+		{
+			size_t bytes = batches.size() * sizeof(GLuint);
+			if (bytes > countReadbackCapacity)
+			{
+				countReadbackCapacity = std::max(bytes, countReadbackCapacity * 2);
+				glNamedBufferData(countReadback, countReadbackCapacity, nullptr, GL_STREAM_READ);
+			}
+			glCopyNamedBufferSubData(buffers[CountBuffer], countReadback, 0, 0, bytes);
+			countedBatches = batches.size();
+			countedInstances = instances.size();
+			countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TransformBuffer, buffers[TransformBuffer]);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[CommandBuffer]);
+	glBindBuffer(GL_PARAMETER_BUFFER, buffers[CountBuffer]);
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		ProfileScope scope(batchMaterials[i]->name, "Material");
+		batchMaterials[i]->Bind();
+		batchMeshes[i]->DrawIndirect(buffers[VisibleBuffer], batches[i].firstCommand * sizeof(DrawCommand), i * sizeof(GLuint), batchSizes[i]);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+}
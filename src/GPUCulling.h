@@ -0,0 +1,132 @@
+#pragma once
+#include "Graphics.h"
+#include "Bounds.h"
+#include "MeshSimplifier.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class Scene;
+class Entity;
+class Mesh;
+class OcclusionCulling;
+class Shader;
+struct MaterialInstance;
+
+/*
+	GPU driven submission. Every mesh of every entity is an instance with its
+	transform and world bounds in shader storage buffers. Each frame a compute
+	pass tests the instances against the frustum and the occlusion pyramid,
+	picks their level of detail and appends a draw command for each survivor to
+	the range of its batch, one batch per material and mesh pair. The CPU then
+	issues one indirect draw per batch whatever the number of entities.
+
+	Each entity's instances keep their slots until the buffers are rebuilt,
+	which only happens when entities are added or removed, a mesh or material
+	assignment changes, or a resource an entity waits on is loaded. An entity
+	that only moved has its own slots rewritten. Entities whose meshes or
+	materials are not resident get no instances; they are loaded once their
+	bounds come into view, like the CPU path does.
+*/
+class GPUCulling
+{
+public:
+	struct Instance
+	{
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+		// xyz centre, w radius, drives the level of detail
+		glm::vec4 sphere;
+		GLuint batch;
+		GLuint padding[3];
+	};
+
+	struct Batch
+	{
+		GLuint firstCommand;
+		GLuint lodCount;
+		// index count and first index of each level of detail
+		GLuint lods[MeshSimplifier::MaxLods + 1][2];
+	};
+
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	enum
+	{
+		TransformBuffer,
+		InstanceBuffer,
+		BatchBuffer,
+		LodBuffer,
+		CommandBuffer,
+		CountBuffer,
+		VisibleBuffer,
+		BufferCount
+	};
+
+	static const int GroupSize = 64;
+	// more than this fraction of the instances moving in one frame uploads the whole buffers
+	static constexpr float UploadAllFraction = 0.25f;
+
+	~GPUCulling();
+	// occlusion, when given, has already built its pyramid for this frame
+	void Draw(Scene& scene, const glm::mat4& viewProjection, glm::vec3 cameraPosition, float tanHalfFovY, OcclusionCulling* occlusion = nullptr);
+	int GetInstanceCount() const { return (int)instances.size(); }
+	int GetBatchCount() const { return (int)batches.size(); }
+private:
+	// the instances an entity was given at the last rebuild
+	struct EntitySlots
+	{
+		int first = 0;
+		int count = 0;
+		// what the instances were built from, anything else on the entity now means a rebuild
+		std::vector<std::string> meshes;
+		std::vector<std::string> materials;
+	};
+
+	bool Init();
+	void Rebuild(Scene& scene);
+	// rewrites the slots of the entities that moved, false when one of them needs a rebuild instead
+	bool UpdateMoved(Scene& scene);
+	// loads what the pending entities in view wait on, true when anything new became resident
+	bool LoadPending(Scene& scene, const Frustum& frustum);
+	void WriteInstance(int slot, const glm::mat4& transform, const Mesh& mesh);
+	static bool SameAssignment(const EntitySlots& slots, Entity* entity);
+	void Upload(int buffer, const void* data, size_t bytes);
+	// takes the draw counts of the last finished dispatch, if there is one, without waiting
+	void ReadCounts();
+
+	std::shared_ptr<Shader> cullShader;
+	GLuint buffers[BufferCount] = {};
+	size_t capacities[BufferCount] = {};
+	bool initialised = false;
+	// scene entity version the slots were built from, 0 until the first rebuild
+	unsigned int version = 0;
+
+	std::vector<Instance> instances;
+	std::vector<glm::mat4> transforms;
+	std::unordered_map<Entity*, EntitySlots> slots;
+	// entities left out of the last rebuild because a mesh, material or shader was not resident
+	std::vector<Entity*> pending;
+	std::vector<Batch> batches;
+	// what each batch binds and draws, held so the resources stay resident
+	std::vector<std::shared_ptr<MaterialInstance>> batchMaterials;
+	std::vector<std::shared_ptr<Mesh>> batchMeshes;
+	std::vector<GLuint> batchSizes;
+
+	// the per batch draw counts are copied here and read back once the fence passes,
+	// one copy in flight at a time, so the culled count lags the GPU by a few frames
+	GLuint countReadback = 0;
+	size_t countReadbackCapacity = 0;
+	GLsync countFence = nullptr;
+	size_t countedBatches = 0;
+	size_t countedInstances = 0;
+	int culled = 0;
+};
@@ -0,0 +1,156 @@
+#include "JobSystem.h"
+
+// the queue the current thread pushes to and pops from, 0 outside the pool
+static thread_local int threadQueue = 0;
+
+JobSystem::JobSystem(int workerCount)
+{
+	if (workerCount < 0) workerCount = std::max(1, (int)std::thread::hardware_concurrency()) - 1;
+	for (int i = 0; i <= workerCount; i++)
+	{
+		queues.push_back(std::make_unique<Queue>());
+	}
+	for (int i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::Run(Job job, Counter* counter)
+{
+	if (counter) counter->value++;
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::RunAfter(Counter& dependency, Job job, Counter* counter)
+{
+	if (counter) counter->value++;
+	{
+		// Finish takes the continuations under the same lock, so one added here is never missed
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.value.load() != 0)
+		{
+			dependency.continuations.push_back({ std::move(job), counter });
+			return;
+		}
+	}
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+	while (!counter.IsDone())
+	{
+		if (!TryRunOne()) std::this_thread::yield();
+	}
+	// the job that finished it may still hold the lock, the counter can only go away once it lets go
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::Push(QueuedJob job)
+{
+	Queue& queue = *queues[threadQueue];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	pending++;
+	// a worker counts itself sleeping before it checks pending, so it either sees this job or gets woken
+	if (sleeping.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_one();
+	}
+}
+
+bool JobSystem::Pop(int index, QueuedJob& job)
+{
+	Queue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty()) return false;
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool JobSystem::Steal(int index, QueuedJob& job)
+{
+	Queue& queue = *queues[index];
+	// a busy queue is skipped rather than waited on, the next one may have work too
+	std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+	if (!lock.owns_lock() || queue.jobs.empty()) return false;
+	job = std::move(queue.jobs.front());
+	queue.jobs.pop_front();
+	return true;
+}
+
+bool JobSystem::TryRunOne()
+{
+	if (pending.load() == 0) return false;
+	QueuedJob job;
+	int own = threadQueue;
+	if (!Pop(own, job))
+	{
+		bool found = false;
+		int count = (int)queues.size();
+		for (int i = 1; i < count && !found; i++)
+		{
+			found = Steal((own + i) % count, job);
+		}
+		if (!found) return false;
+		stats.stolen++;
+	}
+	pending--;
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(QueuedJob& job)
+{
+	job.job();
+	stats.executed++;
+	if (job.counter) Finish(job.counter);
+}
+
+void JobSystem::Finish(Counter* counter)
+{
+	std::vector<Counter::Continuation> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (--counter->value != 0) return;
+		ready.swap(counter->continuations);
+	}
+	// the counter may be gone from here on
+	for (auto& continuation : ready)
+	{
+		Push({ std::move(continuation.job), continuation.counter });
+	}
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+	threadQueue = index;
+	while (running.load())
+	{
+		if (TryRunOne()) continue;
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping++;
+		wake.wait(lock, [this]() { return pending.load() > 0 || !running.load(); });
+		sleeping--;
+	}
+}
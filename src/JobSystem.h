@@ -0,0 +1,122 @@
+#pragma once
+#include "Singleton.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Work-stealing scheduler for engine tasks. Every worker, and the threads
+	outside the pool together, have a deque of jobs: a thread pushes and pops
+	its own at the back, so it keeps working on what it spawned last while that
+	is still in cache, and an idle thread steals from the front of another's,
+	taking the oldest and usually largest piece of work.
+
+	Jobs are plain functions run to completion, there are no fibres. A Counter
+	tracks unfinished jobs, Wait keeps running other jobs until it reaches zero
+	instead of blocking, and RunAfter queues a continuation that is only
+	scheduled once a counter reaches zero, which chains work without any thread
+	sitting on it.
+*/
+class JobSystem : public Singleton<JobSystem>
+{
+public:
+	typedef std::function<void()> Job;
+
+	// unfinished jobs, must stay alive until it reaches zero and everything waiting on it is done
+	class Counter
+	{
+	public:
+		bool IsDone() const { return value.load() == 0; }
+	private:
+		friend class JobSystem;
+		struct Continuation
+		{
+			Job job;
+			Counter* counter;
+		};
+		std::atomic<int> value = 0;
+		std::mutex mutex;
+		std::vector<Continuation> continuations;
+	};
+
+	// running totals, for the micro-benchmarks
+	struct Stats
+	{
+		std::atomic<long long> executed = 0;
+		std::atomic<long long> stolen = 0;
+	};
+
+	// workers for every core but the calling thread's, which helps out whenever it waits
+	JobSystem(int workerCount = -1);
+	~JobSystem();
+
+	void Run(Job job, Counter* counter = nullptr);
+	// job is scheduled once dependency reaches zero, straight away if it already has
+	void RunAfter(Counter& dependency, Job job, Counter* counter = nullptr);
+	// runs jobs, its own first, until counter reaches zero
+	void Wait(Counter& counter);
+	// task(i) for every i below count, in jobs of grain indices, returns once all are done
+	template <typename Task>
+	void ParallelFor(size_t count, size_t grain, Task task);
+	int GetWorkerCount() const { return (int)workers.size(); }
+	// threads work runs on, the workers and the one waiting
+	int GetThreadCount() const { return (int)workers.size() + 1; }
+
+	Stats stats;
+private:
+	struct QueuedJob
+	{
+		Job job;
+		Counter* counter = nullptr;
+	};
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<QueuedJob> jobs;
+	};
+
+	void Push(QueuedJob job);
+	bool TryRunOne();
+	bool Pop(int queue, QueuedJob& job);
+	bool Steal(int queue, QueuedJob& job);
+	void Execute(QueuedJob& job);
+	void Finish(Counter* counter);
+	void WorkerLoop(int index);
+
+	// queue 0 is shared by every thread outside the pool, worker i owns queue i + 1
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<int> pending = 0;
+	std::atomic<int> sleeping = 0;
+	std::atomic<bool> running = true;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+};
+
+template <typename Task>
+void JobSystem::ParallelFor(size_t count, size_t grain, Task task)
+{
+	if (count == 0) return;
+	grain = std::max<size_t>(grain, 1);
+	if (count <= grain)
+	{
+		for (size_t i = 0; i < count; i++) task(i);
+		return;
+	}
+	Counter counter;
+	for (size_t begin = 0; begin < count; begin += grain)
+	{
+		size_t end = std::min(begin + grain, count);
+		Run([&task, begin, end]()
+		{
+			for (size_t i = begin; i < end; i++) task(i);
+		}, &counter);
+	}
+	Wait(counter);
+}
@@ -1,56 +1,120 @@
 #include "Mesh.h"
+#include "OpenGLRenderer.h"
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
 
 void Mesh::Init(std::shared_ptr<MeshData> data)
 {
 	this->data = data;
-	if (initialised)
-	{
-		glDeleteVertexArrays(1, &vao);
-		glDeleteBuffers(1, &vbo);
-		glDeleteBuffers(1, &ebo);
-		initialised = false;
-	}
+	Release();
 
-	// generate buffers
-	glGenBuffers(1, &vbo);
-	glGenVertexArrays(1, &vao);
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	GLsizeiptr vertexBytes = data->vertices.size() * sizeof(Vertex);
 
-	// bind vertex array
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, data->vertices.size() * sizeof(Vertex), data->vertices.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glBindVertexArray(vao);
+	// every level of detail lives in one index buffer, one after the other
+	std::vector<unsigned short> indices = data->indices;
+	lods.clear();
+	lods.push_back({ (GLsizei)data->indices.size(), 0 });
+	for (auto& lod : data->lods)
+	{
+		lods.push_back({ (GLsizei)lod.size(), indices.size() * sizeof(unsigned short) });
+		indices.insert(indices.end(), lod.begin(), lod.end());
+	}
+	GLsizeiptr indexBytes = indices.size() * sizeof(unsigned short);
 
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, data->indices.size() * sizeof(unsigned short), data->indices.data(), GL_STATIC_DRAW);
+	bounds = AABB();
+	for (auto& vertex : data->vertices)
+	{
+		bounds.Grow(vertex.position);
+	}
+	boundsCenter = data->vertices.empty() ? glm::vec3(0) : bounds.GetCenter();
+	boundsRadius = 0;
+	for (auto& vertex : data->vertices)
+	{
+		boundsRadius = std::max(boundsRadius, glm::length(vertex.position - boundsCenter));
+	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	// immutable storage, created and filled without touching any binding points
+	glCreateBuffers(1, &vbo);
+	glNamedBufferStorage(vbo, vertexBytes, data->vertices.data(), 0);
+	glCreateBuffers(1, &ebo);
+	glNamedBufferStorage(ebo, indexBytes, indices.data(), 0);
 
-	float stride = CalculateStride();
-	int offset = 0;
+	// every attribute reads from vertex buffer binding 0
+	glCreateVertexArrays(1, &vao);
+	glVertexArrayVertexBuffer(vao, 0, vbo, 0, (GLsizei)CalculateStride());
+	glVertexArrayElementBuffer(vao, ebo);
+	GLuint offset = 0;
 	for (int i = 0; i < attributes.size(); i++)
 	{
-		glVertexAttribPointer(i, attributes[i].size, attributes[i].type, GL_FALSE, stride, (void*)offset);
+		glEnableVertexArrayAttrib(vao, i);
+		glVertexArrayAttribFormat(vao, i, attributes[i].size, attributes[i].type, GL_FALSE, offset);
+		glVertexArrayAttribBinding(vao, i, 0);
 		offset += attributes[i].size * attributes[i].dataSize;
-		glEnableVertexAttribArray(i);
 	}
+	// left disabled, DrawIndirect switches it on around its own draws
+	glVertexArrayAttribIFormat(vao, InstanceAttribute, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(vao, InstanceAttribute, 1);
+	glVertexArrayBindingDivisor(vao, 1, 1);
 
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	RenderStats& stats = renderer.stats;
+	stats.bufferUploadBytes += vertexBytes + indexBytes;
 
 	initialised = true;
 }
 
-void Mesh::Draw()
+Mesh::~Mesh()
+{
+	Release();
+}
+
+void Mesh::Release()
 {
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, data->indices.size(), GL_UNSIGNED_SHORT, 0);
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	if (!initialised) return;
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ebo);
+	initialised = false;
+	OpenGLRenderer* renderer = OpenGLRenderer::GetSingletonPtr();
+	if (renderer) renderer->InvalidateState();
+}
+
+void Mesh::Draw(int lod)
+{
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	const Lod& range = lods[std::min(std::max(lod, 0), (int)lods.size() - 1)];
+	// left bound afterwards so consecutive draws of the same mesh skip the rebind
+	renderer.BindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_SHORT, (const void*)range.offset);
+	renderer.stats.drawCalls++;
+	renderer.stats.triangles += range.count / 3;
+}
+
+void Mesh::DrawIndirect(GLuint instanceBuffer, GLintptr commandOffset, GLintptr countOffset, GLsizei maxDraws)
+{
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	renderer.BindVertexArray(vao);
+	// the base instance of each command picks its entry in instanceBuffer
+	glVertexArrayVertexBuffer(vao, 1, instanceBuffer, 0, sizeof(GLuint));
+	glEnableVertexArrayAttrib(vao, InstanceAttribute);
+	renderer.MultiDrawElementsIndirectCount(GL_UNSIGNED_SHORT, commandOffset, countOffset, maxDraws);
+	glDisableVertexArrayAttrib(vao, InstanceAttribute);
+}
+
+int Mesh::SelectLod(float screenSize, int current) const
+{
+	auto threshold = [](int lod) { return LodScreenSize * std::pow(0.5f, (float)(lod - 1)); };
+	current = std::min(std::max(current, 0), (int)lods.size() - 1);
+	while (current + 1 < (int)lods.size() && screenSize < threshold(current + 1) * (1 - LodHysteresis))
+	{
+		current++;
+	}
+	while (current > 0 && screenSize > threshold(current) * (1 + LodHysteresis))
+	{
+		current--;
+	}
+	return current;
 }
 
 void Mesh::AddAttribute(MeshAttribute attribute)
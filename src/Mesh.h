@@ -4,12 +4,15 @@
 #include <vector>
 #include "Graphics.h"
 #include "Resource.h"
+#include "Bounds.h"
 
 struct MeshData
 {
 	std::string name;
 	std::vector<Vertex> vertices;
 	std::vector<unsigned short> indices;
+	// simplified index lists over the same vertices, lods[0] is the first step down from indices
+	std::vector<std::vector<unsigned short>> lods;
 };
 
 
@@ -23,15 +26,42 @@ public:
 		int dataSize;
 	};
 
+	// range of the shared index buffer drawn for one level of detail
+	struct Lod
+	{
+		GLsizei count;
+		size_t offset;
+	};
+
+	// screen height fraction covered by the bounds below which lod 1 is used, each later lod at half the previous size
+	static constexpr float LodScreenSize = 0.25f;
+	// switching back needs the size to move this far past the threshold, stops flicker at the boundary
+	static constexpr float LodHysteresis = 0.15f;
+
+	// instance index of indirect draws, fed from vertex buffer binding 1 one value per instance
+	static const GLuint InstanceAttribute = 6;
+
 	Mesh() = default;
+	~Mesh();
 
 	void Init(std::shared_ptr<MeshData> data);
-	void Draw();
+	void Draw(int lod = 0);
+	int SelectLod(float screenSize, int current) const;
+	int GetLodCount() const { return (int)lods.size(); }
+	const std::vector<Lod>& GetLods() const { return lods; }
+	// draws commands from the bound indirect buffer, instanceBuffer holds the instance index of each command
+	void DrawIndirect(GLuint instanceBuffer, GLintptr commandOffset, GLintptr countOffset, GLsizei maxDraws);
 	void AddAttribute(MeshAttribute attribute);
 	std::shared_ptr<MeshData> data;
+	// bounding box and sphere in model space
+	AABB bounds;
+	glm::vec3 boundsCenter = glm::vec3(0);
+	float boundsRadius = 0;
 private:
+	std::vector<Lod> lods;
 	std::vector<MeshAttribute> attributes;
 	GLuint vbo, ebo, vao;
 	bool initialised = false;
 	float CalculateStride();
+	void Release();
 };
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include "MeshSimplifier.h"
+#include "Mesh.h"
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+// symmetric 4x4 matrix, the upper triangle of the sum of plane outer products
+struct Quadric
+{
+	double a2 = 0, ab = 0, ac = 0, ad = 0;
+	double b2 = 0, bc = 0, bd = 0;
+	double c2 = 0, cd = 0;
+	double d2 = 0;
+
+	void AddPlane(double a, double b, double c, double d)
+	{
+		a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+		b2 += b * b; bc += b * c; bd += b * d;
+		c2 += c * c; cd += c * d;
+		d2 += d * d;
+	}
+
+	void Add(const Quadric& q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+	}
+
+	// sum of squared distances from p to every plane in the quadric
+	double Error(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+			+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+			+ c2 * z * z + 2 * cd * z
+			+ d2;
+	}
+};
+
+struct Collapse
+{
+	double cost;
+	unsigned int from;
+	unsigned int to;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+std::vector<unsigned short> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned short>& indices, size_t targetIndexCount)
+{
+	size_t vertexCount = vertices.size();
+	size_t triangleCount = indices.size() / 3;
+	std::vector<unsigned int> remap(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) remap[i] = (unsigned int)i;
+	auto find = [&](unsigned int v)
+	{
+		while (remap[v] != v)
+		{
+			remap[v] = remap[remap[v]];
+			v = remap[v];
+		}
+		return v;
+	};
+
+	// vertices sharing a position with another vertex sit on a uv or normal seam
+	std::vector<bool> locked(vertexCount, false);
+	{
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				uint32_t bits[3];
+				std::memcpy(bits, &p, sizeof(bits));
+				return bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+			}
+		};
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> positions;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			auto result = positions.emplace(vertices[i].position, (unsigned int)i);
+			if (!result.second)
+			{
+				locked[i] = true;
+				locked[result.first->second] = true;
+			}
+		}
+	}
+
+	// an edge used by a single triangle is on the boundary of the mesh
+	std::unordered_map<uint64_t, int> edgeUses;
+	auto edgeKey = [](unsigned int a, unsigned int b)
+	{
+		return a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+	};
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			edgeUses[edgeKey(indices[t * 3 + e], indices[t * 3 + (e + 1) % 3])]++;
+		}
+	}
+	for (auto& [key, uses] : edgeUses)
+	{
+		if (uses != 1) continue;
+		locked[(unsigned int)(key >> 32)] = true;
+		locked[(unsigned int)(key & 0xFFFFFFFF)] = true;
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	std::vector<std::vector<unsigned int>> vertexTriangles(vertexCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& p0 = vertices[indices[t * 3]].position;
+		const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+		const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length > 0) normal /= length;
+		double d = -glm::dot(normal, p0);
+		for (int c = 0; c < 3; c++)
+		{
+			quadrics[indices[t * 3 + c]].AddPlane(normal.x, normal.y, normal.z, d);
+			vertexTriangles[indices[t * 3 + c]].push_back((unsigned int)t);
+		}
+	}
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+	auto cost = [&](unsigned int from, unsigned int to)
+	{
+		Quadric q = quadrics[from];
+		q.Add(quadrics[to]);
+		return q.Error(vertices[to].position);
+	};
+	for (auto& [key, uses] : edgeUses)
+	{
+		unsigned int a = (unsigned int)(key >> 32);
+		unsigned int b = (unsigned int)(key & 0xFFFFFFFF);
+		if (!locked[a]) queue.push({ cost(a, b), a, b });
+		if (!locked[b]) queue.push({ cost(b, a), b, a });
+	}
+
+	std::vector<bool> removed(triangleCount, false);
+	size_t liveTriangles = triangleCount;
+	// moving a vertex must not turn any of its remaining triangles over
+	auto flips = [&](unsigned int from, unsigned int to)
+	{
+		const glm::vec3& target = vertices[to].position;
+		for (unsigned int t : vertexTriangles[from])
+		{
+			if (removed[t]) continue;
+			unsigned int corners[3] = { find(indices[t * 3]), find(indices[t * 3 + 1]), find(indices[t * 3 + 2]) };
+			if (corners[0] == to || corners[1] == to || corners[2] == to) continue;
+			glm::vec3 before[3], after[3];
+			for (int c = 0; c < 3; c++)
+			{
+				before[c] = vertices[corners[c]].position;
+				after[c] = corners[c] == from ? target : before[c];
+			}
+			glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(oldNormal, newNormal) <= 0) return true;
+		}
+		return false;
+	};
+
+	while (liveTriangles * 3 > targetIndexCount && !queue.empty())
+	{
+		Collapse collapse = queue.top();
+		queue.pop();
+		unsigned int from = collapse.from;
+		if (find(from) != from) continue;
+		unsigned int to = find(collapse.to);
+		if (to == from) continue;
+
+		// quadrics grow as collapses land, stale entries go back in with their current cost
+		double current = cost(from, to);
+		if (to != collapse.to || current > collapse.cost * 1.0001 + 1e-12)
+		{
+			queue.push({ current, from, to });
+			continue;
+		}
+		if (flips(from, to)) continue;
+
+		remap[from] = to;
+		quadrics[to].Add(quadrics[from]);
+		for (unsigned int t : vertexTriangles[from])
+		{
+			if (removed[t]) continue;
+			unsigned int a = find(indices[t * 3]), b = find(indices[t * 3 + 1]), c = find(indices[t * 3 + 2]);
+			if (a == b || b == c || a == c)
+			{
+				removed[t] = true;
+				liveTriangles--;
+				continue;
+			}
+			vertexTriangles[to].push_back(t);
+		}
+		vertexTriangles[from].clear();
+
+		// the neighbours of the merged vertex now see a different quadric
+		for (unsigned int t : vertexTriangles[to])
+		{
+			if (removed[t]) continue;
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int other = find(indices[t * 3 + c]);
+				if (other == to) continue;
+				if (!locked[other]) queue.push({ cost(other, to), other, to });
+				if (!locked[to]) queue.push({ cost(to, other), to, other });
+			}
+		}
+	}
+
+	std::vector<unsigned short> output;
+	output.reserve(liveTriangles * 3);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (removed[t]) continue;
+		for (int c = 0; c < 3; c++)
+		{
+			output.push_back((unsigned short)find(indices[t * 3 + c]));
+		}
+	}
+	return output;
+}
+
+void MeshSimplifier::GenerateLods(MeshData& data, int maxLods)
+{
+	data.lods.clear();
+	// pointers into lods stay valid while it grows
+	data.lods.reserve(maxLods);
+	const std::vector<unsigned short>* previous = &data.indices;
+	for (int i = 0; i < maxLods; i++)
+	{
+		size_t target = (size_t)(previous->size() / 3 * LodReduction) * 3;
+		std::vector<unsigned short> lod = Simplify(data.vertices, *previous, target);
+		// a level that barely shrinks costs memory and a switch for nothing
+		if (lod.empty() || lod.size() > previous->size() * 0.8f) break;
+		data.lods.push_back(std::move(lod));
+		previous = &data.lods.back();
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Vertex.h"
+#include <vector>
+
+struct MeshData;
+
+// Quadric error simplification by edge collapse. Vertices are only ever
+// collapsed onto other existing vertices, so every level of detail indexes the
+// same vertex buffer. Boundary and uv/normal seam vertices never move, which
+// keeps the silhouette of open meshes and avoids cracks along seams.
+namespace MeshSimplifier
+{
+	const int MaxLods = 4;
+	// each level aims for this fraction of the previous level's triangles
+	const float LodReduction = 0.5f;
+
+	std::vector<unsigned short> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned short>& indices, size_t targetIndexCount);
+	// fills data.lods, stops early once a level no longer gets meaningfully smaller
+	void GenerateLods(MeshData& data, int maxLods = MaxLods);
+}
@@ -0,0 +1,219 @@
+#include "OcclusionCulling.h"
+#include "OpenGLRenderer.h"
+#include "Profiler.h"
+#include "components/Scene.h"
+#include <algorithm>
+
+OcclusionCulling::~OcclusionCulling()
+{
+	if (!initialised) return;
+	if (fence) glDeleteSync(fence);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &depthTexture);
+	glDeleteTextures(1, &pyramid);
+	glDeleteBuffers(1, &boundsBuffer);
+	glDeleteBuffers(1, &resultBuffer);
+}
+
+bool OcclusionCulling::Init()
+{
+	depthShader = std::make_shared<Shader>();
+	depthShader->LoadShaderFromFile(GL_VERTEX_SHADER, "Depth.vert");
+	depthShader->Link();
+	pyramidShader = std::make_shared<Shader>();
+	pyramidShader->LoadShaderFromFile(GL_COMPUTE_SHADER, "HiZ.comp");
+	pyramidShader->Link();
+	testShader = std::make_shared<Shader>();
+	testShader->LoadShaderFromFile(GL_COMPUTE_SHADER, "Occlusion.comp");
+	testShader->Link();
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+	glTextureStorage2D(depthTexture, 1, GL_DEPTH_COMPONENT32F, PyramidWidth, PyramidHeight);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+	glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Occlusion pre-pass framebuffer is not complete" << std::endl;
+		return false;
+	}
+
+	pyramidLevels = 1 + (int)std::floor(std::log2((float)std::max(PyramidWidth, PyramidHeight)));
+	glCreateTextures(GL_TEXTURE_2D, 1, &pyramid);
+	glTextureStorage2D(pyramid, pyramidLevels, GL_R32F, PyramidWidth, PyramidHeight);
+	glTextureParameteri(pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateBuffers(1, &boundsBuffer);
+	glCreateBuffers(1, &resultBuffer);
+	initialised = true;
+	return true;
+}
+
+void OcclusionCulling::RenderOccluders(const std::vector<Entity*>& visible, Scene& scene, const glm::mat4& viewProjection, glm::vec3 cameraPosition, float tanHalfFovY)
+{
+	if (!initialised && !Init())
+	{
+		enabled = false;
+		return;
+	}
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+
+	// big on screen means it hides the most
+	std::vector<std::pair<float, Entity*>> candidates;
+	for (Entity* entity : visible)
+	{
+		if (entity->boundsProxy < 0) continue;
+		const AABB& bounds = scene.bvh.GetBounds(entity->boundsProxy);
+		float radius = glm::length(bounds.GetExtents());
+		float distance = glm::length(bounds.GetCenter() - cameraPosition);
+		float screenSize = distance > radius ? radius / (distance * tanHalfFovY) : 1.0f;
+		if (screenSize >= MinOccluderSize) candidates.push_back({ screenSize, entity });
+	}
+	size_t count = std::min(candidates.size(), (size_t)MaxOccluders);
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [](auto& a, auto& b) { return a.first > b.first; });
+	occluders.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		occluders.push_back(candidates[i].second);
+	}
+
+	{
+		ProfileScope scope("OcclusionPrePass");
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		GLint previousFramebuffer;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+		renderer.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, PyramidWidth, PyramidHeight);
+		renderer.SetDepthTest(true);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glm::mat4 vp = viewProjection;
+		depthShader->Use();
+		depthShader->SetUniform("u_viewProjection", vp, 1);
+		for (Entity* occluder : occluders)
+		{
+			glm::mat4 transform = occluder->GetComponent<TransformComponent>()->GetTransform();
+			depthShader->SetUniform("u_modelMatrix", transform, 1);
+			// the full mesh, a simplified one can poke out past the real silhouette
+			for (auto& handle : occluder->GetComponent<MeshRendererComponent>()->meshes)
+			{
+				// a uuid that does not resolve occludes nothing, like RenderQueue skips it
+				std::shared_ptr<Mesh> mesh = handle.lock();
+				if (mesh) mesh->Draw(0);
+			}
+		}
+
+		renderer.BindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	}
+	{
+		ProfileScope scope("HiZPyramid");
+		BuildPyramid();
+	}
+}
+
+void OcclusionCulling::BuildPyramid()
+{
+	pyramidShader->Use();
+	pyramidShader->BindTexture("u_depth", depthTexture, 0);
+	pyramidShader->BindTexture("u_pyramid", pyramid, 1);
+	int width = PyramidWidth, height = PyramidHeight;
+	for (int level = 0; level < pyramidLevels; level++)
+	{
+		// level 0 copies the depth target, each level after reads the one before
+		pyramidShader->SetUniform("u_sourceLevel", level - 1);
+		glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+}
+
+void OcclusionCulling::BindPyramid(std::shared_ptr<Shader> shader, int textureUnit)
+{
+	shader->BindTexture("u_pyramid", pyramid, textureUnit);
+	shader->SetUniform("u_pyramidLevels", pyramidLevels);
+}
+
+void OcclusionCulling::ReadResults(Scene& scene)
+{
+	if (!fence) return;
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED) return;
+	glDeleteSync(fence);
+	fence = nullptr;
+
+	std::vector<GLuint> results(tested.size());
+	glGetNamedBufferSubData(resultBuffer, 0, results.size() * sizeof(GLuint), results.data());
+	for (size_t i = 0; i < tested.size(); i++)
+	{
+		// the entity may have been removed since, and its leaf handed to someone else
+		if (scene.bvh.GetEntity(testedProxies[i]) != tested[i]) continue;
+		tested[i]->occluded = results[i] != 0;
+	}
+}
+
+void OcclusionCulling::Cull(std::vector<Entity*>& visible, Scene& scene, const glm::mat4& viewProjection)
+{
+	if (!initialised) return;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	// never waits, also picks up a test the wait below gave up on last frame
+	ReadResults(scene);
+
+	// one test in flight at a time, a GPU that falls behind just gets asked less often
+	if (!fence)
+	{
+		tested.clear();
+		testedProxies.clear();
+		std::vector<glm::vec4> bounds;
+		for (Entity* entity : visible)
+		{
+			// occluders are tested too, one behind another occluder is as hidden as anything else
+			if (entity->boundsProxy < 0) continue;
+			const AABB& box = scene.bvh.GetBounds(entity->boundsProxy);
+			bounds.push_back(glm::vec4(box.min, 0));
+			bounds.push_back(glm::vec4(box.max, 0));
+			tested.push_back(entity);
+			testedProxies.push_back(entity->boundsProxy);
+		}
+		if (tested.empty()) return;
+
+		if (tested.size() > bufferCapacity)
+		{
+			bufferCapacity = std::max(tested.size(), bufferCapacity * 2);
+			glNamedBufferData(boundsBuffer, bufferCapacity * 2 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+			glNamedBufferData(resultBuffer, bufferCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+		}
+		glNamedBufferSubData(boundsBuffer, 0, bounds.size() * sizeof(glm::vec4), bounds.data());
+		renderer.stats.bufferUploadBytes += bounds.size() * sizeof(glm::vec4);
+
+		glm::mat4 vp = viewProjection;
+		testShader->Use();
+		testShader->SetUniform("u_count", (int)tested.size());
+		testShader->SetUniform("u_viewProjection", vp, 1);
+		BindPyramid(testShader, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, boundsBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, resultBuffer);
+		glDispatchCompute((GLuint)(tested.size() + GroupSize - 1) / GroupSize, 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	if (!latency && fence)
+	{
+		// waits a bounded time for the test just issued, past that the last finished answers are used
+		if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, MaxWaitNanoseconds) != GL_TIMEOUT_EXPIRED)
+		{
+			ReadResults(scene);
+		}
+	}
+
+	size_t before = visible.size();
+	visible.erase(std::remove_if(visible.begin(), visible.end(), [](Entity* entity) { return entity->occluded; }), visible.end());
+	renderer.stats.occluded += (int)(before - visible.size());
+}
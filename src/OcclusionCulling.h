@@ -0,0 +1,70 @@
+#pragma once
+#include "Graphics.h"
+#include "Bounds.h"
+#include <vector>
+#include <memory>
+
+class Scene;
+class Entity;
+class Shader;
+
+/*
+	Hierarchical z occlusion culling. The largest visible entities are drawn
+	depth only into a small target, and a compute pass reduces that depth into
+	a mip pyramid holding the farthest depth of each region. An object whose
+	nearest depth lies behind every pyramid texel its screen rectangle covers is
+	hidden.
+
+	The GPU driven path samples the pyramid straight from its culling shader. The
+	CPU path tests the entities it is about to draw in a compute pass and reads
+	the answers back. With latency on, the answers from the last finished test are
+	used and the readback never waits for the GPU, at the cost of an object that
+	comes out from behind an occluder showing up a frame late. With it off the
+	frame waits a short while for its own answers and falls back to the last
+	finished ones if the GPU is slower than that.
+*/
+class OcclusionCulling
+{
+public:
+	static const int PyramidWidth = 512;
+	static const int PyramidHeight = 256;
+	static const int MaxOccluders = 64;
+	// fraction of the screen height an entity's bounds must cover to be drawn into the pre-pass
+	static constexpr float MinOccluderSize = 0.05f;
+	static const int GroupSize = 64;
+	// longest the main thread waits on this frame's test with latency off, 2 ms
+	static const GLuint64 MaxWaitNanoseconds = 2000000;
+
+	~OcclusionCulling();
+	// draws the occluders among visible and builds the pyramid from them
+	void RenderOccluders(const std::vector<Entity*>& visible, Scene& scene, const glm::mat4& viewProjection, glm::vec3 cameraPosition, float tanHalfFovY);
+	// drops the hidden entities from visible
+	void Cull(std::vector<Entity*>& visible, Scene& scene, const glm::mat4& viewProjection);
+	// binds the pyramid for a shader that runs the same test
+	void BindPyramid(std::shared_ptr<Shader> shader, int textureUnit);
+
+	bool enabled = false;
+	bool latency = true;
+private:
+	bool Init();
+	void BuildPyramid();
+	void ReadResults(Scene& scene);
+
+	std::shared_ptr<Shader> depthShader;
+	std::shared_ptr<Shader> pyramidShader;
+	std::shared_ptr<Shader> testShader;
+	GLuint framebuffer = 0;
+	GLuint depthTexture = 0;
+	GLuint pyramid = 0;
+	int pyramidLevels = 0;
+	GLuint boundsBuffer = 0;
+	GLuint resultBuffer = 0;
+	size_t bufferCapacity = 0;
+	bool initialised = false;
+
+	std::vector<Entity*> occluders;
+	// what the test in flight was asked about, by bvh leaf so removed entities are recognised
+	std::vector<Entity*> tested;
+	std::vector<int> testedProxies;
+	GLsync fence = nullptr;
+};
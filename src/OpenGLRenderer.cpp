@@ -1,109 +1,6 @@
 #include "OpenGLRenderer.h"
 #include "ResourceManager.h"
-
-void OpenGLRenderer::InitRenderBuffer(int width, int height, int samples)
-{
-	std::shared_ptr<FrameBuffer> framebuffer = framebuffers[InputFramebuffer];
-	if (framebuffer == nullptr)
-	{
-		framebuffers[InputFramebuffer] = std::make_shared<FrameBuffer>();
-		framebuffer = framebuffers[InputFramebuffer];
-	}
-	if (framebuffer->initialised)
-	{
-		glDeleteFramebuffers(1, &framebuffer->fbo);
-		glDeleteRenderbuffers(1, &framebuffer->rbo);
-		glDeleteTextures(1, &framebuffer->textureId);
-		framebuffer->initialised = false;
-	}
-
-	glGenFramebuffers(1, &framebuffer->fbo);
-	glGenTextures(1, &framebuffer->textureId);
-	glGenRenderbuffers(1, &framebuffer->rbo);
-	framebuffer->width = width;
-	framebuffer->height = height;
-
-
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, framebuffer->textureId);
-	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_RGBA, width, height, GL_TRUE);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, framebuffer->textureId, 0);
-
-	glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->rbo);
-	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH32F_STENCIL8, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, framebuffer->rbo);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cout << "Frame buffer initialised successfully" << std::endl;
-		framebuffer->initialised = true;
-	}
-	else {
-		std::cout << "Failed to initialise frame buffer" << std::endl;
-		glDeleteFramebuffers(1, &framebuffer->fbo);
-		glDeleteRenderbuffers(1, &framebuffer->rbo);
-		glDeleteTextures(1, &framebuffer->textureId);
-		framebuffer->initialised = false;
-	}
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
-
-	glEnable(GL_DEPTH_TEST);
-}
-
-void OpenGLRenderer::InitFrameBuffer(int width, int height)
-{
-	std::shared_ptr<FrameBuffer> framebuffer = framebuffers[OutputFramebuffer];
-	if (framebuffer == nullptr)
-	{
-		framebuffers[OutputFramebuffer] = std::make_shared<FrameBuffer>();
-		framebuffer = framebuffers[OutputFramebuffer];
-	}
-	if (framebuffer->initialised)
-	{
-		glDeleteFramebuffers(1, &framebuffer->fbo);
-		glDeleteTextures(1, &framebuffer->textureId);
-		framebuffer->initialised = false;
-	}
-
-	glGenFramebuffers(1, &framebuffer->fbo);
-	glGenTextures(1, &framebuffer->textureId);
-	framebuffer->width = width;
-	framebuffer->height = height;
-
-	glBindTexture(GL_TEXTURE_2D, framebuffer->textureId);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, framebuffer->textureId, 0);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cout << "Frame buffer initialised successfully" << std::endl;
-		framebuffer->initialised = true;
-	}
-	else {
-		std::cout << "Failed to initialise frame buffer" << std::endl;
-		glDeleteFramebuffers(1, &framebuffer->fbo);
-		glDeleteTextures(1, &framebuffer->textureId);
-		framebuffer->initialised = false;
-	}
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-}
+#include <cstring>
 
 void OpenGLRenderer::InitCamera(glm::vec3 position, glm::vec3 up, float theta, float phi, float fovY, float aspect, float near, float far)
 {
@@ -141,40 +38,157 @@ void OpenGLRenderer::HandleCameraMovement(float dt, float moveSpeed, float turnS
 
 
 
-void OpenGLRenderer::BindFrameBuffer()
+void OpenGLRenderer::BindTexture(int type, std::string varname, int textureType, int textureUint)
 {
-	std::shared_ptr<FrameBuffer> framebuffer = framebuffers[InputFramebuffer];
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo);
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	ResourceManager& resources = ResourceManager::GetSingleton();
+	resources.shaders[type]->BindTexture(varname, resources.textures[textureType]->id, textureUint);
 }
 
-void OpenGLRenderer::ResolveFrameBuffer(int width, int height)
+void OpenGLRenderer::BindTexture(std::shared_ptr<Shader> shader, std::string varname, std::shared_ptr<Texture> texture, int textureUint)
 {
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[InputFramebuffer]->fbo);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[OutputFramebuffer]->fbo);
-	glViewport(0, 0, width, height);
-	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	shader->BindTexture(varname, texture->id, textureUint);
 }
 
+void OpenGLRenderer::UnbindTexture()
+{
+	BindTextureUnit(0, 0);
+}
 
-void OpenGLRenderer::BindTexture(int type, std::string varname, int textureType, int textureUint)
+void OpenGLRenderer::ResetStats()
 {
-	ResourceManager& resources = ResourceManager::GetSingleton();
-	resources.shaders[type]->BindTexture(varname, resources.textures[textureType]->id, textureUint);
+	lastStats = stats;
+	statsHistory.push_back(stats);
+	if ((int)statsHistory.size() > statsHistorySize)
+	{
+		statsHistory.erase(statsHistory.begin());
+	}
+	stats = RenderStats();
 }
 
-void OpenGLRenderer::BindTexture(std::shared_ptr<Shader> shader, std::string varname, std::shared_ptr<Texture> texture, int textureUint)
+void OpenGLRenderer::UseProgram(GLuint program)
 {
-	shader->BindTexture(varname, texture->id, textureUint);
+	if (state.program == program)
+	{
+		stats.redundantCalls++;
+		return;
+	}
+	glUseProgram(program);
+	state.program = program;
+	stats.programBinds++;
 }
 
-void OpenGLRenderer::UnbindTexture()
+void OpenGLRenderer::BindVertexArray(GLuint vertexArray)
+{
+	if (state.vertexArray == vertexArray)
+	{
+		stats.redundantCalls++;
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	state.vertexArray = vertexArray;
+	stats.vertexArrayBinds++;
+}
+
+void OpenGLRenderer::BindBuffer(GLenum target, GLuint buffer)
+{
+	// the element buffer binding belongs to the bound vertex array, so it is not shadowed here
+	if (target == GL_ARRAY_BUFFER)
+	{
+		if (state.arrayBuffer == buffer)
+		{
+			stats.redundantCalls++;
+			return;
+		}
+		state.arrayBuffer = buffer;
+	}
+	glBindBuffer(target, buffer);
+}
+
+void OpenGLRenderer::BindTextureUnit(int unit, GLuint texture)
 {
-	glBindTexture(GL_TEXTURE_2D, 0);
+	if (unit < (int)GLState::TextureUnitCount && state.textures[unit] == texture)
+	{
+		stats.redundantCalls++;
+		return;
+	}
+	glBindTextureUnit(unit, texture);
+	if (unit < (int)GLState::TextureUnitCount)
+	{
+		state.textures[unit] = texture;
+	}
+	stats.textureBinds++;
 }
 
+void OpenGLRenderer::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	if ((!draw || state.drawFramebuffer == framebuffer) && (!read || state.readFramebuffer == framebuffer))
+	{
+		stats.redundantCalls++;
+		return;
+	}
+	glBindFramebuffer(target, framebuffer);
+	if (draw) state.drawFramebuffer = framebuffer;
+	if (read) state.readFramebuffer = framebuffer;
+	stats.framebufferBinds++;
+}
+
+void OpenGLRenderer::SetDepthTest(bool enabled)
+{
+	if (state.depthTest == (int)enabled)
+	{
+		stats.redundantCalls++;
+		return;
+	}
+	enabled ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+	state.depthTest = enabled;
+}
+
+void OpenGLRenderer::InvalidateState()
+{
+	// everything is unknown again, the next call of each kind goes through to GL
+	state = GLState();
+}
+
+bool OpenGLRenderer::HasIndirectCount()
+{
+	if (!indirectCountLoaded)
+	{
+		indirectCountLoaded = true;
+		if (GLAD_GL_VERSION_4_6)
+		{
+			multiDrawIndirectCount = glMultiDrawElementsIndirectCount;
+			return multiDrawIndirectCount != nullptr;
+		}
+		// some drivers hand out stubs for entry points they do not implement, the extension has to be listed too
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint i = 0; i < extensionCount; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension && std::strcmp(extension, "GL_ARB_indirect_parameters") == 0)
+			{
+				multiDrawIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)glfwGetProcAddress("glMultiDrawElementsIndirectCountARB");
+				break;
+			}
+		}
+	}
+	return multiDrawIndirectCount != nullptr;
+}
+
+void OpenGLRenderer::MultiDrawElementsIndirectCount(GLenum indexType, GLintptr commandOffset, GLintptr countOffset, GLsizei maxDraws)
+{
+	if (HasIndirectCount())
+	{
+		multiDrawIndirectCount(GL_TRIANGLES, indexType, (const void*)commandOffset, countOffset, maxDraws, 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*)commandOffset, maxDraws, 0);
+	}
+	stats.drawCalls++;
+}
 
 void OpenGLRenderer::LinkShaders()
 {
@@ -221,6 +235,15 @@ glm::mat4 OpenGLRenderer::GetProjectionMatrix()
 	return glm::perspective(camera.fovY, camera.aspect, camera.near, camera.far);
 }
 
+glm::mat4 OpenGLRenderer::GetProjectionMatrix(glm::vec2 jitter)
+{
+	glm::mat4 projection = GetProjectionMatrix();
+	// clip w is -z, so the z column moves every depth by the same amount after the divide
+	projection[2][0] -= jitter.x;
+	projection[2][1] -= jitter.y;
+	return projection;
+}
+
 glm::mat4 OpenGLRenderer::GetViewMatrix()
 {
 	glm::vec3 forward(std::cos(camera.phi) * std::cos(camera.theta), std::sin(camera.phi), std::cos(camera.phi) * std::sin(camera.theta));
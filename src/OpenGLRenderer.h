@@ -4,38 +4,83 @@
 #include "Graphics.h"
 #include "Camera.h"
 #include <iostream>
+#include <algorithm>
+#include <iterator>
 #include "InputManager.h"
 #include "Shader.h"
 #include "Model.h"
 #include "UUID.h"
+#include "RenderGraph.h"
+#include "DynamicResolution.h"
+#include "TemporalAA.h"
 //#include "Resource.h"
 //#include "ResourceManager.h"
 
 
 class Texture;
 class Shader;
-struct FrameBuffer
+struct RenderStats
 {
-	GLuint fbo;
-	GLuint rbo;
-	GLuint textureId;
-	bool initialised;
-	int width;
-	int height;
+	int drawCalls = 0;
+	int programBinds = 0;
+	int textureBinds = 0;
+	int vertexArrayBinds = 0;
+	int framebufferBinds = 0;
+	int materialBinds = 0;
+	int uniformUploads = 0;
+	// entities outside the view frustum, never submitted, with GPU culling the instances
+	// the last read back dispatch rejected, occluded ones included
+	int culled = 0;
+	// entities hidden behind the occlusion pre-pass
+	int occluded = 0;
+	// lights uploaded for clustered shading
+	int lights = 0;
+	// entities drawn into the shadow maps, static ones only count when their cached layer is redrawn
+	int shadowCasters = 0;
+	// render graph passes run, and dropped because nothing used what they wrote
+	int passes = 0;
+	int culledPasses = 0;
+	long long triangles = 0;
+	long long uniformBytes = 0;
+	long long bufferUploadBytes = 0;
+	int redundantCalls = 0;
+
+	int GetStateChanges() const { return programBinds + textureBinds + vertexArrayBinds + framebufferBinds; }
 };
 
+// shadow copy of the GL binding state so redundant binds can be dropped,
+// anything that touches GL behind the renderer's back must call InvalidateState
+struct GLState
+{
+	enum : GLuint
+	{
+		TextureUnitCount = 32,
+		Unknown = 0xFFFFFFFF
+	};
+
+	GLuint program = Unknown;
+	GLuint vertexArray = Unknown;
+	GLuint arrayBuffer = Unknown;
+	GLuint drawFramebuffer = Unknown;
+	GLuint readFramebuffer = Unknown;
+	GLuint textures[TextureUnitCount];
+	// -1 until first set
+	int depthTest = -1;
 
+	GLState() { std::fill(std::begin(textures), std::end(textures), (GLuint)Unknown); }
+};
 
 class OpenGLRenderer : public Singleton<OpenGLRenderer>
 {
 public:
-	enum
+	enum class AntiAliasing
 	{
-		InputFramebuffer,
-		OutputFramebuffer,
-		DefaultFramebufferCount
+		// the scene targets take samples multisampled
+		MSAA,
+		// single sampled targets with a jittered projection, accumulated over frames
+		Temporal
 	};
-	
+
 	//enum
 	//{
 	//	PhongShader,
@@ -73,9 +118,6 @@ public:
 	//	DefaultMaterialInstanceCount
 	//};
 
-	void InitRenderBuffer(int width, int height, int samples);
-	void InitFrameBuffer(int width, int height);
-
 	void InitCamera(
 		glm::vec3 position,
 		glm::vec3 up,
@@ -88,8 +130,6 @@ public:
 	);
 
 	void HandleCameraMovement(float dt, float moveSpeed, float turnSpeed);
-	void BindFrameBuffer();
-	void ResolveFrameBuffer(int width, int height);
 	
 	void BindTexture(int type, std::string varname, int textureType, int textureUnit);
 	void BindTexture(std::shared_ptr<Shader> shader, std::string varname, std::shared_ptr<Texture> texture, int textureUnit);
@@ -102,10 +142,41 @@ public:
 	void SetUniform(std::shared_ptr<Shader> shader, std::string varname, int value);
 	void SetUniform(std::shared_ptr<Shader> shader, std::string varname, glm::vec3& value, int count);
 
-	std::vector<std::shared_ptr<FrameBuffer>> framebuffers = std::vector<std::shared_ptr<FrameBuffer>>(DefaultFramebufferCount);
+	void ResetStats();
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertexArray);
+	void BindBuffer(GLenum target, GLuint buffer);
+	void BindTextureUnit(int unit, GLuint texture);
+	void BindFramebuffer(GLenum target, GLuint framebuffer);
+	void SetDepthTest(bool enabled);
+	void InvalidateState();
+
+	// glMultiDrawElementsIndirectCount is core in 4.6, on 4.5 drivers it comes from ARB_indirect_parameters
+	bool HasIndirectCount();
+	// without the count entry point all maxDraws commands are issued, unused ones must have no instances
+	void MultiDrawElementsIndirectCount(GLenum indexType, GLintptr commandOffset, GLintptr countOffset, GLsizei maxDraws);
+
+	// passes of the frame being recorded, and the targets they draw to
+	RenderGraph graph;
+	// samples of the targets the scene is drawn into, the most dynamic resolution will use
+	int samples = 8;
+	DynamicResolution dynamicResolution;
+	AntiAliasing antiAliasing = AntiAliasing::MSAA;
+	TemporalAA temporalAA;
 
 	Camera camera;
+	// counters for the frame being recorded, lastStats and statsHistory hold completed frames
+	RenderStats stats;
+	RenderStats lastStats;
+	std::vector<RenderStats> statsHistory;
+	int statsHistorySize = 240;
+	GLState state;
+	PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC multiDrawIndirectCount = nullptr;
+	bool indirectCountLoaded = false;
 	glm::mat4 GetProjectionMatrix();
+	// the projection shifted by jitter in normalised device coordinates
+	glm::mat4 GetProjectionMatrix(glm::vec2 jitter);
 	glm::mat4 GetViewMatrix();
 	glm::vec3 GetCameraPosition();
 
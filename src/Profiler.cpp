@@ -0,0 +1,175 @@
+#include "Profiler.h"
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+
+void Profiler::BeginFrame()
+{
+	FrameQueries& frame = frames[frameIndex % FrameLatency];
+	if (frame.pending)
+	{
+		Resolve(frame);
+	}
+
+	frame.frame = frameIndex;
+	frame.used = 0;
+	frame.scopes.clear();
+	frame.pending = false;
+	stack.clear();
+	inFrame = enabled;
+}
+
+void Profiler::EndFrame()
+{
+	if (!inFrame) return;
+	while (!stack.empty())
+	{
+		EndScope();
+	}
+	FrameQueries& frame = frames[frameIndex % FrameLatency];
+	frame.pending = frame.scopes.size() > 0;
+	inFrame = false;
+	frameIndex++;
+}
+
+void Profiler::BeginScope(const std::string& name, const std::string& category)
+{
+	if (!inFrame) return;
+	FrameQueries& frame = frames[frameIndex % FrameLatency];
+
+	Scope scope;
+	scope.name = name;
+	scope.category = category;
+	scope.beginQuery = AcquireQuery(frame);
+	scope.endQuery = -1;
+	scope.cpuMs = 0;
+	glQueryCounter(frame.queries[scope.beginQuery], GL_TIMESTAMP);
+	scope.cpuBegin = std::chrono::steady_clock::now();
+
+	frame.scopes.push_back(scope);
+	stack.push_back(frame.scopes.size() - 1);
+}
+
+void Profiler::EndScope()
+{
+	if (!inFrame || stack.empty()) return;
+	FrameQueries& frame = frames[frameIndex % FrameLatency];
+
+	Scope& scope = frame.scopes[stack.back()];
+	stack.pop_back();
+	scope.endQuery = AcquireQuery(frame);
+	glQueryCounter(frame.queries[scope.endQuery], GL_TIMESTAMP);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - scope.cpuBegin;
+	scope.cpuMs = elapsed.count();
+}
+
+void Profiler::CleanUp()
+{
+	for (auto& frame : frames)
+	{
+		if (frame.queries.size() > 0)
+		{
+			glDeleteQueries(frame.queries.size(), frame.queries.data());
+		}
+		frame.queries.clear();
+		frame.scopes.clear();
+		frame.pending = false;
+	}
+}
+
+size_t Profiler::AcquireQuery(FrameQueries& frame)
+{
+	if (frame.used == frame.queries.size())
+	{
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+	return frame.used++;
+}
+
+void Profiler::Resolve(FrameQueries& frame)
+{
+	frame.pending = false;
+
+	// the last query issued finishes last, if it is not ready the frame is dropped rather than waited on
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available == GL_FALSE)
+	{
+		droppedFrames++;
+		return;
+	}
+
+	ProfileFrame result;
+	result.frame = frame.frame;
+	for (auto& scope : frame.scopes)
+	{
+		double gpuMs = 0;
+		if (scope.endQuery != -1)
+		{
+			GLuint64 begin, end;
+			glGetQueryObjectui64v(frame.queries[scope.beginQuery], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.queries[scope.endQuery], GL_QUERY_RESULT, &end);
+			gpuMs = (end - begin) / 1000000.0;
+		}
+
+		auto it = std::find_if(result.samples.begin(), result.samples.end(), [&](const ProfileSample& sample)
+			{
+				return sample.name == scope.name && sample.category == scope.category;
+			}
+		);
+		if (it == result.samples.end())
+		{
+			result.samples.push_back({ scope.name, scope.category, 1, scope.cpuMs, gpuMs });
+		}
+		else
+		{
+			it->count++;
+			it->cpuMs += scope.cpuMs;
+			it->gpuMs += gpuMs;
+		}
+	}
+
+	latest = result;
+	history.push_back(result);
+	if (history.size() > HistorySize)
+	{
+		history.erase(history.begin());
+	}
+}
+
+double Profiler::GetTotal(const ProfileFrame& frame, std::string category, bool gpu)
+{
+	double total = 0;
+	for (auto& sample : frame.samples)
+	{
+		if (sample.category == category)
+		{
+			total += gpu ? sample.gpuMs : sample.cpuMs;
+		}
+	}
+	return total;
+}
+
+bool Profiler::WriteCSV(std::string path)
+{
+	std::ofstream fout(path);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to write profiler capture " << path << std::endl;
+		return false;
+	}
+
+	fout << "frame,category,name,count,cpu_ms,gpu_ms\n";
+	for (auto& frame : history)
+	{
+		for (auto& sample : frame.samples)
+		{
+			fout << frame.frame << "," << sample.category << ",\"" << sample.name << "\","
+				<< sample.count << "," << sample.cpuMs << "," << sample.gpuMs << "\n";
+		}
+	}
+	fout.close();
+	return true;
+}
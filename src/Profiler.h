@@ -0,0 +1,90 @@
+#pragma once
+#include "Singleton.h"
+#include "Graphics.h"
+#include <string>
+#include <vector>
+#include <chrono>
+
+struct ProfileSample
+{
+	std::string name;
+	std::string category;
+	int count;
+	double cpuMs;
+	double gpuMs;
+};
+
+struct ProfileFrame
+{
+	unsigned long long frame;
+	std::vector<ProfileSample> samples;
+};
+
+// CPU scopes are timed with a steady clock, GPU scopes with a pair of
+// GL_TIMESTAMP queries. Query sets are kept in a ring of FrameLatency frames
+// and only read back once the driver reports them available, so the profiler
+// never stalls the pipeline waiting for results.
+class Profiler : public Singleton<Profiler>
+{
+public:
+	enum
+	{
+		FrameLatency = 3,
+		HistorySize = 600
+	};
+
+	void BeginFrame();
+	void EndFrame();
+	void BeginScope(const std::string& name, const std::string& category);
+	void EndScope();
+	void CleanUp();
+
+	bool WriteCSV(std::string path);
+	double GetTotal(const ProfileFrame& frame, std::string category, bool gpu);
+
+	bool enabled = true;
+	unsigned long long frameIndex = 0;
+	unsigned long long droppedFrames = 0;
+	ProfileFrame latest;
+	std::vector<ProfileFrame> history;
+
+private:
+	struct Scope
+	{
+		std::string name;
+		std::string category;
+		int beginQuery;
+		int endQuery;
+		std::chrono::steady_clock::time_point cpuBegin;
+		double cpuMs;
+	};
+
+	struct FrameQueries
+	{
+		unsigned long long frame;
+		bool pending = false;
+		std::vector<GLuint> queries;
+		size_t used = 0;
+		std::vector<Scope> scopes;
+	};
+
+	size_t AcquireQuery(FrameQueries& frame);
+	void Resolve(FrameQueries& frame);
+
+	FrameQueries frames[FrameLatency];
+	std::vector<int> stack;
+	bool inFrame = false;
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(const std::string& name, const std::string& category = "Pass")
+	{
+		Profiler::GetSingleton().BeginScope(name, category);
+	}
+	~ProfileScope()
+	{
+		Profiler::GetSingleton().EndScope();
+	}
+};
@@ -1,9 +1,10 @@
 #include "Program.h"
 
 
-bool Program::InitWindow(int width, int height, std::string title)
+bool Program::InitWindow(int width, int height, std::string title, bool visible)
 {
     if (!glfwInit()) return false;
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     GLFWmonitor* primary = glfwGetPrimaryMonitor();
     glfwGetMonitorContentScale(primary, &dpiScaleX, &dpiScaleY);
@@ -44,27 +45,49 @@ bool Program::InitGUI()
 
 void Program::LoadResources()
 {
-    TextureSerialiser::Deserialise("textures/black.texture");
-    TextureSerialiser::Deserialise("textures/white.texture");
-    TextureSerialiser::Deserialise("textures/soulspear diffuse.texture");
-    TextureSerialiser::Deserialise("textures/soulspear normal.texture");
-    TextureSerialiser::Deserialise("textures/soulspear specular.texture");
-
-    ShaderSerialiser::Deserialise("shaders/Phong.shader");
-    ShaderSerialiser::Deserialise("shaders/Color.shader");
-
-    MaterialSerialiser::Deserialise("base_materials/PhongLighting.material");
-    MaterialSerialiser::Deserialise("base_materials/Color.material");
-
-    MaterialInstanceSerialiser::Deserialise("materials/default.mi");
-    MaterialInstanceSerialiser::Deserialise("materials/SoulspearPhongLighting.mi");
-    MaterialInstanceSerialiser::Deserialise("materials/Color.mi");
-
-    MeshSerialiser::Deserialise("meshes/defaultobject.mesh");
+    // shipping builds read everything out of the packed archive, see --pack, the editor always
+    // works on the loose files and rescans them, an archive on disk would shadow its own saves
+    if (packed && !AssetArchive::GetSingleton().Open("assets.pak"))
+    {
+        std::cout << "Failed to open assets.pak, using the loose files" << std::endl;
+    }
+    // assets are loaded the first time something asks for their uuid, startup only reads the index
+    AssetDatabase::GetSingleton().Open("assets.index");
+}
 
-    ModelSerialiser::Deserialise("models/soulspear.model");
+void Program::LoadScene(std::string path)
+{
+    // the binary scene is written next to the yaml one on save, use it unless the yaml was edited since
+    std::string binaryPath = BinarySceneSerialiser::GetPath(path);
+    std::error_code error;
+    bool hasYAML = std::filesystem::exists(path, error);
+    bool hasBinary = std::filesystem::exists(binaryPath, error);
+    scene = nullptr;
+    // the history shows the last scene
+    OpenGLRenderer::GetSingleton().temporalAA.Reset();
+    // the archive only holds a binary scene that was current when it was packed
+    if (AssetArchive::FindPacked(binaryPath))
+    {
+        scene = BinarySceneSerialiser::Deserialise(binaryPath);
+    }
+    else if (hasBinary && (!hasYAML || std::filesystem::last_write_time(binaryPath, error) >= std::filesystem::last_write_time(path, error)))
+    {
+        scene = BinarySceneSerialiser::Deserialise(binaryPath);
+    }
+    if (!scene)
+    {
+        scene = SceneSerialiser::Deserialise(path);
+    }
 
-    scene = SceneSerialiser::Deserialise("scenes/UntitledScene.scene");
+    // changes saved since the scene files were last written in full, a journal that cannot be
+    // replayed still holds them so it is moved aside for a build that reads it and a new one started
+    std::string journalPath = SceneJournal::GetPath(path);
+    unreplayedJournal.clear();
+    if (Util::FileExists(journalPath) && !SceneJournal::Replay(scene, journalPath) && SceneJournal::SetAside(journalPath).empty())
+    {
+        unreplayedJournal = journalPath;
+    }
+    scene->ClearDirty();
 }
 
 
@@ -168,6 +191,8 @@ bool Program::Init(int width, int height, std::string title)
     
     OpenGLRenderer& renderer = OpenGLRenderer::Create();
     ResourceManager& resources = ResourceManager::Create();
+    AssetDatabase::Create();
+    AssetArchive::Create();
     //renderer.LoadModel("soulspear", "soulspear/soulspear.obj");
 
     ModelConverter converter;
@@ -175,12 +200,14 @@ bool Program::Init(int width, int height, std::string title)
     //scene = std::make_shared<Scene>();
     sceneHierarchy = std::make_shared<SceneHierarchy>();
     inspector = std::make_shared<Inspector>();
+    profilerWindow = std::make_shared<ProfilerWindow>();
+    statsOverlay = std::make_shared<StatsOverlay>();
+    Profiler::Create();
   
-    renderer.InitRenderBuffer(w, h, 4);
-    renderer.InitFrameBuffer(w, h);
     renderer.InitCamera({ 0, 0, 10 }, { 0, 1, 0 }, glm::radians(270.0f), glm::radians(0.0f), glm::radians(45.0f), w / h, 0.1f, 100);
 
     LoadResources();
+    LoadScene("scenes/UntitledScene.scene");
     //converter.Convert(renderer.models[OpenGLRenderer::SoulSpearModel], scene);
 
     renderer.LinkShaders();
@@ -191,10 +218,44 @@ bool Program::Init(int width, int height, std::string title)
     return true;
 }
 
+bool Program::InitHeadless(BenchmarkSettings settings)
+{
+    headless = true;
+    // a hidden window still gives us a default framebuffer and context, which also works on mesa llvmpipe
+    if (!InitWindow(settings.width, settings.height, "App Benchmark", false)) return false;
+    w = settings.width;
+    h = settings.height;
+
+    OpenGLRenderer& renderer = OpenGLRenderer::Create();
+    ResourceManager::Create();
+    AssetDatabase::Create();
+    AssetArchive::Create();
+    Profiler::Create();
+    InputManager::Create();
+
+    renderer.samples = settings.samples;
+    renderer.InitCamera({ 0, 0, 10 }, { 0, 1, 0 }, glm::radians(270.0f), glm::radians(0.0f), glm::radians(45.0f), w / h, 0.1f, 100);
+
+    LoadResources();
+    LoadScene(settings.scenePath);
+    renderer.LinkShaders();
+    return scene != nullptr;
+}
+
+bool Program::RunBenchmark(BenchmarkSettings settings)
+{
+    Benchmark benchmark(settings);
+    return benchmark.Run(scene, window);
+}
+
 void Program::BeginUpdate()
 {
     InputManager::GetSingleton().HadnleInput(window);
+    Profiler::GetSingleton().BeginFrame();
     OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+    renderer.ResetStats();
+    // imgui and the platform windows draw with their own GL state between frames
+    renderer.InvalidateState();
     //renderer.HandleCameraMovement(dt, 5, glm::radians(10.0f));
 
     ImGui_ImplOpenGL3_NewFrame();
@@ -213,13 +274,135 @@ void Program::Update()
         ImGui::Begin("Scene window");
         ImGuiIO& io = ImGui::GetIO();
         ImGui::Text("FPS: %.2f (%.2gms)", io.Framerate, io.Framerate ? 1000.0f / io.Framerate : 0.0f);
+        ImGui::SameLine();
+        ImGui::Checkbox("GPU culling", &scene->gpuDriven);
+        ImGui::SameLine();
+        ImGui::Checkbox("Occlusion", &scene->occlusion.enabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Occlusion latency", &scene->occlusion.latency);
+        ImGui::SameLine();
+        ImGui::Checkbox("Dynamic resolution", &OpenGLRenderer::GetSingleton().dynamicResolution.enabled);
+        ImGui::SameLine();
+        DrawAntiAliasing();
         Draw();
         ImGui::End();
         UpdateGUI();
         EndUpdate();
+        // everything drawn this frame holds its resources, whatever the scene let go of can be unloaded
+        ResourceManager::GetSingleton().Trim();
         double currentTime = glfwGetTime();
         dt = currentTime - previousTime;
         previousTime = currentTime;
+        Autosave();
+    }
+}
+
+void Program::Autosave()
+{
+    if (pendingSave.valid() && pendingSave.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        FinishSceneSave();
+    }
+    if (autosaveInterval <= 0) return;
+
+    autosaveTimer += dt;
+    // a full save still in flight is left alone, the next one starts once it is done
+    if (autosaveTimer >= autosaveInterval && !pendingSave.valid())
+    {
+        autosaveTimer = 0;
+        SaveScene();
+        SaveResources();
+    }
+}
+
+void Program::SaveScene()
+{
+    std::string scenePath = "scenes/" + scene->name + ".scene";
+    std::string journalPath = SceneJournal::GetPath(scenePath);
+
+    // small changes go to the journal, the scene files are only rewritten once it has grown large
+    if (Util::FileExists(scenePath) && !SceneJournal::NeedsCompaction(journalPath))
+    {
+        if (!scene->IsDirty()) return;
+        if (SceneJournal::Append(scene, journalPath))
+        {
+            scene->ClearDirty();
+        }
+        return;
+    }
+
+    SceneSerialiser serialiser(scene);
+    pendingSave = serialiser.SerialiseAsync("scenes/");
+    // cleared now so edits made while the save runs stay dirty, the snapshot puts these back on failure
+    std::vector<std::shared_ptr<Entity>> dirty = scene->GetDirtyEntities();
+    pendingDirty.assign(dirty.begin(), dirty.end());
+    pendingRemoved = scene->removed;
+    scene->ClearDirty();
+}
+
+void Program::FinishSceneSave()
+{
+    // the binary scene goes last so it is newer than the yaml one and gets picked on the next load,
+    // once both are written the journal is folded in and can go
+    std::vector<std::weak_ptr<Entity>> saved;
+    saved.swap(pendingDirty);
+    std::vector<Util::UUID> removed;
+    removed.swap(pendingRemoved);
+    if (!pendingSave.get())
+    {
+        std::cout << "Failed to save scene" << std::endl;
+        // the files on disk and the journal still hold everything from before these edits
+        for (auto& entity : saved)
+        {
+            if (auto alive = entity.lock()) alive->dirty = true;
+        }
+        scene->removed.insert(scene->removed.end(), removed.begin(), removed.end());
+        return;
+    }
+    BinarySceneSerialiser binarySerialiser(scene);
+    if (!binarySerialiser.Serialise("scenes/")) return;
+    std::string journalPath = SceneJournal::GetPath("scenes/" + scene->name + ".scene");
+    if (journalPath == unreplayedJournal)
+    {
+        std::cout << "Keeping scene journal " << journalPath << ", it was never replayed" << std::endl;
+        return;
+    }
+    SceneJournal::Clear(journalPath);
+}
+
+// writes every dirty resource of one kind, true when any file was written
+template <typename T, typename S>
+static bool SaveDirty(std::vector<std::shared_ptr<T>>& resources, std::string folder)
+{
+    bool written = false;
+    for (auto& resource : resources)
+    {
+        if (!resource->dirty) continue;
+        S serialiser = S(resource);
+        if (serialiser.Serialise(folder))
+        {
+            resource->dirty = false;
+            written = true;
+        }
+    }
+    return written;
+}
+
+void Program::SaveResources()
+{
+    ResourceManager& resources = ResourceManager::GetSingleton();
+    // resources created at runtime are only dirty until they have a file, after that Trim can unload them
+    bool written = SaveDirty<Texture, TextureSerialiser>(resources.textures, "textures/");
+    written |= SaveDirty<Shader, ShaderSerialiser>(resources.shaders, "shaders/");
+    written |= SaveDirty<Material, MaterialSerialiser>(resources.materials, "base_materials/");
+    written |= SaveDirty<MaterialInstance, MaterialInstanceSerialiser>(resources.materialInstances, "materials/");
+    written |= SaveDirty<Mesh, MeshSerialiser>(resources.meshes, "meshes/");
+    written |= SaveDirty<Model, ModelSerialiser>(resources.models, "models/");
+
+    // index the new files so an unloaded resource can be loaded again by its uuid
+    if (written)
+    {
+        AssetDatabase::GetSingleton().Refresh();
     }
 }
 
@@ -230,6 +413,7 @@ void Program::UpdateGUI()
     {
         inspector->Update(dt, sceneHierarchy->selected);
     }
+    profilerWindow->Update(dt);
 }
 
 void Program::Draw()
@@ -239,36 +423,81 @@ void Program::Draw()
     OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
     //renderer.Begin(OpenGLRenderer::PhongShader);
     ImVec2 size = ImGui::GetContentRegionAvail();
+    // a collapsed panel has nothing to draw into
+    if (size.x < 1 || size.y < 1) return;
     if (size.x != w || size.y != h)
     {
+        // only the camera has to know, the render graph draws into the corner of targets sized in buckets
         w = size.x;
         h = size.y;
         renderer.camera.aspect = w / h;
-        glViewport(0, 0, w, h);
-        renderer.InitRenderBuffer(w, h, 8);
-        renderer.InitFrameBuffer(w, h);
     }
-    else
+    if (ImGui::IsWindowFocused())
     {
-        if (ImGui::IsWindowFocused())
-        {
-            renderer.HandleCameraMovement(dt, 5, glm::radians(10.0f));
-        }
+        renderer.HandleCameraMovement(dt, 5, glm::radians(10.0f));
+    }
 
-        renderer.BindFrameBuffer();
+    scene->Update(dt);
+    DynamicResolution& resolution = renderer.dynamicResolution;
+    resolution.BeginFrame();
+    renderer.graph.Reset();
+    RenderGraph::Resource color = scene->AddPasses(renderer.graph, resolution.GetSize((int)w), resolution.GetSize((int)h), resolution.GetSamples());
+    renderer.graph.Present(renderer.graph.AddUpscale(color, (int)w, (int)h));
+    renderer.graph.Execute();
+    resolution.EndFrame();
+    renderer.UnbindTexture();
+    renderer.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    glm::vec2 uvScale = renderer.graph.GetOutputUVScale();
+    ImGui::Image((ImTextureID)(intptr_t)renderer.graph.GetOutputTexture(), {size.x, size.y}, ImVec2(0, uvScale.y), ImVec2(uvScale.x, 0));
+    if (ImGui::IsItemClicked(ImGuiMouseButton_Left))
+    {
+        PickEntity(ImGui::GetItemRectMin(), size);
+    }
+    statsOverlay->Update(dt, ImGui::GetItemRectMin());
+}
+
+void Program::DrawAntiAliasing()
+{
+    OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+    const char* modes[] = { "MSAA", "TAA" };
+    int mode = (int)renderer.antiAliasing;
+    ImGui::SetNextItemWidth(80);
+    if (ImGui::Combo("Anti-aliasing", &mode, modes, IM_ARRAYSIZE(modes)))
+    {
+        renderer.antiAliasing = (OpenGLRenderer::AntiAliasing)mode;
+        // whatever the history holds was drawn before TAA was last on
+        renderer.temporalAA.Reset();
+    }
+}
 
-        scene->Update(dt);
-        renderer.UnbindTexture();
-        renderer.ResolveFrameBuffer(w, h);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        ImGui::Image((ImTextureID)renderer.framebuffers[OpenGLRenderer::OutputFramebuffer]->textureId, {size.x, size.y}, ImVec2(0, 1), ImVec2(1, 0));
+void Program::PickEntity(ImVec2 imageMin, ImVec2 imageSize)
+{
+    OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+    ImVec2 mouse = ImGui::GetMousePos();
+    // the image is drawn flipped, so window y grows downwards while ndc y grows upwards
+    float x = 2.0f * (mouse.x - imageMin.x) / imageSize.x - 1.0f;
+    float y = 1.0f - 2.0f * (mouse.y - imageMin.y) / imageSize.y;
+    glm::mat4 inverseViewProjection = glm::inverse(renderer.GetProjectionMatrix() * renderer.GetViewMatrix());
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+    float distance;
+    std::shared_ptr<Entity> entity = scene->Raycast(origin, direction, distance);
+    if (entity)
+    {
+        sceneHierarchy->selected = entity;
     }
 }
 
 void Program::EndUpdate()
 {
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+        ProfileScope scope("ImGui");
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
 
     ImGuiIO& io = ImGui::GetIO();
     if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
@@ -279,53 +508,34 @@ void Program::EndUpdate()
         glfwMakeContextCurrent(backup_current_context);
     }
     scene->CleanUp();
+    Profiler::GetSingleton().EndFrame();
     glfwSwapBuffers(window);
 }
 
 void Program::End()
 {
-
-    SceneSerialiser serialiser(scene);
-    serialiser.Serialise("scenes/");
-    //OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
-    ResourceManager& resources = ResourceManager::GetSingleton();
-
-    //for (int i = 0; i < renderer.materials.size(); i++)
-    //{
-    //    MaterialSerialiser m = MaterialSerialiser(renderer.materials[i]);
-    //    m.Serialise("base_materials/");
-    //}
-
-    for (int i = 0; i < resources.materialInstances.size(); i++)
+    if (headless)
     {
-        MaterialInstanceSerialiser m = MaterialInstanceSerialiser(resources.materialInstances[i]);
-        m.Serialise("materials/");
+        Profiler::GetSingleton().CleanUp();
+        glfwTerminate();
+        return;
     }
 
-    //for (auto& texture : renderer.textures)
-    //{
-    //    TextureSerialiser t = TextureSerialiser(texture);
-    //    t.Serialise("textures/");
-    //}
-
-    for (auto& shader : resources.shaders)
+    // both writers use the same temp file, let a running autosave finish first
+    if (pendingSave.valid())
     {
-        ShaderSerialiser s = ShaderSerialiser(shader);
-        s.Serialise("shaders/");
+        FinishSceneSave();
     }
+    // a full scene save runs on a worker while the resources are saved
+    SaveScene();
+    SaveResources();
 
-    //for (auto& mesh : renderer.meshes)
-    //{
-    //    MeshSerialiser m = MeshSerialiser(mesh);
-    //    m.Serialise("meshes/");
-    //}
-
-    //for (auto& model : renderer.models)
-    //{
-    //    ModelSerialiser m = ModelSerialiser(model);
-    //    m.Serialise("models/");
-    //}
+    if (pendingSave.valid())
+    {
+        FinishSceneSave();
+    }
 
+    Profiler::GetSingleton().CleanUp();
     glfwTerminate();
     // Cleanup GUI related
     ImGui_ImplOpenGL3_Shutdown();
@@ -6,29 +6,54 @@
 #include "Util.h"
 #include "OpenGLRenderer.h"
 #include "InputManager.h"
+#include "AssetDatabase.h"
+#include "AssetArchive.h"
 #include <string>
 #include <memory>
+#include <filesystem>
+#include <future>
 #include "components/Entity.h"
 #include "components/Scene.h"
 #include "components/Serialiser.h"
+#include "components/BinarySerialiser.h"
+#include "components/SceneJournal.h"
 #include "gui/SceneHierarchy.h"
 #include "gui/Inspector.h"
+#include "gui/ProfilerWindow.h"
+#include "gui/StatsOverlay.h"
+#include "Profiler.h"
+#include "Benchmark.h"
 
 class Program
 {
 public:
 	Program() = default;
 	bool Init(int width, int height, std::string title);
+	bool InitHeadless(BenchmarkSettings settings);
 	void Update();
+	bool RunBenchmark(BenchmarkSettings settings);
 	void End();
+
+	// --packed, read assets out of assets.pak instead of the loose files, for shipping builds.
+	// The editor leaves it off so what it saves is what it loads.
+	bool packed = false;
 private:
-	bool InitWindow(int width, int height, std::string title);
+	bool InitWindow(int width, int height, std::string title, bool visible = true);
 	bool InitGUI();
 	void LoadResources();
+	void LoadScene(std::string path);
 	void BeginUpdate();
 	void UpdateGUI();
 	void Draw();
+	// the MSAA or TAA switch in the scene window
+	void DrawAntiAliasing();
+	// selects the entity under the mouse in the scene image
+	void PickEntity(ImVec2 imageMin, ImVec2 imageSize);
 	void EndUpdate();
+	void Autosave();
+	void SaveScene();
+	void FinishSceneSave();
+	void SaveResources();
 	void SetGUITheme();
 private:
 	float w, h;
@@ -40,5 +65,19 @@ private:
 	std::shared_ptr<Scene> scene;
 	std::shared_ptr<SceneHierarchy> sceneHierarchy;
 	std::shared_ptr<Inspector> inspector;
+	std::shared_ptr<ProfilerWindow> profilerWindow;
+	std::shared_ptr<StatsOverlay> statsOverlay;
+	bool headless = false;
+	// seconds between background scene saves, 0 turns autosave off
+	float autosaveInterval = 120.0f;
+	float autosaveTimer = 0.0f;
+	// full scene write running on a worker, finished off by FinishSceneSave
+	std::future<bool> pendingSave;
+	// what the pending save wrote, marked dirty again if it fails
+	std::vector<std::weak_ptr<Entity>> pendingDirty;
+	std::vector<Util::UUID> pendingRemoved;
+	// journal of the loaded scene that Replay refused and could not be moved aside, never cleared so a
+	// build that reads it can
+	std::string unreplayedJournal;
 
 };
\ No newline at end of file
@@ -0,0 +1,525 @@
+#include "RenderGraph.h"
+#include "OpenGLRenderer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <climits>
+
+void RenderGraph::Pass::Read(Resource resource, Access access)
+{
+	reads.push_back({ resource, access });
+}
+
+void RenderGraph::Pass::Write(Resource resource, Access access)
+{
+	writes.push_back({ resource, access });
+}
+
+RenderGraph::~RenderGraph()
+{
+	for (auto& framebuffer : framebuffers)
+	{
+		glDeleteFramebuffers(1, &framebuffer.second);
+	}
+	for (auto& texture : pool)
+	{
+		glDeleteTextures(1, &texture.id);
+	}
+}
+
+void RenderGraph::Reset()
+{
+	passes.clear();
+	resources.clear();
+	output = InvalidResource;
+}
+
+RenderGraph::Resource RenderGraph::CreateTexture(std::string name, const TextureDesc& desc)
+{
+	ResourceNode node;
+	node.name = name;
+	node.desc = desc;
+	resources.push_back(node);
+	return (Resource)resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::ImportTexture(std::string name, GLuint texture, const TextureDesc& desc)
+{
+	ResourceNode node;
+	node.name = name;
+	node.desc = desc;
+	node.imported = true;
+	node.id = texture;
+	resources.push_back(node);
+	return (Resource)resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::ImportBuffer(std::string name, GLuint buffer)
+{
+	ResourceNode node;
+	node.name = name;
+	node.isBuffer = true;
+	node.imported = true;
+	node.id = buffer;
+	resources.push_back(node);
+	return (Resource)resources.size() - 1;
+}
+
+RenderGraph::Pass& RenderGraph::AddPass(std::string name, std::function<void()> execute)
+{
+	passes.push_back(std::make_unique<Pass>());
+	passes.back()->name = name;
+	passes.back()->execute = execute;
+	return *passes.back();
+}
+
+void RenderGraph::Present(Resource resource)
+{
+	output = resource;
+}
+
+GLuint RenderGraph::GetTexture(Resource resource) const
+{
+	const ResourceNode& node = resources[resource];
+	if (node.imported) return node.id;
+	return node.physical >= 0 ? pool[node.physical].id : 0;
+}
+
+GLuint RenderGraph::GetBuffer(Resource resource) const
+{
+	return resources[resource].id;
+}
+
+const RenderGraph::TextureDesc& RenderGraph::GetDesc(Resource resource) const
+{
+	return resources[resource].desc;
+}
+
+GLuint RenderGraph::GetOutputTexture() const
+{
+	return output == InvalidResource ? 0 : GetTexture(output);
+}
+
+glm::vec2 RenderGraph::GetUVScale(Resource resource) const
+{
+	const ResourceNode& node = resources[resource];
+	if (node.imported || node.physical < 0) return glm::vec2(1.0f);
+	const TextureDesc& allocated = pool[node.physical].desc;
+	return glm::vec2((float)node.desc.width / allocated.width, (float)node.desc.height / allocated.height);
+}
+
+glm::vec2 RenderGraph::GetOutputUVScale() const
+{
+	return output == InvalidResource ? glm::vec2(1.0f) : GetUVScale(output);
+}
+
+RenderGraph::Resource RenderGraph::AddUpscale(Resource source, int width, int height)
+{
+	TextureDesc desc = resources[source].desc;
+	if (desc.width == width && desc.height == height) return source;
+	desc.width = width;
+	desc.height = height;
+	desc.samples = 1;
+	Resource target = CreateTexture(resources[source].name + "Upscaled", desc);
+	// the pass looks at its own reads when it runs, so its function is only set once it exists
+	Pass* upscale = &AddPass("Upscale" + resources[source].name, nullptr);
+	// sampled so a multisampled source gets resolved first, which the blit reads in its place
+	upscale->Read(source, Access::Sampled);
+	upscale->Write(target, Access::Transfer);
+	upscale->execute = [this, upscale, target]()
+	{
+		Resource from = upscale->reads[0].resource;
+		const TextureDesc& fromDesc = resources[from].desc;
+		const TextureDesc& toDesc = resources[target].desc;
+		glBlitNamedFramebuffer(GetFramebuffer({ GetTexture(from) }, 0, 0), GetFramebuffer({ GetTexture(target) }, 0, 0),
+			0, 0, fromDesc.width, fromDesc.height, 0, 0, toDesc.width, toDesc.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	};
+	return target;
+}
+
+void RenderGraph::Execute()
+{
+	{
+		ProfileScope scope("CompileRenderGraph");
+		InsertResolves();
+		CullPasses();
+		AllocateTextures();
+		ReleaseUnused();
+	}
+	for (auto& resource : resources)
+	{
+		resource.storageWritten = false;
+	}
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	for (auto& pass : passes)
+	{
+		if (pass->culled)
+		{
+			renderer.stats.culledPasses++;
+			continue;
+		}
+		RunPass(*pass);
+		renderer.stats.passes++;
+	}
+	// whoever shows the output samples it once the graph is done
+	if (output != InvalidResource && resources[output].storageWritten) glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+std::unique_ptr<RenderGraph::Pass> RenderGraph::MakeResolve(Resource source, Resource target)
+{
+	auto blit = std::make_unique<Pass>();
+	blit->name = "Resolve" + resources[source].name;
+	blit->Read(source, Access::Transfer);
+	blit->Write(target, Access::Transfer);
+	blit->execute = [this, source, target]()
+	{
+		const TextureDesc& desc = resources[source].desc;
+		bool depth = IsDepthFormat(desc.format);
+		GLenum attachment = HasStencil(desc.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		GLuint from = depth ? GetFramebuffer({}, GetTexture(source), attachment) : GetFramebuffer({ GetTexture(source) }, 0, 0);
+		GLuint to = depth ? GetFramebuffer({}, GetTexture(target), attachment) : GetFramebuffer({ GetTexture(target) }, 0, 0);
+		glBlitNamedFramebuffer(from, to, 0, 0, desc.width, desc.height, 0, 0, desc.width, desc.height, depth ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	};
+	return blit;
+}
+
+void RenderGraph::InsertResolves()
+{
+	// returns the single sampled copy of source, true in fresh when a resolve has to be added for it
+	auto resolve = [this](Resource source, bool& fresh)
+	{
+		fresh = resources[source].resolved == InvalidResource;
+		if (!fresh) return resources[source].resolved;
+		TextureDesc desc = resources[source].desc;
+		desc.samples = 1;
+		Resource target = CreateTexture(resources[source].name + "Resolved", desc);
+		resources[source].resolved = target;
+		return target;
+	};
+
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		Pass& pass = *passes[i];
+		std::vector<std::pair<Resource, Resource>> needed;
+		for (auto& read : pass.reads)
+		{
+			const ResourceNode& node = resources[read.resource];
+			if (node.isBuffer || node.desc.samples <= 1 || read.access != Access::Sampled) continue;
+			bool fresh;
+			Resource target = resolve(read.resource, fresh);
+			if (fresh) needed.push_back({ read.resource, target });
+			read.resource = target;
+		}
+		for (auto& write : pass.writes)
+		{
+			resources[write.resource].resolved = InvalidResource;
+		}
+
+		// the resolves run just before the first pass that samples them
+		for (auto& pair : needed)
+		{
+			passes.insert(passes.begin() + i, MakeResolve(pair.first, pair.second));
+			i++;
+		}
+	}
+
+	// what is shown is sampled by the GUI, so it is resolved after everything else
+	if (output != InvalidResource && resources[output].desc.samples > 1)
+	{
+		Resource source = output;
+		bool fresh;
+		output = resolve(source, fresh);
+		if (fresh) passes.push_back(MakeResolve(source, output));
+	}
+}
+
+void RenderGraph::CullPasses()
+{
+	// walked backwards, a pass is needed when a later needed pass reads something it writes
+	std::vector<bool> needed(resources.size(), false);
+	if (output != InvalidResource) needed[output] = true;
+	for (int i = (int)passes.size() - 1; i >= 0; i--)
+	{
+		Pass& pass = *passes[i];
+		pass.culled = !pass.sideEffects;
+		for (auto& write : pass.writes)
+		{
+			if (needed[write.resource]) pass.culled = false;
+		}
+		if (pass.culled) continue;
+		for (auto& read : pass.reads)
+		{
+			needed[read.resource] = true;
+		}
+	}
+}
+
+void RenderGraph::AllocateTextures()
+{
+	for (auto& resource : resources)
+	{
+		resource.firstUse = -1;
+		resource.lastUse = -1;
+		resource.physical = -1;
+	}
+	for (int i = 0; i < (int)passes.size(); i++)
+	{
+		if (passes[i]->culled) continue;
+		for (auto* uses : { &passes[i]->reads, &passes[i]->writes })
+		{
+			for (auto& use : *uses)
+			{
+				ResourceNode& node = resources[use.resource];
+				if (node.firstUse < 0) node.firstUse = i;
+				node.lastUse = i;
+			}
+		}
+	}
+	// the presented texture has to outlive the frame
+	if (output != InvalidResource) resources[output].lastUse = INT_MAX;
+
+	for (auto& texture : pool)
+	{
+		texture.busyUntil = -1;
+		texture.used = false;
+		texture.oversized = false;
+	}
+	std::vector<Resource> order;
+	for (Resource r = 0; r < (Resource)resources.size(); r++)
+	{
+		if (!resources[r].imported && resources[r].firstUse >= 0) order.push_back(r);
+	}
+	std::sort(order.begin(), order.end(), [this](Resource a, Resource b) { return resources[a].firstUse < resources[b].firstUse; });
+
+	for (Resource r : order)
+	{
+		ResourceNode& node = resources[r];
+		// anything whose last user ran before this one's first is free to alias, unless it is due to be released,
+		// the smallest that fits so a texture from a bigger size is left to run out its time
+		for (int p = 0; p < (int)pool.size(); p++)
+		{
+			const PhysicalTexture& texture = pool[p];
+			if (!Fits(texture.desc, node.desc) || texture.busyUntil >= node.firstUse || texture.idleFrames > ShrinkFrames) continue;
+			if (node.physical < 0 || texture.desc.width * texture.desc.height < pool[node.physical].desc.width * pool[node.physical].desc.height) node.physical = p;
+		}
+		if (node.physical < 0)
+		{
+			PhysicalTexture texture;
+			texture.desc = node.desc;
+			texture.desc.width = GetBucketSize(node.desc.width);
+			texture.desc.height = GetBucketSize(node.desc.height);
+			GLenum target = texture.desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : texture.desc.layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+			glCreateTextures(target, 1, &texture.id);
+			if (texture.desc.samples > 1)
+			{
+				glTextureStorage2DMultisample(texture.id, texture.desc.samples, texture.desc.format, texture.desc.width, texture.desc.height, GL_TRUE);
+			}
+			else
+			{
+				if (texture.desc.layers > 1)
+				{
+					glTextureStorage3D(texture.id, 1, texture.desc.format, texture.desc.width, texture.desc.height, texture.desc.layers);
+				}
+				else
+				{
+					glTextureStorage2D(texture.id, 1, texture.desc.format, texture.desc.width, texture.desc.height);
+				}
+				glTextureParameteri(texture.id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTextureParameteri(texture.id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glTextureParameteri(texture.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTextureParameteri(texture.id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			}
+			pool.push_back(texture);
+			node.physical = (int)pool.size() - 1;
+		}
+		PhysicalTexture& texture = pool[node.physical];
+		texture.busyUntil = node.lastUse;
+		texture.used = true;
+		if (texture.desc.width > GetBucketSize(node.desc.width) || texture.desc.height > GetBucketSize(node.desc.height)) texture.oversized = true;
+	}
+	for (auto& texture : pool)
+	{
+		texture.idleFrames = texture.used && !texture.oversized ? 0 : texture.idleFrames + 1;
+	}
+}
+
+void RenderGraph::ReleaseUnused()
+{
+	// a texture that has gone without a use for a while is from an old size or a pass that is gone,
+	// an oversized one stops being handed out and goes once its last holder has let it go
+	bool released = false;
+	for (int p = (int)pool.size() - 1; p >= 0; p--)
+	{
+		if (pool[p].used || pool[p].idleFrames <= ShrinkFrames) continue;
+		GLuint id = pool[p].id;
+		for (auto it = framebuffers.begin(); it != framebuffers.end();)
+		{
+			if (std::find(it->first.begin(), it->first.end(), id) != it->first.end())
+			{
+				glDeleteFramebuffers(1, &it->second);
+				it = framebuffers.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+		glDeleteTextures(1, &id);
+		pool.erase(pool.begin() + p);
+		for (auto& resource : resources)
+		{
+			if (resource.physical > p) resource.physical--;
+		}
+		released = true;
+	}
+	if (released)
+	{
+		// deleted names can be handed out again, drop anything the cache remembers about them
+		OpenGLRenderer::GetSingleton().InvalidateState();
+	}
+}
+
+GLbitfield RenderGraph::GetBarrier(Pass& pass)
+{
+	GLbitfield barrier = 0;
+	for (auto& read : pass.reads)
+	{
+		if (!resources[read.resource].storageWritten) continue;
+		switch (read.access)
+		{
+		case Access::Sampled:
+			barrier |= GL_TEXTURE_FETCH_BARRIER_BIT;
+			break;
+		case Access::Storage:
+			barrier |= GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+			break;
+		case Access::Indirect:
+			barrier |= GL_COMMAND_BARRIER_BIT;
+			break;
+		case Access::Attachment:
+		case Access::Transfer:
+			barrier |= GL_FRAMEBUFFER_BARRIER_BIT;
+			break;
+		}
+		resources[read.resource].storageWritten = false;
+	}
+	return barrier;
+}
+
+void RenderGraph::RunPass(Pass& pass)
+{
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	GLbitfield barrier = GetBarrier(pass);
+	if (barrier) glMemoryBarrier(barrier);
+
+	std::vector<GLuint> colors;
+	GLuint depth = 0;
+	GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+	TextureDesc size;
+	for (auto& write : pass.writes)
+	{
+		if (write.access != Access::Attachment) continue;
+		const ResourceNode& node = resources[write.resource];
+		size = node.desc;
+		if (IsDepthFormat(node.desc.format))
+		{
+			depth = GetTexture(write.resource);
+			depthAttachment = HasStencil(node.desc.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		}
+		else
+		{
+			colors.push_back(GetTexture(write.resource));
+		}
+	}
+	if (!pass.manualTargets && (!colors.empty() || depth))
+	{
+		GLuint framebuffer = GetFramebuffer(colors, depth, depthAttachment);
+		renderer.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, size.width, size.height);
+		if (pass.clear)
+		{
+			const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			for (int i = 0; i < (int)colors.size(); i++)
+			{
+				glClearNamedFramebufferfv(framebuffer, GL_COLOR, i, black);
+			}
+			const GLfloat far = 1.0f;
+			if (depth && depthAttachment == GL_DEPTH_STENCIL_ATTACHMENT)
+			{
+				glClearNamedFramebufferfi(framebuffer, GL_DEPTH_STENCIL, 0, far, 0);
+			}
+			else if (depth)
+			{
+				glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &far);
+			}
+		}
+	}
+
+	{
+		ProfileScope scope(pass.name, "RenderPass");
+		pass.execute();
+	}
+
+	for (auto& write : pass.writes)
+	{
+		ResourceNode& node = resources[write.resource];
+		node.storageWritten = write.access == Access::Storage;
+	}
+}
+
+GLuint RenderGraph::GetFramebuffer(const std::vector<GLuint>& colors, GLuint depth, GLenum depthAttachment)
+{
+	std::vector<GLuint> key = colors;
+	key.push_back(depth);
+	auto it = framebuffers.find(key);
+	if (it != framebuffers.end()) return it->second;
+
+	GLuint framebuffer;
+	glCreateFramebuffers(1, &framebuffer);
+	std::vector<GLenum> drawBuffers;
+	for (int i = 0; i < (int)colors.size(); i++)
+	{
+		glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0 + i, colors[i], 0);
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+	if (depth)
+	{
+		glNamedFramebufferTexture(framebuffer, depthAttachment, depth, 0);
+	}
+	if (drawBuffers.empty())
+	{
+		glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+		glNamedFramebufferReadBuffer(framebuffer, GL_NONE);
+	}
+	else
+	{
+		glNamedFramebufferDrawBuffers(framebuffer, (GLsizei)drawBuffers.size(), drawBuffers.data());
+	}
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Render graph framebuffer is not complete" << std::endl;
+	}
+	framebuffers[key] = framebuffer;
+	return framebuffer;
+}
+
+int RenderGraph::GetBucketSize(int size)
+{
+	int padded = size + size / 8;
+	return (padded + SizeGranularity - 1) / SizeGranularity * SizeGranularity;
+}
+
+bool RenderGraph::Fits(const TextureDesc& texture, const TextureDesc& desc)
+{
+	return texture.format == desc.format && texture.samples == desc.samples && texture.layers == desc.layers
+		&& texture.width >= desc.width && texture.height >= desc.height;
+}
+
+bool RenderGraph::IsDepthFormat(GLenum format)
+{
+	return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32 || format == GL_DEPTH_COMPONENT32F || HasStencil(format);
+}
+
+bool RenderGraph::HasStencil(GLenum format)
+{
+	return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include "Graphics.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+
+/*
+	Frame graph the renderer's passes are recorded into. Each pass declares the
+	textures and buffers it reads and writes, then the graph works out the rest
+	when it is executed:
+
+	- passes whose writes nothing later reads, and that are not the presented
+	  target, are dropped
+	- a multisampled texture that is sampled or presented gets a resolve pass
+	  inserted in front of the reader
+	- a reader of something a compute pass wrote through storage gets the memory
+	  barrier its kind of access needs
+	- transient textures only live from their first to their last use, ones
+	  with the same description share a texture when those ranges do not
+	  overlap, and textures kept from earlier frames are reused
+
+	Textures are allocated in size buckets with some slack and a pass draws into
+	the corner its resource's size asks for, so a target that grows by a pixel
+	does not mean new memory. One that stays unused or well oversized for
+	ShrinkFrames frames is released, and the next frame gets a tighter one.
+	Readers scale their texture coordinates by GetUVScale.
+
+	The graph is rebuilt every frame, only the textures and the framebuffers
+	made from them carry over. Imported textures and buffers belong to whoever
+	imported them and are never aliased.
+*/
+class RenderGraph
+{
+public:
+	// index of a texture or buffer in this frame's graph
+	typedef int Resource;
+	static const Resource InvalidResource = -1;
+
+	enum class Access
+	{
+		// read through a sampler
+		Sampled,
+		// shader storage buffers and image load/store
+		Storage,
+		// indirect draw or dispatch arguments
+		Indirect,
+		// drawn to as a framebuffer attachment
+		Attachment,
+		// copied or blitted from or to
+		Transfer,
+	};
+
+	struct TextureDesc
+	{
+		int width = 0;
+		int height = 0;
+		GLenum format = GL_RGBA8;
+		int samples = 1;
+		int layers = 1;
+	};
+
+	// texture sizes are rounded up to a multiple of this, after an eighth is added for slack
+	static const int SizeGranularity = 64;
+	// frames a pooled texture can sit unused or oversized before it is released
+	static const int ShrinkFrames = 120;
+
+	class Pass
+	{
+	public:
+		void Read(Resource resource, Access access);
+		void Write(Resource resource, Access access);
+
+		std::string name;
+		std::function<void()> execute;
+		// attachments are cleared before the pass runs, black and the far plane
+		bool clear = false;
+		// the pass binds its own framebuffer, for drawing into single layers of an array
+		bool manualTargets = false;
+		// kept even if nothing reads what it writes, for passes that read back to the CPU
+		bool sideEffects = false;
+	private:
+		friend class RenderGraph;
+		struct Use
+		{
+			Resource resource;
+			Access access;
+		};
+		std::vector<Use> reads;
+		std::vector<Use> writes;
+		bool culled = false;
+	};
+
+	~RenderGraph();
+	// forgets the last frame's passes and resources, its textures stay pooled
+	void Reset();
+	Resource CreateTexture(std::string name, const TextureDesc& desc);
+	Resource ImportTexture(std::string name, GLuint texture, const TextureDesc& desc);
+	Resource ImportBuffer(std::string name, GLuint buffer);
+	// the returned pass stays valid until Reset
+	Pass& AddPass(std::string name, std::function<void()> execute);
+	// a pass that stretches a colour texture over a new single sampled one of this size with bilinear
+	// filtering, source itself when it already is that size
+	Resource AddUpscale(Resource source, int width, int height);
+	// the texture shown once the frame is done, the graph keeps it single sampled and alive until Reset
+	void Present(Resource resource);
+	void Execute();
+
+	// the GL name behind a resource, for textures only once the graph is executing
+	GLuint GetTexture(Resource resource) const;
+	GLuint GetBuffer(Resource resource) const;
+	const TextureDesc& GetDesc(Resource resource) const;
+	GLuint GetOutputTexture() const;
+	// the part of the texture behind a resource that its size covers, pooled textures can be larger
+	glm::vec2 GetUVScale(Resource resource) const;
+	glm::vec2 GetOutputUVScale() const;
+	int GetPooledTextureCount() const { return (int)pool.size(); }
+	// the size a texture for this dimension is allocated at
+	static int GetBucketSize(int size);
+private:
+	struct ResourceNode
+	{
+		std::string name;
+		TextureDesc desc;
+		bool isBuffer = false;
+		bool imported = false;
+		GLuint id = 0;
+		// index into pool for transient textures
+		int physical = -1;
+		int firstUse = -1;
+		int lastUse = -1;
+		// how the last pass to write it did so, storage writes need a barrier before they are read
+		bool storageWritten = false;
+		// the single sampled copy made for samplers, valid until the next write
+		Resource resolved = InvalidResource;
+	};
+
+	struct PhysicalTexture
+	{
+		GLuint id = 0;
+		// the allocated size, at least that of every resource it holds
+		TextureDesc desc;
+		// last pass of the resource holding it this frame, -1 when free
+		int busyUntil = -1;
+		bool used = false;
+		// a bucket or more larger than what it held this frame
+		bool oversized = false;
+		// frames in a row it was unused or oversized
+		int idleFrames = 0;
+	};
+
+	std::unique_ptr<Pass> MakeResolve(Resource source, Resource target);
+	void InsertResolves();
+	void CullPasses();
+	void AllocateTextures();
+	void ReleaseUnused();
+	void RunPass(Pass& pass);
+	GLbitfield GetBarrier(Pass& pass);
+	GLuint GetFramebuffer(const std::vector<GLuint>& colors, GLuint depth, GLenum depthAttachment);
+	static bool Fits(const TextureDesc& texture, const TextureDesc& desc);
+	static bool IsDepthFormat(GLenum format);
+	static bool HasStencil(GLenum format);
+
+	std::vector<std::unique_ptr<Pass>> passes;
+	std::vector<ResourceNode> resources;
+	Resource output = InvalidResource;
+	std::vector<PhysicalTexture> pool;
+	// framebuffers by their attachments, colours in order then depth
+	std::map<std::vector<GLuint>, GLuint> framebuffers;
+};
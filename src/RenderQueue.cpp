@@ -0,0 +1,118 @@
+#include "RenderQueue.h"
+#include "OpenGLRenderer.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+#include "components/Scene.h"
+#include <algorithm>
+
+void RenderQueue::RecordEntity(Entity* entity, Recording& recording, glm::vec3 cameraPosition, float tanHalfFovY, bool canLoad)
+{
+	TransformComponent* transformComponent = entity->GetComponent<TransformComponent>();
+	MeshRendererComponent* meshRendererComponent = entity->GetComponent<MeshRendererComponent>();
+	if (!transformComponent || !meshRendererComponent) return;
+
+	if (!canLoad)
+	{
+		for (size_t i = 0; i < meshRendererComponent->meshes.size(); i++)
+		{
+			const ResourceHandle<MaterialInstance>& material = meshRendererComponent->materials[i];
+			if (!meshRendererComponent->meshes[i].IsLoaded() || !material.IsLoaded() || !material.lock()->shader.IsLoaded())
+			{
+				recording.deferred.push_back(entity);
+				return;
+			}
+		}
+	}
+
+	int transform = (int)recording.transforms.size();
+	recording.transforms.push_back(transformComponent->GetTransform());
+	for (size_t i = 0; i < meshRendererComponent->meshes.size(); i++)
+	{
+		std::shared_ptr<MaterialInstance> material = meshRendererComponent->materials[i].lock();
+		std::shared_ptr<Mesh> mesh = meshRendererComponent->meshes[i].lock();
+		if (!material || !mesh) continue;
+		Packet packet;
+		packet.shader = material->shader.lock().get();
+		packet.material = material.get();
+		packet.mesh = mesh.get();
+		packet.lod = meshRendererComponent->SelectLod(i, recording.transforms[transform], cameraPosition, tanHalfFovY);
+		packet.transform = transform;
+		recording.packets.push_back(packet);
+	}
+}
+
+void RenderQueue::Append(Recording& recording)
+{
+	int base = (int)transforms.size();
+	transforms.insert(transforms.end(), recording.transforms.begin(), recording.transforms.end());
+	for (Packet packet : recording.packets)
+	{
+		packet.transform += base;
+		packets.push_back(packet);
+	}
+}
+
+void RenderQueue::Record(const std::vector<Entity*>& entities, glm::vec3 cameraPosition, float tanHalfFovY)
+{
+	// each job takes a contiguous range so an entity is only ever touched by one of them
+	JobSystem& jobs = JobSystem::GetSingleton();
+	size_t rangeCount = std::min<size_t>(jobs.GetThreadCount(), entities.size() / MinEntitiesPerWorker);
+	rangeCount = std::max<size_t>(rangeCount, 1);
+	std::vector<Recording> recordings(rangeCount);
+	jobs.ParallelFor(rangeCount, 1, [&](size_t index)
+		{
+			size_t begin = entities.size() * index / rangeCount;
+			size_t end = entities.size() * (index + 1) / rangeCount;
+			for (size_t i = begin; i < end; i++)
+			{
+				RecordEntity(entities[i], recordings[index], cameraPosition, tanHalfFovY, false);
+			}
+		}
+	);
+
+	// merged in range order, which keeps the entities' order for equal keys
+	for (auto& recording : recordings)
+	{
+		Append(recording);
+	}
+	Recording loaded;
+	for (auto& recording : recordings)
+	{
+		for (Entity* entity : recording.deferred)
+		{
+			RecordEntity(entity, loaded, cameraPosition, tanHalfFovY, true);
+		}
+	}
+	Append(loaded);
+}
+
+void RenderQueue::Submit()
+{
+	std::stable_sort(packets.begin(), packets.end(), [](const Packet& a, const Packet& b)
+	{
+		if (a.shader != b.shader) return a.shader < b.shader;
+		if (a.material != b.material) return a.material < b.material;
+		if (a.mesh != b.mesh) return a.mesh < b.mesh;
+		return a.lod < b.lod;
+	});
+
+	for (size_t i = 0; i < packets.size();)
+	{
+		// one run of packets per material, it is bound once and each draw only sets its model matrix
+		MaterialInstance* material = packets[i].material;
+		ProfileScope scope(material->name, "Material");
+		material->Bind();
+		for (; i < packets.size() && packets[i].material == material; i++)
+		{
+			const Packet& packet = packets[i];
+			packet.shader->SetUniform("u_modelMatrix", transforms[packet.transform], 1);
+			packet.mesh->Draw(packet.lod);
+		}
+	}
+}
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+	transforms.clear();
+}
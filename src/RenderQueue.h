@@ -0,0 +1,57 @@
+#pragma once
+#include "Graphics.h"
+#include <vector>
+
+class Entity;
+class Mesh;
+class Shader;
+struct MaterialInstance;
+
+/*
+	Deferred draws for the forward pass. Recording walks the visible entities,
+	resolves their transforms, materials and levels of detail, and turns each
+	mesh into a packet; none of that touches GL, so ranges of entities are
+	recorded as jobs on several threads at once. Submit then sorts the merged packets
+	by shader, material and mesh and replays them on the GL thread, binding a
+	material only when it changes.
+
+	A job never loads a resource, lazy loading uploads to GL. An entity with
+	a handle that is not resident yet is left for the calling thread, which
+	records it after the jobs are done.
+*/
+class RenderQueue
+{
+public:
+	struct Packet
+	{
+		Shader* shader;
+		MaterialInstance* material;
+		Mesh* mesh;
+		int lod;
+		// index into the recorded transforms, they are kept apart so sorting moves less
+		int transform;
+	};
+
+	// fewer entities than this per job are not worth the scheduling
+	static const int MinEntitiesPerWorker = 128;
+
+	void Record(const std::vector<Entity*>& entities, glm::vec3 cameraPosition, float tanHalfFovY);
+	// sorts and draws everything recorded, the camera uniforms must already be set
+	void Submit();
+	void Clear();
+	int GetPacketCount() const { return (int)packets.size(); }
+private:
+	struct Recording
+	{
+		std::vector<Packet> packets;
+		std::vector<glm::mat4> transforms;
+		// entities with resources still to load
+		std::vector<Entity*> deferred;
+	};
+
+	static void RecordEntity(Entity* entity, Recording& recording, glm::vec3 cameraPosition, float tanHalfFovY, bool canLoad);
+	void Append(Recording& recording);
+
+	std::vector<Packet> packets;
+	std::vector<glm::mat4> transforms;
+};
@@ -3,6 +3,15 @@
 
 #include "Shader.h"
 
+Texture::~Texture()
+{
+	if (id == 0) return;
+	glDeleteTextures(1, &id);
+	// the id can be handed out again, the renderer must not think it is still bound
+	OpenGLRenderer* renderer = OpenGLRenderer::GetSingletonPtr();
+	if (renderer) renderer->InvalidateState();
+}
+
 void Material::Init(std::shared_ptr<Shader> shader)
 {
 	Init("New Material", shader);
@@ -165,6 +174,7 @@ void Material::Set(std::string name, glm::mat4 mat4Value)
 void Material::Bind()
 {
 	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	renderer.stats.materialBinds++;
 	shader.lock()->Use();
 	int textureIndex = 1;
 	for (int i = 0; i < parameters.size(); i++)
@@ -1,6 +1,7 @@
 #pragma once
 #include "UUID.h"
 #include "Graphics.h"
+#include "ResourceHandle.h"
 class Shader;
 class MeshData;
 class Mesh;
@@ -10,13 +11,18 @@ struct Resource
 public:
 	std::string name;
 	Util::UUID uuid;
+	// set when the resource differs from what is on disk, only dirty resources are written on save
+	bool dirty = false;
+	// bytes held on the gpu and cpu, counted against ResourceManager::memoryBudget
+	size_t memoryUsage = 0;
 };
 
 
 struct Texture : public Resource
 {
+	~Texture();
 	std::string filepath;
-	GLuint id;
+	GLuint id = 0;
 	glm::vec2 size;
 };
 
@@ -119,7 +125,7 @@ struct MaterialAttribute
 
 	std::string name;
 	MaterialAttributeType type;
-	std::weak_ptr<Texture> textureValue;
+	ResourceHandle<Texture> textureValue;
 	union
 	{
 		float floatValue;
@@ -139,7 +145,7 @@ public:
 	void Init(std::shared_ptr<Shader> shader);
 	void Init(std::string name, std::shared_ptr<Shader> shader);
 	std::vector<MaterialAttribute> parameters;
-	std::weak_ptr<Shader> shader;
+	ResourceHandle<Shader> shader;
 
 	int Find(std::string name);
 	void Set(MaterialAttribute attribute);
@@ -160,5 +166,5 @@ struct MaterialInstance : public Material
 	MaterialInstance(std::shared_ptr<Material> material, std::string name, bool modifiable = true);
 
 	bool modifiable;
-	std::weak_ptr<Material> base;
+	ResourceHandle<Material> base;
 };
\ No newline at end of file
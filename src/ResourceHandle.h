@@ -0,0 +1,48 @@
+#pragma once
+#include <memory>
+#include <string>
+
+class Shader;
+class Mesh;
+struct Texture;
+struct Material;
+struct MaterialInstance;
+struct Model;
+
+// looks the resource up in the ResourceManager, loading it through the asset database if needed
+template <typename T>
+std::shared_ptr<T> ResolveResource(const std::string& uuid);
+
+template <> std::shared_ptr<Texture> ResolveResource<Texture>(const std::string& uuid);
+template <> std::shared_ptr<Shader> ResolveResource<Shader>(const std::string& uuid);
+template <> std::shared_ptr<Material> ResolveResource<Material>(const std::string& uuid);
+template <> std::shared_ptr<MaterialInstance> ResolveResource<MaterialInstance>(const std::string& uuid);
+template <> std::shared_ptr<Mesh> ResolveResource<Mesh>(const std::string& uuid);
+template <> std::shared_ptr<Model> ResolveResource<Model>(const std::string& uuid);
+
+// Counted reference to a resource by uuid. A handle made from a uuid loads the
+// resource the first time it is locked; after that it keeps the resource
+// resident. Resources no handle holds are what ResourceManager::Trim unloads.
+template <typename T>
+class ResourceHandle
+{
+public:
+	ResourceHandle() = default;
+	ResourceHandle(std::shared_ptr<T> resource) : resource(resource)
+	{
+		if (resource) id = resource->uuid;
+	}
+	explicit ResourceHandle(std::string id) : id(id) {}
+
+	std::shared_ptr<T> lock() const
+	{
+		if (!resource && !id.empty()) resource = ResolveResource<T>(id);
+		return resource;
+	}
+	bool expired() const { return !lock(); }
+	bool IsLoaded() const { return resource != nullptr; }
+	const std::string& GetId() const { return id; }
+private:
+	std::string id;
+	mutable std::shared_ptr<T> resource;
+};
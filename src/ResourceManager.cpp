@@ -5,6 +5,10 @@
 #include "Mesh.h"
 #include "Shader.h"
 #include "UUID.h"
+#include "OpenGLRenderer.h"
+#include "AssetDatabase.h"
+#include "AssetArchive.h"
+#include <cmath>
 
 
 std::shared_ptr<Texture> ResourceManager::GetTexture(std::string uuid)
@@ -37,6 +41,70 @@ std::shared_ptr<Mesh> ResourceManager::GetMesh(std::string uuid)
 	return GetResource<Mesh>(uuid, meshes);
 }
 
+template <> std::shared_ptr<Texture> ResolveResource<Texture>(const std::string& uuid)
+{
+	return ResourceManager::GetSingleton().GetTexture(uuid);
+}
+
+template <> std::shared_ptr<Shader> ResolveResource<Shader>(const std::string& uuid)
+{
+	return ResourceManager::GetSingleton().GetShader(uuid);
+}
+
+template <> std::shared_ptr<Material> ResolveResource<Material>(const std::string& uuid)
+{
+	return ResourceManager::GetSingleton().GetMaterial(uuid);
+}
+
+template <> std::shared_ptr<MaterialInstance> ResolveResource<MaterialInstance>(const std::string& uuid)
+{
+	return ResourceManager::GetSingleton().GetMaterialInstance(uuid);
+}
+
+template <> std::shared_ptr<Mesh> ResolveResource<Mesh>(const std::string& uuid)
+{
+	return ResourceManager::GetSingleton().GetMesh(uuid);
+}
+
+template <> std::shared_ptr<Model> ResolveResource<Model>(const std::string& uuid)
+{
+	return ResourceManager::GetSingleton().GetModel(uuid);
+}
+
+void ResourceManager::Trim()
+{
+	size_t resident = GetMemoryUsage();
+	if (resident <= memoryBudget) return;
+	int unloaded = 0;
+	size_t freed = 0;
+	// users come before what they use, a dropped material instance can free its textures in the same pass
+	TrimResources(models, resident, unloaded, freed);
+	TrimResources(materialInstances, resident, unloaded, freed);
+	TrimResources(materials, resident, unloaded, freed);
+	TrimResources(meshes, resident, unloaded, freed);
+	TrimResources(textures, resident, unloaded, freed);
+	TrimResources(shaders, resident, unloaded, freed);
+	if (unloaded > 0)
+	{
+		std::cout << "Unloaded " << unloaded << " resources (" << freed / 1024 << "KB), " << resident / 1024 << "KB resident" << std::endl;
+	}
+}
+
+size_t ResourceManager::GetMemoryUsage()
+{
+	size_t total = 0;
+	for (auto& texture : textures) total += texture->memoryUsage;
+	for (auto& mesh : meshes) total += mesh->memoryUsage;
+	return total;
+}
+
+bool ResourceManager::LoadOnDemand(std::string uuid)
+{
+	AssetDatabase* database = AssetDatabase::GetSingletonPtr();
+	if (!database) return false;
+	return database->Load(uuid);
+}
+
 int ResourceManager::GetTextureIndex(std::string uuid)
 {
 	return GetResourceIndex<Texture>(uuid, textures);
@@ -71,6 +139,7 @@ std::shared_ptr<Mesh> ResourceManager::LoadMesh(std::string name, std::shared_pt
 {
 	std::shared_ptr<Mesh> mesh = LoadMeshInternal(name, data);
 	mesh->uuid.Init();
+	mesh->dirty = true;
 	meshes.push_back(mesh);
 	return mesh;
 }
@@ -95,8 +164,9 @@ void ResourceManager::LoadModel(std::string name, std::string path)
 std::shared_ptr<Model> ResourceManager::LoadModel(std::string name, std::shared_ptr<ModelData> data)
 {
 
-	std::shared_ptr<Model> model = LoadModelInternal(name, data);
+	std::shared_ptr<Model> model = LoadModelInternal(name);
 	model->uuid.Init();
+	model->dirty = true;
 	for (int i = 0; i < data->children.size(); i++)
 	{
 		model->children.push_back(LoadModel(name, data->children[i]));
@@ -110,9 +180,9 @@ std::shared_ptr<Model> ResourceManager::LoadModel(std::string name, std::shared_
 	return model;
 }
 
-std::shared_ptr<Model> ResourceManager::LoadModelWithId(std::string name, std::shared_ptr<ModelData> data, std::string uuid)
+std::shared_ptr<Model> ResourceManager::LoadModelWithId(std::string name, std::string uuid)
 {
-	std::shared_ptr<Model> model = LoadModelInternal(name, data);
+	std::shared_ptr<Model> model = LoadModelInternal(name);
 	model->uuid.Init(uuid);
 	return model;
 }
@@ -123,6 +193,7 @@ std::shared_ptr<Shader> ResourceManager::LoadShader(std::string name, std::vecto
 	std::shared_ptr<Shader> shader = LoadShaderInternal(name, shaderDatas);
 	shaders.push_back(shader);
 	shader->uuid.Init();
+	shader->dirty = true;
 	return shader;
 }
 
@@ -139,6 +210,7 @@ std::shared_ptr<Texture> ResourceManager::LoadTexture(std::string name, std::str
 	std::shared_ptr<Texture> texture = LoadTextureInternal(name, path);
 	textures.push_back(texture);
 	texture->uuid.Init();
+	texture->dirty = true;
 	return texture;
 }
 
@@ -154,6 +226,7 @@ std::shared_ptr<MaterialInstance> ResourceManager::LoadMaterialInstance(std::sha
 {
 	std::shared_ptr<MaterialInstance> mi = LoadMaterialInstanceInternal(material, name, modifiable);
 	mi->uuid.Init();
+	mi->dirty = true;
 	materialInstances.push_back(mi);
 	return mi;
 }
@@ -170,6 +243,7 @@ std::shared_ptr<Material> ResourceManager::LoadMaterial(std::shared_ptr<Shader>
 {
 	std::shared_ptr<Material> material = LoadMaterialInternal(shader, name, attributes);
 	material->uuid.Init();
+	material->dirty = true;
 	materials.push_back(material);
 	return material;
 }
@@ -186,16 +260,35 @@ std::shared_ptr<Material> ResourceManager::LoadMaterialWithId(std::shared_ptr<Sh
 std::shared_ptr<Texture> ResourceManager::LoadTextureInternal(std::string name, std::string path)
 {
 	int width, height, channels;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	stbi_image_free(data);
+	unsigned char* data;
+	ArchiveSlice packed = AssetArchive::FindPacked(path);
+	if (packed)
+	{
+		data = stbi_load_from_memory((const stbi_uc*)packed.data, (int)packed.size, &width, &height, &channels, 4);
+	}
+	else
+	{
+		data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+	}
+	GLuint textureID = 0;
+	if (data == nullptr)
+	{
+		std::cout << "Failed to load texture " << path << std::endl;
+		width = height = 0;
+	}
+	else
+	{
+		// allocate the whole mip chain up front, then upload the base level into it
+		int levels = 1 + (int)std::floor(std::log2(std::max(width, height)));
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		glTextureStorage2D(textureID, levels, GL_RGBA8, width, height);
+		glTextureSubImage2D(textureID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glGenerateTextureMipmap(textureID);
+		stbi_image_free(data);
+		OpenGLRenderer::GetSingleton().stats.bufferUploadBytes += width * height * 4;
+	}
 
 	std::shared_ptr<Texture> texture = std::make_shared<Texture>();
 
@@ -203,6 +296,8 @@ std::shared_ptr<Texture> ResourceManager::LoadTextureInternal(std::string name,
 	texture->size = { width, height };
 	texture->name = name;
 	texture->filepath = path;
+	// base level plus a third for the mip chain
+	texture->memoryUsage = (size_t)width * height * 4 * 4 / 3;
 	return texture;
 }
 
@@ -231,10 +326,14 @@ std::shared_ptr<Mesh> ResourceManager::LoadMeshInternal(std::string name, std::s
 	mesh->AddAttribute(Mesh::MeshAttribute({ 2, GL_FLOAT, sizeof(float) }));
 	mesh->Init(data);
 	mesh->name = name;
+	// the vertex data is kept on the cpu as well as uploaded
+	size_t indexCount = data->indices.size();
+	for (auto& lod : data->lods) indexCount += lod.size();
+	mesh->memoryUsage = (data->vertices.size() * sizeof(Vertex) + indexCount * sizeof(unsigned short)) * 2;
 	return mesh;
 }
 
-std::shared_ptr<Model> ResourceManager::LoadModelInternal(std::string name, std::shared_ptr<ModelData> data)
+std::shared_ptr<Model> ResourceManager::LoadModelInternal(std::string name)
 {
 	std::shared_ptr<Model> model = std::make_shared<Model>();
 	model->name = name;
@@ -33,7 +33,7 @@ public:
 	std::shared_ptr<Texture> LoadTextureWithId(std::string name, std::string path, std::string uuid);
 
 	std::shared_ptr<Model> LoadModel(std::string name, std::shared_ptr<ModelData> data);
-	std::shared_ptr<Model> LoadModelWithId(std::string name, std::shared_ptr<ModelData> data, std::string uuid);
+	std::shared_ptr<Model> LoadModelWithId(std::string name, std::string uuid);
 
 	std::shared_ptr<Shader> LoadShader(std::string name, std::vector<std::pair<GLenum, std::string>> shaderDatas);
 	std::shared_ptr<Shader> LoadShaderWithId(std::string name, std::vector<std::pair<GLenum, std::string>>& shaderDatas, std::string uuid);
@@ -61,6 +61,12 @@ public:
 	int GetModelIndex(std::string uuid);
 	int GetMeshIndex(std::string uuid);
 
+	// resources held only by the manager are unloaded, oldest first, until the total fits memoryBudget
+	void Trim();
+	size_t GetMemoryUsage();
+
+	size_t memoryBudget = 512 << 20;
+
 
 	std::vector<std::shared_ptr<Model>> models;
 	std::vector<std::shared_ptr<Texture>> textures;
@@ -86,16 +92,39 @@ public:
 	std::shared_ptr<T> GetResource(std::string uuid, std::vector<std::shared_ptr<T>>& data)
 	{
 		int index = GetResourceIndex<T>(uuid, data);
+		if (index == -1 && LoadOnDemand(uuid))
+		{
+			index = GetResourceIndex<T>(uuid, data);
+		}
 		if (index == -1) return nullptr;
 		return data[index];
 	}
 
 private:
+	bool LoadOnDemand(std::string uuid);
+	template <typename T>
+	void TrimResources(std::vector<std::shared_ptr<T>>& data, size_t& resident, int& unloaded, size_t& freed)
+	{
+		for (auto it = data.begin(); it != data.end() && resident > memoryBudget;)
+		{
+			// dirty resources have unsaved edits and stay until they are written
+			if (it->use_count() > 1 || (*it)->dirty)
+			{
+				it++;
+				continue;
+			}
+			resident -= (*it)->memoryUsage;
+			freed += (*it)->memoryUsage;
+			unloaded++;
+			it = data.erase(it);
+		}
+	}
+
 	std::shared_ptr<Texture> LoadTextureInternal(std::string name, std::string path);
 	std::shared_ptr<Shader> LoadShaderInternal(std::string name, std::vector<std::pair<GLenum, std::string>>& shaderDatas);
 	std::shared_ptr<Material> LoadMaterialInternal(std::shared_ptr<Shader> shader, std::string name, std::vector<MaterialAttribute> attributes);
 	std::shared_ptr<MaterialInstance> LoadMaterialInstanceInternal(std::shared_ptr<Material> material, std::string name, bool modifiable = true);
-	std::shared_ptr<Model> LoadModelInternal(std::string name, std::shared_ptr<ModelData> data);
+	std::shared_ptr<Model> LoadModelInternal(std::string name);
 	std::shared_ptr<Mesh> LoadMeshInternal(std::string name, std::shared_ptr<MeshData> data);
 };
 
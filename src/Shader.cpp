@@ -1,5 +1,6 @@
 #include "Shader.h"
 #include "Util.h"
+#include "OpenGLRenderer.h"
 
 //void Shader::LoadShader(GLenum shaderType, const std::string& shaderCode)
 //{
@@ -8,21 +9,60 @@
 //	data[shaderType] = shaderData;
 //}
 
+// GLSL has no includes, a line #include "file" is replaced by that file, which may include others
+static std::string ExpandIncludes(const std::string& code, const std::string& path, int depth = 0)
+{
+	const int maxDepth = 8;
+	std::string result;
+	size_t lineStart = 0;
+	while (lineStart < code.size())
+	{
+		size_t lineEnd = code.find('\n', lineStart);
+		if (lineEnd == std::string::npos) lineEnd = code.size();
+		std::string line = code.substr(lineStart, lineEnd - lineStart);
+		size_t open = line.find('"');
+		size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+		if (line.compare(0, 8, "#include") == 0 && close != std::string::npos)
+		{
+			std::string included = line.substr(open + 1, close - open - 1);
+			if (depth >= maxDepth)
+			{
+				std::cout << "Too many nested includes of " << included << " in " << path << std::endl;
+			}
+			else
+			{
+				result += ExpandIncludes(Util::LoadFileAsString(included), included, depth + 1);
+			}
+		}
+		else
+		{
+			result += line;
+		}
+		result += '\n';
+		lineStart = lineEnd + 1;
+	}
+	return result;
+}
+
 void Shader::LoadShaderFromFile(GLenum shaderType, const std::string& path)
 {
 	GLuint id = glCreateShader(shaderType);
-	std::string& shaderCode = Util::LoadFileAsString(path);
+	std::string shaderCode = ExpandIncludes(Util::LoadFileAsString(path), path);
 	ShaderData shaderData = { id, shaderCode, path };
 	data[shaderType] = shaderData;
 }
 
 void Shader::Link()
 {
+	// shaders loaded on demand are linked as they arrive
+	if (programId != 0) return;
 	programId = glCreateProgram();
 
-	LinkShader(GL_VERTEX_SHADER);
-
-	LinkShader(GL_FRAGMENT_SHADER);
+	// vertex and fragment for materials, a lone compute stage for GPU passes
+	for (auto& stage : data)
+	{
+		LinkShader(stage.first);
+	}
 
 	glLinkProgram(programId);
 
@@ -44,7 +84,7 @@ void Shader::Link()
 
 void Shader::Use()
 {
-	glUseProgram(programId);
+	OpenGLRenderer::GetSingleton().UseProgram(programId);
 }
 
 void Shader::Begin()
@@ -56,46 +96,58 @@ void Shader::SetUniform(std::string varname, glm::mat4& value, int count)
 {
 	GLuint varloc = glGetUniformLocation(programId, varname.c_str());
 	glUniformMatrix4fv(varloc, count, GL_FALSE, &value[0][0]);
+	CountUniform(sizeof(glm::mat4) * count);
 }
 
 void Shader::SetUniform(std::string varname, int value)
 {
 	GLuint varloc = glGetUniformLocation(programId, varname.c_str());
 	glUniform1i(varloc, value);
+	CountUniform(sizeof(int));
 }
 
 void Shader::SetUniform(std::string varname, float value)
 {
 	GLuint varloc = glGetUniformLocation(programId, varname.c_str());
 	glUniform1f(varloc, value);
+	CountUniform(sizeof(float));
 }
 
 void Shader::SetUniform(std::string varname, glm::vec2& value, int count)
 {
 	GLuint varloc = glGetUniformLocation(programId, varname.c_str());
 	glUniform2fv(varloc, count, &value.x);
+	CountUniform(sizeof(glm::vec2) * count);
 }
 
 void Shader::SetUniform(std::string varname, glm::vec3& value, int count)
 {
 	GLuint varloc = glGetUniformLocation(programId, varname.c_str());
 	glUniform3fv(varloc, count, &value.x);
+	CountUniform(sizeof(glm::vec3) * count);
 }
 
 void Shader::SetUniform(std::string varname, glm::vec4& value, int count)
 {
 	GLuint varloc = glGetUniformLocation(programId, varname.c_str());
 	glUniform4fv(varloc, count, &value.x);
+	CountUniform(sizeof(glm::vec4) * count);
 }
 
 void Shader::BindTexture(std::string varname, GLuint textureId, int textureUnit)
 {
-	glBindTexture(GL_TEXTURE_2D, textureId);
-	glBindTextureUnit(textureUnit, textureId);
+	OpenGLRenderer::GetSingleton().BindTextureUnit(textureUnit, textureId);
 	SetUniform(varname.c_str(), textureUnit);
 	//textureUnit++;
 }
 
+void Shader::CountUniform(int bytes)
+{
+	RenderStats& stats = OpenGLRenderer::GetSingleton().stats;
+	stats.uniformUploads++;
+	stats.uniformBytes += bytes;
+}
+
 Shader::~Shader()
 {
 	for (auto shader : data)
@@ -103,6 +155,8 @@ Shader::~Shader()
 		glDeleteShader(shader.second.id);
 	}
 	glDeleteProgram(programId);
+	OpenGLRenderer* renderer = OpenGLRenderer::GetSingletonPtr();
+	if (renderer) renderer->InvalidateState();
 }
 
 void Shader::LinkShader(GLenum shaderType)
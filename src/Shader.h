@@ -31,8 +31,9 @@ public:
 	~Shader();
 protected:
 	virtual void LinkShader(GLenum shaderType);
+	void CountUniform(int bytes);
 protected:
-	GLuint programId;
+	GLuint programId = 0;
 	//int textureUnit;
 private:
 };
\ No newline at end of file
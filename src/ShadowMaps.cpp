@@ -0,0 +1,203 @@
+#include "ShadowMaps.h"
+#include "OpenGLRenderer.h"
+#include "Profiler.h"
+#include "Bounds.h"
+#include "components/Scene.h"
+#include <algorithm>
+
+ShadowMaps::~ShadowMaps()
+{
+	if (!initialised) return;
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &shadowMap);
+}
+
+bool ShadowMaps::Init()
+{
+	if (initialised) return true;
+	depthShader = std::make_shared<Shader>();
+	depthShader->LoadShaderFromFile(GL_VERTEX_SHADER, "Depth.vert");
+	depthShader->Link();
+
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &shadowMap);
+	glTextureStorage3D(shadowMap, 1, GL_DEPTH_COMPONENT32F, Resolution, Resolution, Cascades * 2);
+	glTextureParameteri(shadowMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(shadowMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// linear with compare mode set filters the depth test results, four taps for the price of one
+	glTextureParameteri(shadowMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(shadowMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(shadowMap, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(shadowMap, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	// the layer drawn to is attached as each shadow map is rendered
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTextureLayer(framebuffer, GL_DEPTH_ATTACHMENT, shadowMap, 0, 0);
+	glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(framebuffer, GL_NONE);
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Shadow map framebuffer is not complete" << std::endl;
+		return false;
+	}
+	initialised = true;
+	return true;
+}
+
+RenderGraph::TextureDesc ShadowMaps::GetDesc() const
+{
+	RenderGraph::TextureDesc desc;
+	desc.width = Resolution;
+	desc.height = Resolution;
+	desc.format = GL_DEPTH_COMPONENT32F;
+	desc.layers = Cascades * 2;
+	return desc;
+}
+
+bool ShadowMaps::FindLight(Scene& scene, glm::vec3& direction)
+{
+	// the same light ClusteredLighting puts first
+	for (auto& entity : scene.entities)
+	{
+		if (!entity) continue;
+		LightComponent* light = entity->GetComponent<LightComponent>();
+		TransformComponent* transform = entity->GetComponent<TransformComponent>();
+		if (!light || !transform || light->type != LightType::Directional) continue;
+		direction = glm::normalize(glm::vec3(transform->GetTransform() * glm::vec4(0, 0, -1, 0)));
+		return true;
+	}
+	return false;
+}
+
+void ShadowMaps::Render(Scene& scene, const glm::mat4& view, const Camera& camera)
+{
+	active = false;
+	if (!enabled) return;
+	if (!initialised && !Init())
+	{
+		enabled = false;
+		return;
+	}
+	glm::vec3 lightDirection;
+	if (!FindLight(scene, lightDirection)) return;
+	active = true;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+
+	glm::mat4 inverseView = glm::inverse(view);
+	glm::vec3 cameraPosition = inverseView[3];
+	glm::vec3 forward = -glm::vec3(inverseView[2]);
+	glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+	// distance from the view axis to a frustum corner per unit of depth
+	float tanHalfFovY = std::tan(camera.fovY * 0.5f);
+	float cornerSlope = tanHalfFovY * std::sqrt(1.0f + camera.aspect * camera.aspect);
+	float farthest = std::min(camera.far, MaxDistance);
+
+	renderer.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, Resolution, Resolution);
+	renderer.SetDepthTest(true);
+	// casters between the light and the slice are flattened onto the near plane rather than clipped
+	glEnable(GL_DEPTH_CLAMP);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(SlopeBias, ConstantBias);
+	depthShader->Use();
+
+	float splitNear = camera.near;
+	for (int c = 0; c < Cascades; c++)
+	{
+		Cascade& cascade = cascades[c];
+		float even = camera.near + (farthest - camera.near) * (c + 1) / Cascades;
+		float logarithmic = camera.near * std::pow(farthest / camera.near, (float)(c + 1) / Cascades);
+		float splitFar = glm::mix(even, logarithmic, SplitBlend);
+		cascade.split = splitFar;
+
+		// smallest sphere through the slice's eight corners, centred on the view axis
+		float k2 = cornerSlope * cornerSlope;
+		float depth = std::min((splitNear + splitFar) * 0.5f * (1.0f + k2), splitFar);
+		float radius = std::sqrt((splitFar - depth) * (splitFar - depth) + splitFar * splitFar * k2);
+		// rounded up so float noise in the camera never changes the map's size
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+		splitNear = splitFar;
+
+		float extent = radius * (1.0f + SnapFraction);
+		cascade.texelSize = 2.0f * extent / Resolution;
+		float step = cascade.texelSize * std::max(1.0f, std::round(radius * SnapFraction / cascade.texelSize));
+		glm::vec3 center = glm::vec3(lightView * glm::vec4(cameraPosition + forward * depth, 1.0f));
+		glm::vec3 origin = glm::floor(center / step + 0.5f) * step;
+
+		// light space looks down -z, near and far are distances along it
+		glm::mat4 projection = glm::ortho(origin.x - extent, origin.x + extent, origin.y - extent, origin.y + extent, -origin.z - extent, -origin.z + extent);
+		cascade.viewProjection = projection * lightView;
+
+		if (cascade.cachedVersion != scene.staticVersion || cascade.cachedViewProjection != cascade.viewProjection)
+		{
+			ProfileScope layerScope("StaticShadowLayer");
+			glNamedFramebufferTextureLayer(framebuffer, GL_DEPTH_ATTACHMENT, shadowMap, 0, Cascades + c);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			DrawCasters(scene, cascade.viewProjection, true);
+			cascade.cachedVersion = scene.staticVersion;
+			cascade.cachedViewProjection = cascade.viewProjection;
+		}
+
+		glCopyImageSubData(shadowMap, GL_TEXTURE_2D_ARRAY, 0, 0, 0, Cascades + c,
+			shadowMap, GL_TEXTURE_2D_ARRAY, 0, 0, 0, c, Resolution, Resolution, 1);
+		glNamedFramebufferTextureLayer(framebuffer, GL_DEPTH_ATTACHMENT, shadowMap, 0, c);
+		DrawCasters(scene, cascade.viewProjection, false);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_DEPTH_CLAMP);
+}
+
+void ShadowMaps::DrawCasters(Scene& scene, const glm::mat4& viewProjection, bool isStatic)
+{
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	Frustum frustum(viewProjection);
+	// no near plane, anything towards the light can still throw a shadow into the cascade
+	frustum.planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	casters.clear();
+	scene.bvh.QueryFrustum(frustum, casters);
+
+	glm::mat4 vp = viewProjection;
+	depthShader->SetUniform("u_viewProjection", vp, 1);
+	for (Entity* entity : casters)
+	{
+		MeshRendererComponent* meshRenderer = entity->GetComponent<MeshRendererComponent>();
+		TransformComponent* transform = entity->GetComponent<TransformComponent>();
+		if (!meshRenderer || !transform || meshRenderer->isStatic != isStatic) continue;
+		glm::mat4 model = transform->GetTransform();
+		depthShader->SetUniform("u_modelMatrix", model, 1);
+		for (auto& handle : meshRenderer->meshes)
+		{
+			// a uuid that does not resolve casts nothing, like RenderQueue skips it
+			std::shared_ptr<Mesh> mesh = handle.lock();
+			if (mesh) mesh->Draw(0);
+		}
+		renderer.stats.shadowCasters++;
+	}
+}
+
+void ShadowMaps::Bind(std::shared_ptr<Shader> shader)
+{
+	// the sampler is pointed at its own unit even with no shadows, it may not share one with a 2D sampler
+	if (initialised)
+	{
+		shader->BindTexture("u_shadowMap", shadowMap, ShadowTextureUnit);
+	}
+	else
+	{
+		shader->SetUniform("u_shadowMap", ShadowTextureUnit);
+	}
+	glm::mat4 matrices[Cascades];
+	glm::vec4 splits;
+	glm::vec4 texelSizes;
+	for (int c = 0; c < Cascades; c++)
+	{
+		matrices[c] = cascades[c].viewProjection;
+		splits[c] = cascades[c].split;
+		texelSizes[c] = cascades[c].texelSize;
+	}
+	shader->SetUniform("u_shadowMatrices", matrices[0], Cascades);
+	shader->SetUniform("u_cascadeSplits", splits, 1);
+	shader->SetUniform("u_cascadeTexelSizes", texelSizes, 1);
+	shader->SetUniform("u_shadowCascades", active ? Cascades : 0);
+}
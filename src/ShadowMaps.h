@@ -0,0 +1,78 @@
+#pragma once
+#include "Graphics.h"
+#include "Camera.h"
+#include "RenderGraph.h"
+#include <vector>
+#include <memory>
+
+class Scene;
+class Entity;
+class Shader;
+
+/*
+	Cascaded shadow maps for the scene's first directional light. The view
+	frustum is split into Cascades slices out to MaxDistance and each gets an
+	orthographic shadow map around the sphere that encloses it. The sphere only
+	depends on the camera's projection, so the map never changes size as the
+	camera turns, and its centre is snapped to a grid a SnapFraction of its
+	radius wide so it only moves in whole texels.
+
+	The maps live in one depth texture array with two layers per cascade, which
+	is imported into the render graph. Static entities are drawn into the second
+	layer, which is kept until a static entity changes or the cascade snaps to a
+	new spot. Every frame the static layer is copied into the first and only the
+	dynamic entities are drawn on top, that first layer is what lit shaders
+	sample.
+*/
+class ShadowMaps
+{
+public:
+	static const int Cascades = 4;
+	static const int Resolution = 2048;
+	// how the splits are spread, 0 even and 1 logarithmic
+	static constexpr float SplitBlend = 0.75f;
+	static constexpr float MaxDistance = 60.0f;
+	// cascades move in steps of this fraction of their radius and are widened to still cover the slice
+	static constexpr float SnapFraction = 0.25f;
+	// glPolygonOffset while casting, keeps lit surfaces from shadowing themselves
+	static constexpr float SlopeBias = 2.0f;
+	static constexpr float ConstantBias = 1.0f;
+	static const int ShadowTextureUnit = 8;
+
+	~ShadowMaps();
+	// creates the shadow map, safe to call every frame
+	bool Init();
+	// redraws the cascades for this camera, the cached static layers only when they went stale
+	void Render(Scene& scene, const glm::mat4& view, const Camera& camera);
+	// uniforms and the shadow map for a lit shader
+	void Bind(std::shared_ptr<Shader> shader);
+	GLuint GetTexture() const { return shadowMap; }
+	RenderGraph::TextureDesc GetDesc() const;
+
+	bool enabled = true;
+private:
+	struct Cascade
+	{
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		// far end of the slice in view depth
+		float split = 0.0f;
+		// world size of one shadow map texel
+		float texelSize = 0.0f;
+		// what the static layer was drawn with, it is redrawn when the scene's static version or the cascade's
+		// projection changes, which moves with the camera and light but also with the aspect, fov and splits
+		glm::mat4 cachedViewProjection = glm::mat4(0.0f);
+		unsigned int cachedVersion = 0;
+	};
+
+	bool FindLight(Scene& scene, glm::vec3& direction);
+	void DrawCasters(Scene& scene, const glm::mat4& viewProjection, bool isStatic);
+
+	std::shared_ptr<Shader> depthShader;
+	GLuint shadowMap = 0;
+	GLuint framebuffer = 0;
+	bool initialised = false;
+	// no directional light means nothing is sampled
+	bool active = false;
+	Cascade cascades[Cascades];
+	std::vector<Entity*> casters;
+};
@@ -0,0 +1,145 @@
+#include "TemporalAA.h"
+#include "OpenGLRenderer.h"
+#include "Shader.h"
+
+// radical inverse of index in base, the Halton sequence's coordinate
+static float Halton(int index, int base)
+{
+	float result = 0.0f;
+	float fraction = 1.0f / base;
+	while (index > 0)
+	{
+		result += (index % base) * fraction;
+		index /= base;
+		fraction /= base;
+	}
+	return result;
+}
+
+TemporalAA::~TemporalAA()
+{
+	if (!initialised) return;
+	glDeleteTextures(2, history);
+}
+
+bool TemporalAA::Init()
+{
+	if (initialised) return true;
+	motionShader = std::make_shared<Shader>();
+	motionShader->LoadShaderFromFile(GL_COMPUTE_SHADER, "MotionVectors.comp");
+	motionShader->Link();
+	resolveShader = std::make_shared<Shader>();
+	resolveShader->LoadShaderFromFile(GL_COMPUTE_SHADER, "TemporalResolve.comp");
+	resolveShader->Link();
+	initialised = true;
+	return true;
+}
+
+glm::vec2 TemporalAA::NextJitter()
+{
+	phase = (phase + 1) % JitterPhases;
+	// index 0 of the sequence is the origin in both bases, it starts at 1
+	return glm::vec2(Halton(phase + 1, 2), Halton(phase + 1, 3)) - 0.5f;
+}
+
+void TemporalAA::Reset()
+{
+	historyValid = false;
+}
+
+void TemporalAA::ResizeHistory(int width, int height)
+{
+	width = RenderGraph::GetBucketSize(width);
+	height = RenderGraph::GetBucketSize(height);
+	if (width == historyWidth && height == historyHeight) return;
+	glDeleteTextures(2, history);
+	glCreateTextures(GL_TEXTURE_2D, 2, history);
+	for (GLuint texture : history)
+	{
+		glTextureStorage2D(texture, 1, GL_RGBA16F, width, height);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// reprojected positions fall between texels
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// new storage can hold anything, even NaNs, which a zero blend weight does not hide
+		glClearTexImage(texture, 0, GL_RGBA, GL_FLOAT, nullptr);
+	}
+	historyWidth = width;
+	historyHeight = height;
+	historyValid = false;
+	OpenGLRenderer::GetSingleton().InvalidateState();
+}
+
+RenderGraph::Resource TemporalAA::AddPasses(RenderGraph& graph, RenderGraph::Resource color, RenderGraph::Resource depth)
+{
+	if (!initialised && !Init()) return color;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	RenderGraph::TextureDesc desc = graph.GetDesc(color);
+	ResizeHistory(desc.width, desc.height);
+	// motion comes from the camera without its jitter, a still camera reprojects onto itself
+	glm::mat4 viewProjection = renderer.GetProjectionMatrix() * renderer.GetViewMatrix();
+	glm::mat4 previous = historyValid ? previousViewProjection : viewProjection;
+	glm::vec2 size(desc.width, desc.height);
+	glm::vec2 historySize = historyValid ? previousSize : size;
+	bool valid = historyValid;
+
+	RenderGraph::TextureDesc motionDesc;
+	motionDesc.width = desc.width;
+	motionDesc.height = desc.height;
+	motionDesc.format = GL_RG16F;
+	RenderGraph::TextureDesc historyDesc = motionDesc;
+	historyDesc.width = historyWidth;
+	historyDesc.height = historyHeight;
+	historyDesc.format = GL_RGBA16F;
+	RenderGraph::TextureDesc outputDesc = motionDesc;
+	outputDesc.format = GL_RGBA8;
+	RenderGraph::Resource motion = graph.CreateTexture("Motion", motionDesc);
+	RenderGraph::Resource output = graph.CreateTexture("TemporalColor", outputDesc);
+	RenderGraph::Resource readHistory = graph.ImportTexture("History", history[current], historyDesc);
+	RenderGraph::Resource writeHistory = graph.ImportTexture("NextHistory", history[1 - current], historyDesc);
+
+	RenderGraph::Pass& motionPass = graph.AddPass("MotionVectors", [this, &graph, depth, motion, viewProjection, previous, size]()
+	{
+		glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+		glm::mat4 previousMatrix = previous;
+		glm::vec2 targetSize = size;
+		motionShader->Use();
+		motionShader->BindTexture("u_depth", graph.GetTexture(depth), 0);
+		motionShader->SetUniform("u_inverseViewProjection", inverseViewProjection, 1);
+		motionShader->SetUniform("u_previousViewProjection", previousMatrix, 1);
+		motionShader->SetUniform("u_size", targetSize, 1);
+		glBindImageTexture(0, graph.GetTexture(motion), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+		glDispatchCompute(((int)size.x + 7) / 8, ((int)size.y + 7) / 8, 1);
+	});
+	motionPass.Read(depth, RenderGraph::Access::Sampled);
+	motionPass.Write(motion, RenderGraph::Access::Storage);
+
+	RenderGraph::Pass& resolvePass = graph.AddPass("TemporalResolve", [this, &graph, color, motion, readHistory, writeHistory, output, size, historySize, valid]()
+	{
+		glm::vec2 targetSize = size;
+		// the part of the history texture last frame's size covered
+		glm::vec2 historyScale = historySize / glm::vec2(historyWidth, historyHeight);
+		resolveShader->Use();
+		resolveShader->BindTexture("u_color", graph.GetTexture(color), 0);
+		resolveShader->BindTexture("u_motion", graph.GetTexture(motion), 1);
+		resolveShader->BindTexture("u_history", graph.GetTexture(readHistory), 2);
+		resolveShader->SetUniform("u_size", targetSize, 1);
+		resolveShader->SetUniform("u_historyScale", historyScale, 1);
+		resolveShader->SetUniform("u_historyWeight", valid ? HistoryWeight : 0.0f);
+		glBindImageTexture(0, graph.GetTexture(output), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		glBindImageTexture(1, graph.GetTexture(writeHistory), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glDispatchCompute(((int)size.x + 7) / 8, ((int)size.y + 7) / 8, 1);
+	});
+	resolvePass.Read(color, RenderGraph::Access::Sampled);
+	resolvePass.Read(motion, RenderGraph::Access::Sampled);
+	resolvePass.Read(readHistory, RenderGraph::Access::Sampled);
+	resolvePass.Write(output, RenderGraph::Access::Storage);
+	resolvePass.Write(writeHistory, RenderGraph::Access::Storage);
+
+	previousViewProjection = viewProjection;
+	previousSize = size;
+	historyValid = true;
+	current = 1 - current;
+	return output;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Graphics.h"
+#include "RenderGraph.h"
+#include <memory>
+
+class Shader;
+
+/*
+	Temporal anti-aliasing, the single sampled alternative to MSAA. The
+	projection is shifted by a different subpixel offset every frame, from a
+	JitterPhases long Halton sequence, so over a few frames every pixel is
+	sampled at several spots like MSAA would in one.
+
+	A compute pass turns the scene's depth into a motion vector target, the
+	screen offset to where each pixel was in the last frame under the last
+	frame's camera. The resolve pass looks up the accumulated history there,
+	clamps it to the range of colours around the pixel in the new frame so
+	anything that moved or changed does not leave a trail, and blends the new
+	frame into it. The history is kept in two textures that swap every frame,
+	sized in the render graph's buckets so the panel or dynamic resolution can
+	change size without throwing it away.
+
+	Only the camera's motion is reprojected, an entity that moves on its own
+	leans on the clamp and can look soft while it does.
+*/
+class TemporalAA
+{
+public:
+	static const int JitterPhases = 8;
+	// share of the history in each new frame
+	static constexpr float HistoryWeight = 0.9f;
+
+	~TemporalAA();
+	// the subpixel offset for the next frame, in pixels
+	glm::vec2 NextJitter();
+	// adds the motion vector and resolve passes, the result is the anti-aliased colour at color's size
+	RenderGraph::Resource AddPasses(RenderGraph& graph, RenderGraph::Resource color, RenderGraph::Resource depth);
+	// the next frame starts a new history, for when the last one does not show the same scene
+	void Reset();
+private:
+	bool Init();
+	void ResizeHistory(int width, int height);
+
+	std::shared_ptr<Shader> motionShader;
+	std::shared_ptr<Shader> resolveShader;
+	GLuint history[2] = {};
+	// allocated size of the history textures
+	int historyWidth = 0;
+	int historyHeight = 0;
+	// the one read next frame, the other is written
+	int current = 0;
+	bool historyValid = false;
+	// what the history holds, the camera and size it was drawn with
+	glm::mat4 previousViewProjection = glm::mat4(1.0f);
+	glm::vec2 previousSize = glm::vec2(0.0f);
+	int phase = 0;
+	bool initialised = false;
+};
@@ -0,0 +1,109 @@
+#include "TransformHierarchy.h"
+#include "JobSystem.h"
+#include "components/Entity.h"
+#include "components/Components.h"
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define TRANSFORM_HIERARCHY_SSE
+#endif
+
+void TransformHierarchy::Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+{
+#ifdef TRANSFORM_HIERARCHY_SSE
+	// glm is column major, column j of the product is a's columns weighted by column j of b
+	const float* left = glm::value_ptr(a);
+	const float* right = glm::value_ptr(b);
+	float* out = glm::value_ptr(result);
+	__m128 a0 = _mm_loadu_ps(left);
+	__m128 a1 = _mm_loadu_ps(left + 4);
+	__m128 a2 = _mm_loadu_ps(left + 8);
+	__m128 a3 = _mm_loadu_ps(left + 12);
+	for (int column = 0; column < 4; column++)
+	{
+		const float* weights = right + column * 4;
+		__m128 sum = _mm_mul_ps(a0, _mm_set1_ps(weights[0]));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(weights[1])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(weights[2])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(weights[3])));
+		_mm_storeu_ps(out + column * 4, sum);
+	}
+#else
+	result = a * b;
+#endif
+}
+
+void TransformHierarchy::Rebuild(const std::vector<std::shared_ptr<Entity>>& entities)
+{
+	transforms.clear();
+	owners.clear();
+	parents.clear();
+	levelStarts = { 0 };
+	for (auto& entity : entities)
+	{
+		if (!entity) continue;
+		TransformComponent* transform = entity->GetComponent<TransformComponent>();
+		if (!transform || !transform->parent.expired()) continue;
+		transforms.push_back(transform);
+		owners.push_back(entity.get());
+		parents.push_back(-1);
+	}
+	// each level is the children of the one before, appended in order so parents always come first
+	int begin = 0;
+	while (begin < (int)transforms.size())
+	{
+		int end = (int)transforms.size();
+		levelStarts.push_back(end);
+		for (int parent = begin; parent < end; parent++)
+		{
+			for (auto& child : transforms[parent]->children)
+			{
+				TransformComponent* transform = child ? child->GetComponent<TransformComponent>() : nullptr;
+				if (!transform) continue;
+				transforms.push_back(transform);
+				owners.push_back(child.get());
+				parents.push_back(parent);
+			}
+		}
+		begin = end;
+	}
+	worlds.resize(transforms.size());
+}
+
+void TransformHierarchy::UpdateTransform(int index, bool all)
+{
+	if (!all && !owners[index]->boundsDirty) return;
+	glm::mat4 local = transforms[index]->GetLocalTransform();
+	int parent = parents[index];
+	if (parent < 0)
+	{
+		worlds[index] = local;
+	}
+	else
+	{
+		Multiply(worlds[parent], local, worlds[index]);
+	}
+	transforms[index]->world = worlds[index];
+}
+
+void TransformHierarchy::Update(const std::vector<std::shared_ptr<Entity>>& entities)
+{
+	// the cached worlds of clean parents are only valid in the order they were computed in
+	bool all = stale;
+	if (stale)
+	{
+		Rebuild(entities);
+		stale = false;
+	}
+	JobSystem& jobs = JobSystem::GetSingleton();
+	for (int level = 0; level < GetLevelCount(); level++)
+	{
+		int begin = levelStarts[level];
+		int count = levelStarts[level + 1] - begin;
+		if (count < ParallelLevelSize)
+		{
+			for (int i = begin; i < begin + count; i++) UpdateTransform(i, all);
+			continue;
+		}
+		jobs.ParallelFor(count, Grain, [this, begin, all](size_t i) { UpdateTransform(begin + (int)i, all); });
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Graphics.h"
+#include <vector>
+#include <memory>
+
+class Entity;
+class TransformComponent;
+
+/*
+	The scene's transforms flattened by depth: every root, then every child of
+	a root, and so on, each level contiguous and every parent ahead of its
+	children. A level only reads world matrices of the one before it, so the
+	transforms in it are updated with a parallel loop, and the levels one after
+	another.
+
+	Only entities with boundsDirty set are recomputed, Scene::UpdateBounds has
+	already passed the flag down from a moved parent. The flattened order
+	holds raw pointers, it has to be rebuilt whenever an entity is added,
+	removed or reparented, which Invalidate marks.
+*/
+class TransformHierarchy
+{
+public:
+	// levels with fewer dirty candidates than this are updated on the calling thread
+	static const int ParallelLevelSize = 1024;
+	// transforms per job in a parallel level
+	static const int Grain = 256;
+
+	void Invalidate() { stale = true; }
+	// rebuilds the levels from entities if they are stale, then brings every dirty world matrix up to date
+	void Update(const std::vector<std::shared_ptr<Entity>>& entities);
+	int GetLevelCount() const { return (int)levelStarts.size() - 1; }
+	int GetTransformCount() const { return (int)transforms.size(); }
+	// result = a * b with SSE where available, result must not be b
+	static void Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& result);
+private:
+	void Rebuild(const std::vector<std::shared_ptr<Entity>>& entities);
+	void UpdateTransform(int index, bool all);
+
+	std::vector<TransformComponent*> transforms;
+	std::vector<Entity*> owners;
+	// index of the parent's transform, -1 for roots
+	std::vector<int> parents;
+	std::vector<glm::mat4> worlds;
+	// first transform of each level, with the total count at the end
+	std::vector<int> levelStarts = { 0 };
+	bool stale = true;
+};
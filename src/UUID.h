@@ -15,6 +15,7 @@ namespace Util
 		void Init(boost::uuids::uuid uuid);
 		void Init(std::string uuid);
 		operator std::string() const { return boost::lexical_cast<std::string>(uuid); }
+		const boost::uuids::uuid& Get() const { return uuid; }
 	private:
 		boost::uuids::uuid uuid;
 	};
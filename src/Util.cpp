@@ -1,7 +1,21 @@
 #include "Util.h"
+#include "AssetArchive.h"
+#include "MeshSimplifier.h"
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#endif
 
 std::string Util::LoadFileAsString(std::string filename)
 {
+    ArchiveSlice packed = AssetArchive::FindPacked(filename);
+    if (packed)
+    {
+        return std::string(packed.data, packed.size);
+    }
+
     std::stringstream fileSoFar;
     std::ifstream file(filename.c_str());
 
@@ -107,6 +121,7 @@ void Util::ProcessNode(aiNode* node, const aiScene* scene, std::shared_ptr<Model
 		//newMesh->AddAttribute(Mesh::MeshAttribute({ 2, GL_FLOAT, sizeof(float) }));
 		//newMesh->Init(meshData);
 
+		MeshSimplifier::GenerateLods(*meshData);
 		nodePtr->meshes.push_back(meshData);
 	}
 
@@ -161,3 +176,27 @@ bool Util::FileExists(std::string filename)
 		return false;
 	}
 }
+
+bool Util::GetMemoryUsage(size_t& current, size_t& peak)
+{
+	current = 0;
+	peak = 0;
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return false;
+	current = counters.WorkingSetSize;
+	peak = counters.PeakWorkingSetSize;
+	return true;
+#else
+	std::ifstream status("/proc/self/status");
+	if (!status.is_open()) return false;
+	std::string line;
+	while (std::getline(status, line))
+	{
+		// values are reported in kB
+		if (line.rfind("VmRSS:", 0) == 0) current = std::stoull(line.substr(6)) * 1024;
+		if (line.rfind("VmHWM:", 0) == 0) peak = std::stoull(line.substr(6)) * 1024;
+	}
+	return true;
+#endif
+}
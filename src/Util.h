@@ -19,5 +19,6 @@ namespace Util
 	std::shared_ptr<ModelData> LoadModel(std::string filename);
     bool FileExists(std::string filename);
     std::string GetValidFilename(std::string filename, std::string extension);
+    bool GetMemoryUsage(size_t& current, size_t& peak);
 }
 
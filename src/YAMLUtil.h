@@ -1,2 +1,117 @@
 #pragma once
 
+#include "yaml-cpp/yaml.h"
+#include "AssetArchive.h"
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <cmath>
+#include <streambuf>
+#include <istream>
+
+// Float conversion for the YAML files without going through yaml-cpp's
+// stringstream path. Output is the shortest text that reads back to the same
+// float, parsing falls back to yaml-cpp for anything from_chars does not take
+// (.inf, .nan, leading '+').
+namespace YAMLUtil
+{
+	// enough for the longest shortest-round-trip float, e.g. "-1.17549435e-38"
+	const int FloatBufferSize = 32;
+
+	inline int FormatFloat(char* buffer, float value)
+	{
+		if (std::isnan(value))
+		{
+			std::memcpy(buffer, ".nan", 4);
+			return 4;
+		}
+		if (std::isinf(value))
+		{
+			const char* text = value < 0 ? "-.inf" : ".inf";
+			int length = value < 0 ? 5 : 4;
+			std::memcpy(buffer, text, length);
+			return length;
+		}
+		std::to_chars_result result = std::to_chars(buffer, buffer + FloatBufferSize, value);
+		return (int)(result.ptr - buffer);
+	}
+
+	inline std::string FormatFloat(float value)
+	{
+		char buffer[FloatBufferSize];
+		return std::string(buffer, FormatFloat(buffer, value));
+	}
+
+	// appends "[a, b, c]" for count floats
+	inline void AppendFlow(std::string& out, const float* values, int count)
+	{
+		char buffer[FloatBufferSize];
+		out += '[';
+		for (int i = 0; i < count; i++)
+		{
+			if (i > 0) out += ", ";
+			out.append(buffer, FormatFloat(buffer, values[i]));
+		}
+		out += ']';
+	}
+
+	inline bool ParseFloat(const std::string& text, float& value)
+	{
+		const char* begin = text.data();
+		const char* end = begin + text.size();
+		std::from_chars_result result = std::from_chars(begin, end, value);
+		return result.ec == std::errc() && result.ptr == end;
+	}
+
+	inline float ParseFloat(const YAML::Node& node)
+	{
+		float value;
+		if (ParseFloat(node.Scalar(), value)) return value;
+		return node.as<float>();
+	}
+
+	// reads a flow sequence of exactly count floats
+	inline bool ParseFlow(const YAML::Node& node, float* values, int count)
+	{
+		if (!node.IsSequence() || node.size() != (size_t)count) return false;
+		for (int i = 0; i < count; i++)
+		{
+			values[i] = ParseFloat(node[i]);
+		}
+		return true;
+	}
+
+	// read-only stream over memory owned by someone else
+	class MemoryBuffer : public std::streambuf
+	{
+	public:
+		MemoryBuffer(const char* data, size_t size)
+		{
+			char* begin = const_cast<char*>(data);
+			setg(begin, begin, begin + size);
+		}
+	};
+
+	// parses straight out of the asset archive when the file is packed
+	inline YAML::Node LoadFile(const std::string& path)
+	{
+		ArchiveSlice slice = AssetArchive::FindPacked(path);
+		if (!slice) return YAML::LoadFile(path);
+		MemoryBuffer buffer(slice.data, slice.size);
+		std::istream stream(&buffer);
+		return YAML::Load(stream);
+	}
+
+	// writes the floats as plain scalars, the emitter only sees short strings
+	inline void EmitFlow(YAML::Emitter& out, const float* values, int count)
+	{
+		char buffer[FloatBufferSize];
+		out << YAML::Flow;
+		out << YAML::BeginSeq;
+		for (int i = 0; i < count; i++)
+		{
+			out << std::string(buffer, FormatFloat(buffer, values[i]));
+		}
+		out << YAML::EndSeq;
+	}
+}
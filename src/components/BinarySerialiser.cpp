@@ -0,0 +1,410 @@
+#include "BinarySerialiser.h"
+#include "Scene.h"
+#include "ResourceManager.h"
+#include "AssetArchive.h"
+#include "JobSystem.h"
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+
+BinarySceneSerialiser::BinarySceneSerialiser(std::shared_ptr<Scene> scene) : scene(scene)
+{
+}
+
+std::string BinarySceneSerialiser::GetPath(std::string scenePath)
+{
+	size_t dot = scenePath.find_last_of('.');
+	if (dot == std::string::npos) return scenePath + ".bscene";
+	return scenePath.substr(0, dot) + ".bscene";
+}
+
+bool BinarySceneSerialiser::Serialise(std::string folder)
+{
+	std::shared_ptr<Scene> scene = this->scene.lock();
+	if (!scene) return false;
+
+	// dense ids for entities and resources, records only store these
+	std::vector<std::shared_ptr<Entity>> entities;
+	entityIndices.clear();
+	meshIndices.clear();
+	materialIndices.clear();
+	meshIds.clear();
+	materialIds.clear();
+	for (auto& entity : scene->entities)
+	{
+		if (!entity) continue;
+		entityIndices[entity.get()] = (uint32_t)entities.size();
+		entities.push_back(entity);
+
+		MeshRendererComponent* meshRenderer = entity->GetComponent<MeshRendererComponent>();
+		if (!meshRenderer) continue;
+		for (auto& mesh : meshRenderer->meshes)
+		{
+			const std::string& id = mesh.GetId();
+			if (!id.empty() && meshIndices.find(id) == meshIndices.end())
+			{
+				meshIndices[id] = (uint32_t)meshIds.size();
+				meshIds.push_back(id);
+			}
+		}
+		for (auto& material : meshRenderer->materials)
+		{
+			const std::string& id = material.GetId();
+			if (!id.empty() && materialIndices.find(id) == materialIndices.end())
+			{
+				materialIndices[id] = (uint32_t)materialIds.size();
+				materialIds.push_back(id);
+			}
+		}
+	}
+
+	BinaryWriter out;
+	out.Write<uint32_t>(Magic);
+	out.Write<uint32_t>(Version);
+	out.WriteString(scene->name);
+
+	out.Write<uint32_t>((uint32_t)entities.size());
+	for (auto& entity : entities)
+	{
+		out.Write(entity->uuid.Get());
+	}
+
+	out.Write<uint32_t>((uint32_t)meshIds.size());
+	for (auto& id : meshIds) out.WriteString(id);
+	out.Write<uint32_t>((uint32_t)materialIds.size());
+	for (auto& id : materialIds) out.WriteString(id);
+
+	size_t chunkCountOffset = out.Reserve<uint32_t>();
+	uint32_t chunkCount = 0;
+	for (ChunkType type : { ChunkType::Tag, ChunkType::Transform, ChunkType::MeshRenderer, ChunkType::Light })
+	{
+		chunkCount += WriteChunks(out, type, entities);
+	}
+	out.Patch<uint32_t>(chunkCountOffset, chunkCount);
+
+	// same temp file and rename as the yaml writer, a crash mid write leaves the old file intact
+	std::string path = folder + scene->name + ".bscene";
+	std::string tempPath = path + ".tmp";
+	std::ofstream fout(tempPath, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to write scene " << tempPath << std::endl;
+		return false;
+	}
+	fout.write(out.buffer.data(), out.buffer.size());
+	fout.close();
+
+	std::error_code error;
+	if (fout.fail())
+	{
+		std::cout << "Failed to write scene " << tempPath << std::endl;
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::cout << "Failed to replace scene " << path << ": " << error.message() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool BinarySceneSerialiser::HasComponent(ChunkType type, std::shared_ptr<Entity> entity)
+{
+	switch (type)
+	{
+	case ChunkType::Tag:
+		return entity->GetComponent<TagComponent>() != nullptr;
+	case ChunkType::Transform:
+		return entity->GetComponent<TransformComponent>() != nullptr;
+	case ChunkType::MeshRenderer:
+		return entity->GetComponent<MeshRendererComponent>() != nullptr;
+	case ChunkType::Light:
+		return entity->GetComponent<LightComponent>() != nullptr;
+	}
+	return false;
+}
+
+uint32_t BinarySceneSerialiser::WriteChunks(BinaryWriter& out, ChunkType type, std::vector<std::shared_ptr<Entity>>& entities)
+{
+	size_t headerOffset = 0;
+	uint32_t count = 0;
+	uint32_t chunks = 0;
+	for (uint32_t i = 0; i < entities.size(); i++)
+	{
+		if (!HasComponent(type, entities[i])) continue;
+		if (count == 0)
+		{
+			out.Write<uint32_t>((uint32_t)type);
+			headerOffset = out.Reserve<uint32_t>();
+			out.Reserve<uint64_t>();
+			chunks++;
+		}
+		WriteRecord(out, type, i, entities[i]);
+		count++;
+		if (count == ChunkCapacity)
+		{
+			out.Patch<uint32_t>(headerOffset, count);
+			out.Patch<uint64_t>(headerOffset + sizeof(uint32_t), out.Size() - headerOffset - sizeof(uint32_t) - sizeof(uint64_t));
+			count = 0;
+		}
+	}
+	if (count > 0)
+	{
+		out.Patch<uint32_t>(headerOffset, count);
+		out.Patch<uint64_t>(headerOffset + sizeof(uint32_t), out.Size() - headerOffset - sizeof(uint32_t) - sizeof(uint64_t));
+	}
+	return chunks;
+}
+
+void BinarySceneSerialiser::WriteRecord(BinaryWriter& out, ChunkType type, uint32_t index, std::shared_ptr<Entity> entity)
+{
+	out.Write<uint32_t>(index);
+	switch (type)
+	{
+	case ChunkType::Tag:
+	{
+		out.WriteString(entity->GetComponent<TagComponent>()->name);
+		break;
+	}
+	case ChunkType::Transform:
+	{
+		TransformComponent* transform = entity->GetComponent<TransformComponent>();
+		out.Write(transform->translation);
+		out.Write(transform->rotation);
+		out.Write(transform->scale);
+		std::shared_ptr<Entity> parent = transform->parent.lock();
+		auto parentIt = parent ? entityIndices.find(parent.get()) : entityIndices.end();
+		out.Write<int32_t>(parentIt == entityIndices.end() ? -1 : (int32_t)parentIt->second);
+		// children that are no longer in the scene are dropped rather than written as dangling ids
+		size_t countOffset = out.Reserve<uint32_t>();
+		uint32_t childCount = 0;
+		for (auto& child : transform->children)
+		{
+			auto childIt = child ? entityIndices.find(child.get()) : entityIndices.end();
+			if (childIt == entityIndices.end()) continue;
+			out.Write<uint32_t>(childIt->second);
+			childCount++;
+		}
+		out.Patch<uint32_t>(countOffset, childCount);
+		break;
+	}
+	case ChunkType::MeshRenderer:
+	{
+		MeshRendererComponent* meshRenderer = entity->GetComponent<MeshRendererComponent>();
+		out.Write<uint32_t>((uint32_t)meshRenderer->meshes.size());
+		for (auto& mesh : meshRenderer->meshes)
+		{
+			auto it = meshIndices.find(mesh.GetId());
+			out.Write<uint32_t>(it == meshIndices.end() ? UINT32_MAX : it->second);
+		}
+		out.Write<uint32_t>((uint32_t)meshRenderer->materials.size());
+		for (auto& material : meshRenderer->materials)
+		{
+			auto it = materialIndices.find(material.GetId());
+			out.Write<uint32_t>(it == materialIndices.end() ? UINT32_MAX : it->second);
+		}
+		out.Write<uint8_t>(meshRenderer->isStatic ? 1 : 0);
+		break;
+	}
+	case ChunkType::Light:
+	{
+		LightComponent* light = entity->GetComponent<LightComponent>();
+		out.Write<uint8_t>((uint8_t)light->type);
+		out.Write(light->color);
+		out.Write(light->intensity);
+		out.Write(light->range);
+		out.Write(light->innerAngle);
+		out.Write(light->outerAngle);
+		break;
+	}
+	}
+}
+
+std::shared_ptr<Scene> BinarySceneSerialiser::Deserialise(std::string path)
+{
+	auto start = std::chrono::steady_clock::now();
+	// chunks point into the file, the slice stays alive until every chunk is decoded
+	ArchiveSlice file = AssetArchive::Read(path);
+	if (!file)
+	{
+		std::cout << "Failed to open scene " << path << std::endl;
+		return nullptr;
+	}
+
+	BinaryReader in(file.data, file.size);
+	if (in.Read<uint32_t>() != Magic || in.Read<uint32_t>() != Version)
+	{
+		std::cout << "Scene " << path << " is not a supported binary scene" << std::endl;
+		return nullptr;
+	}
+	std::shared_ptr<Scene> scene = std::make_shared<Scene>(in.ReadString());
+
+	// entities exist before any chunk is decoded so parent and child ids resolve directly
+	uint32_t entityCount = in.Read<uint32_t>();
+	if (!in.ok || (size_t)entityCount * sizeof(boost::uuids::uuid) > in.Remaining())
+	{
+		std::cout << "Scene " << path << " is truncated" << std::endl;
+		return nullptr;
+	}
+	std::vector<std::shared_ptr<Entity>> entities(entityCount);
+	for (uint32_t i = 0; i < entityCount; i++)
+	{
+		Util::UUID uuid;
+		uuid.Init(in.Read<boost::uuids::uuid>());
+		entities[i] = std::make_shared<Entity>(uuid);
+	}
+
+	// the decode threads only copy these handles, resources are loaded on the main thread when first drawn
+	ResourceTable resources;
+	uint32_t meshCount = in.Read<uint32_t>();
+	for (uint32_t i = 0; i < meshCount && in.ok; i++)
+	{
+		resources.meshes.push_back(ResourceHandle<Mesh>(in.ReadString()));
+	}
+	uint32_t materialCount = in.Read<uint32_t>();
+	for (uint32_t i = 0; i < materialCount && in.ok; i++)
+	{
+		resources.materials.push_back(ResourceHandle<MaterialInstance>(in.ReadString()));
+	}
+
+	std::vector<Chunk> chunks;
+	uint32_t chunkCount = in.Read<uint32_t>();
+	for (uint32_t i = 0; i < chunkCount && in.ok; i++)
+	{
+		Chunk chunk;
+		chunk.type = (ChunkType)in.Read<uint32_t>();
+		chunk.count = in.Read<uint32_t>();
+		chunk.size = (size_t)in.Read<uint64_t>();
+		chunk.data = in.Current();
+		in.Skip(chunk.size);
+		chunks.push_back(chunk);
+	}
+	if (!in.ok)
+	{
+		std::cout << "Scene " << path << " is truncated" << std::endl;
+		return nullptr;
+	}
+
+	// a job per chunk, idle threads steal the ones left over
+	std::vector<ChunkResult> results(chunks.size());
+	JobSystem::GetSingleton().ParallelFor(chunks.size(), 1, [&](size_t i)
+		{
+			results[i] = DecodeChunk(chunks[i], entities, resources);
+		}
+	);
+
+	// components are attached in chunk order, which keeps the tag, transform, mesh renderer, light order of the yaml loader
+	for (auto& result : results)
+	{
+		if (!result.ok)
+		{
+			std::cout << "Scene " << path << " has a corrupt component chunk" << std::endl;
+			return nullptr;
+		}
+		for (auto& component : result.components)
+		{
+			entities[component.first]->AddComponent(component.second);
+		}
+	}
+	for (auto& entity : entities)
+	{
+		scene->AddEntityInternal(entity);
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Loaded " << path << " (" << entityCount << " entities, " << chunks.size() << " chunks) in " << elapsed.count() << "ms" << std::endl;
+	return scene;
+}
+
+BinarySceneSerialiser::ChunkResult BinarySceneSerialiser::DecodeChunk(const Chunk& chunk, const std::vector<std::shared_ptr<Entity>>& entities, const ResourceTable& resources)
+{
+	ChunkResult result;
+	result.components.reserve(chunk.count);
+	BinaryReader in(chunk.data, chunk.size);
+	for (uint32_t i = 0; i < chunk.count; i++)
+	{
+		uint32_t index = in.Read<uint32_t>();
+		if (!in.ok || index >= entities.size())
+		{
+			result.ok = false;
+			return result;
+		}
+
+		switch (chunk.type)
+		{
+		case ChunkType::Tag:
+		{
+			result.components.push_back({ index, std::make_shared<TagComponent>(in.ReadString()) });
+			break;
+		}
+		case ChunkType::Transform:
+		{
+			glm::vec3 translation = in.Read<glm::vec3>();
+			glm::vec3 rotation = in.Read<glm::vec3>();
+			glm::vec3 scale = in.Read<glm::vec3>();
+			std::shared_ptr<TransformComponent> transform = std::make_shared<TransformComponent>(translation, rotation, scale);
+			int32_t parent = in.Read<int32_t>();
+			if (parent >= 0 && parent < (int32_t)entities.size())
+			{
+				transform->parent = entities[parent];
+			}
+			uint32_t childCount = in.Read<uint32_t>();
+			if (!in.ok || (size_t)childCount * sizeof(uint32_t) > in.Remaining())
+			{
+				result.ok = false;
+				return result;
+			}
+			transform->children.reserve(childCount);
+			for (uint32_t c = 0; c < childCount; c++)
+			{
+				uint32_t child = in.Read<uint32_t>();
+				if (child < entities.size())
+				{
+					transform->children.push_back(entities[child]);
+				}
+			}
+			result.components.push_back({ index, transform });
+			break;
+		}
+		case ChunkType::MeshRenderer:
+		{
+			std::shared_ptr<MeshRendererComponent> meshRenderer = std::make_shared<MeshRendererComponent>();
+			uint32_t meshCount = in.Read<uint32_t>();
+			for (uint32_t m = 0; m < meshCount && in.ok; m++)
+			{
+				uint32_t mesh = in.Read<uint32_t>();
+				meshRenderer->meshes.push_back(mesh < resources.meshes.size() ? resources.meshes[mesh] : ResourceHandle<Mesh>());
+			}
+			uint32_t materialCount = in.Read<uint32_t>();
+			for (uint32_t m = 0; m < materialCount && in.ok; m++)
+			{
+				uint32_t material = in.Read<uint32_t>();
+				meshRenderer->materials.push_back(material < resources.materials.size() ? resources.materials[material] : ResourceHandle<MaterialInstance>());
+			}
+			meshRenderer->isStatic = in.Read<uint8_t>() != 0;
+			result.components.push_back({ index, meshRenderer });
+			break;
+		}
+		case ChunkType::Light:
+		{
+			std::shared_ptr<LightComponent> light = std::make_shared<LightComponent>();
+			light->type = (LightType)in.Read<uint8_t>();
+			light->color = in.Read<glm::vec3>();
+			light->intensity = in.Read<float>();
+			light->range = in.Read<float>();
+			light->innerAngle = in.Read<float>();
+			light->outerAngle = in.Read<float>();
+			result.components.push_back({ index, light });
+			break;
+		}
+		default:
+			// unknown chunk types from newer versions are skipped whole
+			return result;
+		}
+	}
+	result.ok = in.ok;
+	return result;
+}
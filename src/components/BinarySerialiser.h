@@ -0,0 +1,79 @@
+#pragma once
+#include "BinaryStream.h"
+#include "ResourceHandle.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class Scene;
+class Entity;
+class Component;
+class Mesh;
+struct MaterialInstance;
+
+/*
+	.bscene layout, all counts are uint32
+	  header    magic, version, scene name
+	  entities  count, 16 byte uuid per entity, the position in this table is the entity's id
+	  resources mesh count + mesh uuids, material instance count + material instance uuids
+	  chunks    count, then per chunk: type, record count, byte size, records
+	Records reference entities and resources by their index in the tables above,
+	so nothing has to be looked up by uuid while the chunks are decoded.
+*/
+class BinarySceneSerialiser
+{
+public:
+	enum class ChunkType : uint32_t
+	{
+		Tag = 1,
+		Transform = 2,
+		MeshRenderer = 3,
+		Light = 4,
+	};
+
+	static const uint32_t Magic = 0x4E435342; // "BSCN"
+	static const uint32_t Version = 2;
+	// records per chunk, large scenes are split so chunks of the same type decode in parallel
+	static const uint32_t ChunkCapacity = 4096;
+
+	BinarySceneSerialiser(std::shared_ptr<Scene> scene);
+	bool Serialise(std::string folder);
+
+	static std::shared_ptr<Scene> Deserialise(std::string path);
+	static std::string GetPath(std::string scenePath);
+private:
+	struct Chunk
+	{
+		ChunkType type;
+		uint32_t count;
+		const char* data;
+		size_t size;
+	};
+
+	struct ChunkResult
+	{
+		std::vector<std::pair<uint32_t, std::shared_ptr<Component>>> components;
+		bool ok = true;
+	};
+
+	struct ResourceTable
+	{
+		std::vector<ResourceHandle<Mesh>> meshes;
+		std::vector<ResourceHandle<MaterialInstance>> materials;
+	};
+
+	uint32_t WriteChunks(BinaryWriter& out, ChunkType type, std::vector<std::shared_ptr<Entity>>& entities);
+	void WriteRecord(BinaryWriter& out, ChunkType type, uint32_t index, std::shared_ptr<Entity> entity);
+	bool HasComponent(ChunkType type, std::shared_ptr<Entity> entity);
+
+	static ChunkResult DecodeChunk(const Chunk& chunk, const std::vector<std::shared_ptr<Entity>>& entities, const ResourceTable& resources);
+
+	std::weak_ptr<Scene> scene;
+	std::unordered_map<Entity*, uint32_t> entityIndices;
+	// keyed by uuid, the handles are never locked so saving does not load anything
+	std::unordered_map<std::string, uint32_t> meshIndices;
+	std::unordered_map<std::string, uint32_t> materialIndices;
+	std::vector<std::string> meshIds;
+	std::vector<std::string> materialIds;
+};
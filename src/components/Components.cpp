@@ -1,12 +1,10 @@
 #include "Components.h"
 #include "Entity.h"
+#include <algorithm>
 
 glm::mat4 TransformComponent::GetTransform()
 {
-    glm::mat4 parentTransform = GetParentTransform();
-    glm::mat4 localTransform = GetLocalTransform();
-
-    return parentTransform * localTransform;
+    return world;
 }
 
 glm::mat4 TransformComponent::GetLocalTransform()
@@ -32,3 +30,20 @@ glm::mat4 TransformComponent::GetParentTransform()
 	}
 	return parentTransform;
 }
+
+int MeshRendererComponent::SelectLod(int index, const glm::mat4& transform, glm::vec3 cameraPosition, float tanHalfFovY)
+{
+	std::shared_ptr<Mesh> mesh = meshes[index].lock();
+	if (lods.size() != meshes.size()) lods.resize(meshes.size(), 0);
+	if (!mesh || mesh->GetLodCount() < 2) return 0;
+
+	// fraction of the screen height the bounding sphere covers
+	float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	float radius = mesh->boundsRadius * scale;
+	glm::vec3 center = glm::vec3(transform * glm::vec4(mesh->boundsCenter, 1.0f));
+	float distance = glm::length(center - cameraPosition);
+	float screenSize = distance > radius ? radius / (distance * tanHalfFovY) : 1.0f;
+
+	lods[index] = mesh->SelectLod(screenSize, lods[index]);
+	return lods[index];
+}
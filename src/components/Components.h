@@ -24,8 +24,10 @@ public:
 	glm::vec3 scale;
 	std::weak_ptr<Entity> parent;
 	std::vector<std::shared_ptr<Entity>> children;
-	//glm::mat4 transform;
+	// local to world as of the scene's last transform update, the scene's TransformHierarchy keeps it
+	glm::mat4 world = glm::mat4(1.0f);
 
+	// the cached world matrix
 	glm::mat4 GetTransform();
 	glm::mat4 GetLocalTransform();
 	glm::mat4 GetParentTransform();
@@ -35,8 +37,14 @@ public:
 class MeshRendererComponent : public Component
 {
 public:
-	std::vector<std::weak_ptr<Mesh>> meshes;
-	std::vector<std::weak_ptr<MaterialInstance>> materials;
+	std::vector<ResourceHandle<Mesh>> meshes;
+	std::vector<ResourceHandle<MaterialInstance>> materials;
+	// level of detail each mesh was drawn with last frame
+	std::vector<int> lods;
+	// never expected to move, cast into the cached shadow layer instead of every frame
+	bool isStatic = false;
+
+	int SelectLod(int index, const glm::mat4& transform, glm::vec3 cameraPosition, float tanHalfFovY);
 };
 
 class TagComponent : public Component
@@ -49,3 +57,22 @@ public:
 	TagComponent(std::string name) : name(name) {};
 };
 
+enum class LightType : uint8_t
+{
+	Point,
+	Spot,
+	Directional,
+};
+
+class LightComponent : public Component
+{
+public:
+	LightType type = LightType::Point;
+	glm::vec3 color = glm::vec3(1.0f);
+	float intensity = 50.0f;
+	// point and spot lights fade to nothing at this distance, it bounds the clusters they are listed in
+	float range = 20.0f;
+	// spot cone half angles in degrees, full strength inside inner and none past outer
+	float innerAngle = 20.0f;
+	float outerAngle = 30.0f;
+};
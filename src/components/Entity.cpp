@@ -28,10 +28,15 @@ Entity::Entity(std::string id, std::shared_ptr<TagComponent> tagComponent, std::
 	}
 }
 
+Entity::Entity(Util::UUID id) : uuid(id)
+{
+}
+
 void Entity::AddComponent(std::shared_ptr<Component> component)
 {
 	component->entity = this;
 	components.push_back(component);
+	MarkDirty();
 }
 
 //void Entity::AddChild(std::shared_ptr<Entity> child)
@@ -62,6 +67,7 @@ void Entity::RemoveComponent(std::shared_ptr<Component> component)
 	if (position != components.end())
 	{
 		components.erase(position);
+		MarkDirty();
 	}
 }
 
@@ -16,6 +16,7 @@ public:
 	Entity();
 	Entity(std::string name);
 	Entity(std::string id, std::shared_ptr<TagComponent> tagComponent, std::shared_ptr<TransformComponent> transformComponent);
+	Entity(Util::UUID id);
 	void AddComponent(std::shared_ptr<Component> component);
 	//void AddChild(std::shared_ptr<Entity> child);
 	//void RemoveChild(std::shared_ptr<Entity> child);
@@ -33,8 +34,21 @@ public:
 		}
 		return nullptr;
 	}
+	// set whenever a component is added, removed or edited, cleared once the entity has been saved
+	void MarkDirty() { dirty = true; boundsDirty = true; }
 	//Entity* parent;
 	Util::UUID uuid;
+	bool dirty = false;
+	// set with dirty but only cleared once the scene's BVH has the entity's new bounds
+	bool boundsDirty = true;
+	// leaf in the scene's BVH, -1 when the entity has nothing to draw
+	int boundsProxy = -1;
+	// bounds are a stand-in box because a mesh was neither loaded nor indexed, redone once it loads
+	bool proxyBounds = false;
+	// hidden behind the occluders when last tested, see OcclusionCulling
+	bool occluded = false;
+	// static when its bounds were last updated, so leaving the static set also clears the shadow cache
+	bool staticCaster = false;
 private:
 	std::vector<std::shared_ptr<Component>> components;
 };
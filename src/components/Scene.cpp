@@ -1,5 +1,7 @@
 #include "Scene.h"
 #include "ResourceManager.h"
+#include "AssetDatabase.h"
+#include "Profiler.h"
 
 void Scene::CreateChild(std::shared_ptr<Entity> entity)
 {
@@ -26,6 +28,9 @@ void Scene::AddChildToEntity(std::shared_ptr<Entity> child, std::shared_ptr<Enti
 
 	childTransformComponent->parent = entity;
 	transformComponent->children.push_back(child);
+	transforms.Invalidate();
+	entity->MarkDirty();
+	child->MarkDirty();
 }
 
 std::vector<std::shared_ptr<Entity>>& Scene::GetChildrenForEntity(std::shared_ptr<Entity> entity)
@@ -50,6 +55,9 @@ void Scene::RemoveChildFromEntity(std::shared_ptr<Entity> child, std::shared_ptr
 	{
 		transformComponent->children.erase(position);
 		childTransformComponent->parent.reset();
+		transforms.Invalidate();
+		entity->MarkDirty();
+		child->MarkDirty();
 	}
 }
 
@@ -60,58 +68,120 @@ void Scene::RemoveEntity(std::shared_ptr<Entity> entity)
 
 std::shared_ptr<Entity> Scene::GetEntity(std::string uuid)
 {
-	auto it = std::find_if(entities.begin(), entities.end(), [&](const std::shared_ptr<Entity> entity)
-		{
-			return std::string(entity->uuid) == uuid;
-		}
-	);
-	if (it == entities.end()) return nullptr;
-	return entities[std::distance(entities.begin(), it)];
+	auto it = lookup.find(uuid);
+	if (it == lookup.end()) return nullptr;
+	return it->second;
 }
 
 void Scene::Update(float dt)
+{
+	ProfileScope scope("UpdateBounds");
+	UpdateBounds();
+}
+
+RenderGraph::Resource Scene::AddPasses(RenderGraph& graph, int width, int height, int samples)
 {
 	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
-	ResourceManager& resources = ResourceManager::GetSingleton();
+	bool temporal = renderer.antiAliasing == OpenGLRenderer::AntiAliasing::Temporal;
 	glm::mat4 view = renderer.GetViewMatrix();
 	glm::mat4 projection = renderer.GetProjectionMatrix();
+	if (temporal)
+	{
+		// the jitter stands in for the samples, a pixel is two units of ndc
+		samples = 1;
+		projection = renderer.GetProjectionMatrix(renderer.temporalAA.NextJitter() * 2.0f / glm::vec2(width, height));
+	}
+	glm::vec4 viewport(0, 0, width, height);
+	lighting.Init();
+	shadows.Init();
+
+	RenderGraph::TextureDesc colorDesc;
+	colorDesc.width = width;
+	colorDesc.height = height;
+	colorDesc.samples = samples;
+	RenderGraph::TextureDesc depthDesc = colorDesc;
+	depthDesc.format = GL_DEPTH32F_STENCIL8;
+	RenderGraph::Resource color = graph.CreateTexture("SceneColor", colorDesc);
+	RenderGraph::Resource depth = graph.CreateTexture("SceneDepth", depthDesc);
+	RenderGraph::Resource clusters = graph.ImportBuffer("LightClusters", lighting.GetClusterBuffer());
+	RenderGraph::Resource shadowMap = graph.ImportTexture("ShadowMap", shadows.GetTexture(), shadows.GetDesc());
+
+	RenderGraph::Pass& lightPass = graph.AddPass("LightClusters", [this, view, projection, viewport]()
+	{
+		Camera& camera = OpenGLRenderer::GetSingleton().camera;
+		lighting.Update(*this, view, projection, camera.near, camera.far, viewport);
+	});
+	lightPass.Write(clusters, RenderGraph::Access::Storage);
+
+	RenderGraph::Pass& shadowPass = graph.AddPass("ShadowMaps", [this, view]()
+	{
+		shadows.Render(*this, view, OpenGLRenderer::GetSingleton().camera);
+	});
+	// one layer at a time, so the pass attaches them itself
+	shadowPass.Write(shadowMap, RenderGraph::Access::Attachment);
+	shadowPass.manualTargets = true;
+
+	RenderGraph::Pass& forwardPass = graph.AddPass("Forward", [this, view, projection]()
+	{
+		Draw(view, projection);
+	});
+	forwardPass.Read(clusters, RenderGraph::Access::Storage);
+	forwardPass.Read(shadowMap, RenderGraph::Access::Sampled);
+	forwardPass.Write(color, RenderGraph::Access::Attachment);
+	forwardPass.Write(depth, RenderGraph::Access::Attachment);
+	forwardPass.clear = true;
+	if (temporal) return renderer.temporalAA.AddPasses(graph, color, depth);
+	return color;
+}
+
+void Scene::Draw(const glm::mat4& view, const glm::mat4& projection)
+{
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	ResourceManager& resources = ResourceManager::GetSingleton();
 	glm::vec3 cameraPos = renderer.GetCameraPosition();
+	float tanHalfFovY = std::tan(renderer.camera.fovY * 0.5f);
+	renderer.SetDepthTest(true);
 	for (auto& shader : resources.shaders)
 	{
 		shader->Use();
-		renderer.SetUniform(shader, "u_viewMatrix", view, 1);
-		renderer.SetUniform(shader, "u_projectionMatrix", projection, 1);
+		glm::mat4 viewMatrix = view;
+		glm::mat4 projectionMatrix = projection;
+		renderer.SetUniform(shader, "u_viewMatrix", viewMatrix, 1);
+		renderer.SetUniform(shader, "u_projectionMatrix", projectionMatrix, 1);
 		renderer.SetUniform(shader, "u_cameraPos", cameraPos, 1);
+		renderer.SetUniform(shader, "u_indirect", gpuDriven ? 1 : 0);
+		lighting.Bind(shader);
+		shadows.Bind(shader);
 	}
-	for (auto entity : entities)
+	glm::mat4 viewProjection = projection * view;
+	std::vector<Entity*> visible;
+	if (!gpuDriven || occlusion.enabled)
 	{
-		if (!entity) continue;
-		// update transform
-		// render
-		TransformComponent* transformComponent = entity->GetComponent<TransformComponent>();
-		MeshRendererComponent* meshRendererComponent = entity->GetComponent<MeshRendererComponent>();
-		//MaterialComponent* materialComponent = entities[i]->GetComponent<MaterialComponent>();
-
-
-		if (transformComponent && meshRendererComponent)
-		{
-			glm::mat4 transform = transformComponent->GetTransform();
-
-			//renderer.SetUniform(materialComponent->material->shader.lock(), "u_modelMatrix", transform, 1);
-
-			//materialComponent->material->Bind();
+		ProfileScope scope("FrustumCull");
+		bvh.QueryFrustum(Frustum(viewProjection), visible);
+	}
+	if (occlusion.enabled)
+	{
+		occlusion.RenderOccluders(visible, *this, viewProjection, cameraPos, tanHalfFovY);
+	}
+	if (gpuDriven)
+	{
+		gpuCulling.Draw(*this, viewProjection, cameraPos, tanHalfFovY, occlusion.enabled ? &occlusion : nullptr);
+		return;
+	}
 
-			for (int i = 0; i < meshRendererComponent->meshes.size(); i++)
-			{
-				std::shared_ptr<MaterialInstance> material = meshRendererComponent->materials[i].lock();
-				material->shader.lock()->Use();
-				renderer.SetUniform(material->shader.lock(), "u_modelMatrix", transform, 1);
-				material->Bind();
-				meshRendererComponent->meshes[i].lock()->Draw();
-			}
-			renderer.UnbindTexture();
-		}
+	renderer.stats.culled += bvh.GetLeafCount() - (int)visible.size();
+	if (occlusion.enabled)
+	{
+		ProfileScope scope("OcclusionTest");
+		occlusion.Cull(visible, *this, viewProjection);
+	}
+	{
+		ProfileScope scope("RecordDraws");
+		queue.Clear();
+		queue.Record(visible, cameraPos, tanHalfFovY);
 	}
+	queue.Submit();
 }
 
 void Scene::CleanUp()
@@ -148,10 +218,166 @@ void Scene::RemoveEntityInternal(std::shared_ptr<Entity> entity)
 	{
 		entities.erase(it);
 	}
+	lookup.erase(std::string(entity->uuid));
+	removed.push_back(entity->uuid);
+	if (entity->boundsProxy >= 0)
+	{
+		bvh.Remove(entity->boundsProxy);
+		entity->boundsProxy = -1;
+	}
+	boundsVersion++;
+	entityVersion++;
+	if (entity->staticCaster) staticVersion++;
+	transforms.Invalidate();
 	entity.reset();
 }
 
 void Scene::AddEntityInternal(std::shared_ptr<Entity> entity)
 {
 	entities.push_back(entity);
+	lookup[std::string(entity->uuid)] = entity;
+	entityVersion++;
+	transforms.Invalidate();
+	entity->MarkDirty();
+}
+
+bool Scene::MeshesLoaded(Entity* entity)
+{
+	MeshRendererComponent* meshRendererComponent = entity->GetComponent<MeshRendererComponent>();
+	if (!meshRendererComponent) return true;
+	for (auto& handle : meshRendererComponent->meshes)
+	{
+		if (!handle.IsLoaded()) return false;
+	}
+	return true;
+}
+
+void Scene::UpdateBounds()
+{
+	// a moved parent moves everything below it
+	std::vector<Entity*> stack;
+	for (auto& entity : entities)
+	{
+		if (!entity) continue;
+		if (entity->proxyBounds && !entity->boundsDirty && MeshesLoaded(entity.get())) entity->boundsDirty = true;
+		if (entity->boundsDirty) stack.push_back(entity.get());
+	}
+	while (!stack.empty())
+	{
+		Entity* entity = stack.back();
+		stack.pop_back();
+		TransformComponent* transformComponent = entity->GetComponent<TransformComponent>();
+		if (!transformComponent) continue;
+		for (auto& child : transformComponent->children)
+		{
+			if (child->boundsDirty) continue;
+			child->boundsDirty = true;
+			stack.push_back(child.get());
+		}
+	}
+
+	transforms.Update(entities);
+
+	int changed = 0;
+	for (auto& entity : entities)
+	{
+		if (!entity || !entity->boundsDirty) continue;
+		entity->boundsDirty = false;
+		changed++;
+		if (movedEntities.size() < entities.size())
+		{
+			movedEntities.push_back(entity.get());
+		}
+		else
+		{
+			movedOverflow = true;
+		}
+
+		AABB bounds;
+		TransformComponent* transformComponent = entity->GetComponent<TransformComponent>();
+		MeshRendererComponent* meshRendererComponent = entity->GetComponent<MeshRendererComponent>();
+		bool isStatic = meshRendererComponent && meshRendererComponent->isStatic;
+		if (isStatic || entity->staticCaster) staticVersion++;
+		entity->staticCaster = isStatic;
+		entity->proxyBounds = false;
+		if (transformComponent && meshRendererComponent)
+		{
+			// never loads a mesh, unloaded ones are bounded from the asset index or a stand-in box
+			AssetDatabase* database = AssetDatabase::GetSingletonPtr();
+			glm::mat4 transform = transformComponent->GetTransform();
+			for (auto& handle : meshRendererComponent->meshes)
+			{
+				AABB meshBounds;
+				if (handle.IsLoaded())
+				{
+					meshBounds = handle.lock()->bounds;
+				}
+				else if (!database || !database->GetBounds(handle.GetId(), meshBounds))
+				{
+					meshBounds = AABB(glm::vec3(-ProxyExtent), glm::vec3(ProxyExtent));
+					entity->proxyBounds = true;
+				}
+				if (meshBounds.IsValid()) bounds.Grow(meshBounds.Transform(transform));
+			}
+		}
+
+		if (!bounds.IsValid())
+		{
+			if (entity->boundsProxy >= 0) bvh.Remove(entity->boundsProxy);
+			entity->boundsProxy = -1;
+		}
+		else if (entity->boundsProxy < 0)
+		{
+			entity->boundsProxy = bvh.Insert(bounds, entity.get());
+		}
+		else
+		{
+			bvh.Move(entity->boundsProxy, bounds);
+		}
+	}
+
+	if (changed > 0) boundsVersion++;
+
+	// the incremental inserts above keep the tree valid but not tight, after a large edit start over
+	if (changed > 1 && changed > entities.size() * RebuildFraction)
+	{
+		bvh.Rebuild();
+	}
+}
+
+std::shared_ptr<Entity> Scene::Raycast(glm::vec3 origin, glm::vec3 direction, float& distance)
+{
+	UpdateBounds();
+	Entity* hit = bvh.Raycast(origin, direction, FLT_MAX, distance);
+	if (!hit) return nullptr;
+	return GetEntity(std::string(hit->uuid));
+}
+
+bool Scene::IsDirty()
+{
+	if (!removed.empty()) return true;
+	for (auto& entity : entities)
+	{
+		if (entity && entity->dirty) return true;
+	}
+	return false;
+}
+
+void Scene::ClearDirty()
+{
+	for (auto& entity : entities)
+	{
+		if (entity) entity->dirty = false;
+	}
+	removed.clear();
+}
+
+std::vector<std::shared_ptr<Entity>> Scene::GetDirtyEntities()
+{
+	std::vector<std::shared_ptr<Entity>> result;
+	for (auto& entity : entities)
+	{
+		if (entity && entity->dirty) result.push_back(entity);
+	}
+	return result;
 }
@@ -3,8 +3,16 @@
 #include "Components.h"
 #include "../OpenGLRenderer.h"
 #include "Renderer.h"
+#include "../BVH.h"
+#include "../GPUCulling.h"
+#include "../OcclusionCulling.h"
+#include "../ClusteredLighting.h"
+#include "../ShadowMaps.h"
+#include "../RenderQueue.h"
+#include "../TransformHierarchy.h"
 #include <string>
 #include <map>
+#include <unordered_map>
 
 class Scene
 {
@@ -21,14 +29,59 @@ public:
 	void RemoveChildFromEntity(std::shared_ptr<Entity> child, std::shared_ptr<Entity> entity);
 	void RemoveEntity(std::shared_ptr<Entity> entity);
 	std::shared_ptr<Entity> GetEntity(std::string uuid);
+	// brings the scene's bookkeeping up to date before the frame is drawn
 	void Update(float dt);
+	// records the passes that draw the scene at this size, returns the colour target they draw into,
+	// or the temporal resolve of it when the renderer uses TAA, which also ignores samples
+	RenderGraph::Resource AddPasses(RenderGraph& graph, int width, int height, int samples);
+	// brings world matrices and the BVH in step with entities whose transform or meshes changed
+	void UpdateBounds();
+	// closest entity whose bounds the ray hits, used for picking in the viewport
+	std::shared_ptr<Entity> Raycast(glm::vec3 origin, glm::vec3 direction, float& distance);
 	void CleanUp();
+	bool IsDirty();
+	void ClearDirty();
+	std::vector<std::shared_ptr<Entity>> GetDirtyEntities();
 	std::vector<std::shared_ptr<Entity>> entities;
 	std::vector<std::shared_ptr<Entity>> expired;
 	std::vector<std::shared_ptr<Entity>> created;
+	// uuid string to entity, kept in step with entities so lookups are not a linear scan
+	std::unordered_map<std::string, std::shared_ptr<Entity>> lookup;
+	// entities removed since the last save
+	std::vector<Util::UUID> removed;
+	// world space bounds of every entity with a mesh renderer
+	BVH bvh;
+	// every transform by depth, invalidated whenever an entity is added, removed or reparented
+	TransformHierarchy transforms;
+	// bumped whenever any entity's bounds change or an entity goes away, starts at 1 so 0 means never seen
+	unsigned int boundsVersion = 1;
+	// bumped when a static entity moves, appears or goes away, the cached shadow layers are redrawn then
+	unsigned int staticVersion = 1;
+	// bumped when an entity is added or removed, GPUCulling rebuilds its instance slots then
+	unsigned int entityVersion = 1;
+	// entities whose bounds changed since GPUCulling last took them, capped at the entity count,
+	// past that movedOverflow is set and the taker rebuilds instead
+	std::vector<Entity*> movedEntities;
+	bool movedOverflow = false;
+	// cull and build draws on the GPU instead of walking the BVH and drawing each entity
+	bool gpuDriven = false;
+	GPUCulling gpuCulling;
+	OcclusionCulling occlusion;
+	ClusteredLighting lighting;
+	ShadowMaps shadows;
+	// the forward pass's draws, recorded across workers and replayed on the GL thread
+	RenderQueue queue;
+	// more than this fraction of entities moving in one frame rebuilds the BVH instead of patching it
+	static constexpr float RebuildFraction = 0.25f;
+	// half size of the box standing in for a mesh that is neither loaded nor in the asset index
+	static constexpr float ProxyExtent = 1.0f;
 
 	std::string name;
 	void RemoveEntityInternal(std::shared_ptr<Entity> entity);
 	void AddEntityInternal(std::shared_ptr<Entity> entity);
 private:
+	// the forward pass, culls and draws every entity into the bound target
+	void Draw(const glm::mat4& view, const glm::mat4& projection);
+	// every mesh of the entity's renderer is resident, checked without loading any
+	static bool MeshesLoaded(Entity* entity);
 };
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "SceneJournal.h"
+#include "Scene.h"
+#include "ResourceManager.h"
+#include <fstream>
+#include <filesystem>
+
+std::string SceneJournal::GetPath(std::string scenePath)
+{
+	size_t dot = scenePath.find_last_of('.');
+	if (dot == std::string::npos) return scenePath + ".journal";
+	return scenePath.substr(0, dot) + ".journal";
+}
+
+bool SceneJournal::Append(std::shared_ptr<Scene> scene, std::string path)
+{
+	BinaryWriter out;
+	std::error_code error;
+	if (!std::filesystem::exists(path, error))
+	{
+		out.Write<uint32_t>(Magic);
+		out.Write<uint32_t>(Version);
+	}
+
+	for (auto& uuid : scene->removed)
+	{
+		out.Write<uint8_t>((uint8_t)RecordType::Remove);
+		out.Write<uint32_t>(sizeof(boost::uuids::uuid));
+		out.Write(uuid.Get());
+	}
+	for (auto& entity : scene->GetDirtyEntities())
+	{
+		out.Write<uint8_t>((uint8_t)RecordType::Upsert);
+		size_t sizeOffset = out.Reserve<uint32_t>();
+		WriteEntity(out, entity);
+		out.Patch<uint32_t>(sizeOffset, (uint32_t)(out.Size() - sizeOffset - sizeof(uint32_t)));
+	}
+
+	std::ofstream fout(path, std::ios::binary | std::ios::app);
+	if (!fout.is_open())
+	{
+		std::cout << "Failed to open scene journal " << path << std::endl;
+		return false;
+	}
+	fout.write(out.buffer.data(), out.buffer.size());
+	fout.close();
+	return !fout.fail();
+}
+
+boost::uuids::uuid SceneJournal::ParseId(const std::string& id)
+{
+	// a handle with nothing behind it is written as the nil uuid, which never resolves
+	if (id.empty()) return boost::uuids::nil_uuid();
+	Util::UUID uuid;
+	uuid.Init(id);
+	return uuid.Get();
+}
+
+void SceneJournal::WriteEntity(BinaryWriter& out, std::shared_ptr<Entity> entity)
+{
+	TagComponent* tag = entity->GetComponent<TagComponent>();
+	TransformComponent* transform = entity->GetComponent<TransformComponent>();
+	MeshRendererComponent* meshRenderer = entity->GetComponent<MeshRendererComponent>();
+	LightComponent* light = entity->GetComponent<LightComponent>();
+
+	out.Write(entity->uuid.Get());
+	out.Write<uint8_t>((tag ? HasTag : 0) | (transform ? HasTransform : 0) | (meshRenderer ? HasMeshRenderer : 0) | (light ? HasLight : 0));
+	if (tag)
+	{
+		out.WriteString(tag->name);
+	}
+	if (transform)
+	{
+		out.Write(transform->translation);
+		out.Write(transform->rotation);
+		out.Write(transform->scale);
+		std::shared_ptr<Entity> parent = transform->parent.lock();
+		out.Write<uint8_t>(parent ? 1 : 0);
+		if (parent)
+		{
+			out.Write(parent->uuid.Get());
+		}
+		out.Write<uint32_t>((uint32_t)transform->children.size());
+		for (auto& child : transform->children)
+		{
+			out.Write(child->uuid.Get());
+		}
+	}
+	if (meshRenderer)
+	{
+		out.Write<uint32_t>((uint32_t)meshRenderer->meshes.size());
+		for (auto& mesh : meshRenderer->meshes)
+		{
+			out.Write(ParseId(mesh.GetId()));
+		}
+		out.Write<uint32_t>((uint32_t)meshRenderer->materials.size());
+		for (auto& material : meshRenderer->materials)
+		{
+			out.Write(ParseId(material.GetId()));
+		}
+		out.Write<uint8_t>(meshRenderer->isStatic ? 1 : 0);
+	}
+	if (light)
+	{
+		out.Write<uint8_t>((uint8_t)light->type);
+		out.Write(light->color);
+		out.Write(light->intensity);
+		out.Write(light->range);
+		out.Write(light->innerAngle);
+		out.Write(light->outerAngle);
+	}
+}
+
+bool SceneJournal::Replay(std::shared_ptr<Scene> scene, std::string path)
+{
+	std::ifstream fin(path, std::ios::binary | std::ios::ate);
+	if (!fin.is_open()) return false;
+	std::vector<char> file((size_t)fin.tellg());
+	fin.seekg(0);
+	fin.read(file.data(), file.size());
+	fin.close();
+
+	BinaryReader in(file.data(), file.size());
+	uint32_t version = 0;
+	if (in.Read<uint32_t>() != Magic || (version = in.Read<uint32_t>()) < 1 || version > Version)
+	{
+		std::cout << "Scene journal " << path << " is not supported, ignoring it" << std::endl;
+		return false;
+	}
+
+	// parent and child references can point at entities created by later records,
+	// they are resolved once every record has been applied
+	struct PendingLinks
+	{
+		TransformComponent* transform;
+		bool hasParent;
+		std::string parent;
+		std::vector<std::string> children;
+	};
+	std::vector<PendingLinks> pending;
+	auto readUUID = [](BinaryReader& reader)
+	{
+		Util::UUID uuid;
+		uuid.Init(reader.Read<boost::uuids::uuid>());
+		return uuid;
+	};
+
+	int records = 0;
+	while (in.Remaining() > 0)
+	{
+		RecordType type = (RecordType)in.Read<uint8_t>();
+		uint32_t size = in.Read<uint32_t>();
+		if (!in.ok || size > in.Remaining())
+		{
+			std::cout << "Scene journal " << path << " ends in a partial record, replayed " << records << " records" << std::endl;
+			break;
+		}
+		BinaryReader record(in.Current(), size);
+		in.Skip(size);
+		records++;
+
+		Util::UUID uuid = readUUID(record);
+		std::shared_ptr<Entity> entity = scene->GetEntity(uuid);
+		if (type == RecordType::Remove)
+		{
+			if (entity) scene->RemoveEntityInternal(entity);
+			continue;
+		}
+		if (type != RecordType::Upsert) continue;
+
+		if (entity)
+		{
+			for (auto& component : entity->GetComponents())
+			{
+				entity->RemoveComponent(component);
+			}
+		}
+		else
+		{
+			entity = std::make_shared<Entity>(uuid);
+			scene->AddEntityInternal(entity);
+		}
+
+		uint8_t flags = record.Read<uint8_t>();
+		if (flags & HasTag)
+		{
+			entity->AddComponent(std::make_shared<TagComponent>(record.ReadString()));
+		}
+		if (flags & HasTransform)
+		{
+			glm::vec3 translation = record.Read<glm::vec3>();
+			glm::vec3 rotation = record.Read<glm::vec3>();
+			glm::vec3 scale = record.Read<glm::vec3>();
+			std::shared_ptr<TransformComponent> transform = std::make_shared<TransformComponent>(translation, rotation, scale);
+			PendingLinks links = { transform.get(), record.Read<uint8_t>() != 0, std::string(), {} };
+			if (links.hasParent)
+			{
+				links.parent = readUUID(record);
+			}
+			uint32_t childCount = record.Read<uint32_t>();
+			for (uint32_t i = 0; i < childCount && record.ok; i++)
+			{
+				links.children.push_back(readUUID(record));
+			}
+			pending.push_back(links);
+			entity->AddComponent(transform);
+		}
+		if (flags & HasMeshRenderer)
+		{
+			std::shared_ptr<MeshRendererComponent> meshRenderer = std::make_shared<MeshRendererComponent>();
+			uint32_t meshCount = record.Read<uint32_t>();
+			for (uint32_t i = 0; i < meshCount && record.ok; i++)
+			{
+				meshRenderer->meshes.push_back(ResourceHandle<Mesh>(readUUID(record)));
+			}
+			uint32_t materialCount = record.Read<uint32_t>();
+			for (uint32_t i = 0; i < materialCount && record.ok; i++)
+			{
+				meshRenderer->materials.push_back(ResourceHandle<MaterialInstance>(readUUID(record)));
+			}
+			// version 1 records end the mesh renderer without the static flag
+			if (version >= 2) meshRenderer->isStatic = record.Read<uint8_t>() != 0;
+			entity->AddComponent(meshRenderer);
+		}
+		if (flags & HasLight)
+		{
+			std::shared_ptr<LightComponent> light = std::make_shared<LightComponent>();
+			light->type = (LightType)record.Read<uint8_t>();
+			light->color = record.Read<glm::vec3>();
+			light->intensity = record.Read<float>();
+			light->range = record.Read<float>();
+			light->innerAngle = record.Read<float>();
+			light->outerAngle = record.Read<float>();
+			entity->AddComponent(light);
+		}
+		if (!record.ok)
+		{
+			std::cout << "Scene journal " << path << " has a corrupt record for " << std::string(uuid) << std::endl;
+		}
+	}
+
+	for (auto& links : pending)
+	{
+		if (links.hasParent)
+		{
+			links.transform->parent = scene->GetEntity(links.parent);
+		}
+		for (auto& id : links.children)
+		{
+			std::shared_ptr<Entity> child = scene->GetEntity(id);
+			if (child) links.transform->children.push_back(child);
+		}
+	}
+	return true;
+}
+
+bool SceneJournal::NeedsCompaction(std::string path)
+{
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	if (error) return false;
+	if (size > CompactSize) return true;
+	// records can only be appended to a journal of this version, an older one is folded into a full save,
+	// the caller must not do that with one Replay refused
+	uint32_t header[2] = {};
+	std::ifstream fin(path, std::ios::binary);
+	fin.read((char*)header, sizeof(header));
+	return header[0] != Magic || header[1] != Version;
+}
+
+std::string SceneJournal::SetAside(std::string path)
+{
+	std::string base = path.substr(0, path.size() - std::string(".journal").size());
+	std::string kept = base + ".unreplayed.journal";
+	std::error_code error;
+	for (int i = 1; std::filesystem::exists(kept, error); i++)
+	{
+		kept = base + ".unreplayed" + std::to_string(i) + ".journal";
+	}
+	std::filesystem::rename(path, kept, error);
+	if (error)
+	{
+		std::cout << "Failed to set aside scene journal " << path << ": " << error.message() << std::endl;
+		return "";
+	}
+	std::cout << "Scene journal " << path << " could not be replayed, kept as " << kept << std::endl;
+	return kept;
+}
+
+void SceneJournal::Clear(std::string path)
+{
+	std::error_code error;
+	std::filesystem::remove(path, error);
+}
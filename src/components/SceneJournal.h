@@ -0,0 +1,57 @@
+#pragma once
+#include "BinaryStream.h"
+#include "UUID.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class Scene;
+class Entity;
+
+/*
+	Append-only log of entity changes that sits next to a scene file. Saving
+	appends one record per dirty or removed entity instead of rewriting the scene,
+	loading replays the records on top of the scene. Once the journal grows past
+	CompactSize the scene is written out in full and the journal is deleted.
+
+	.journal layout
+	  header   magic, version
+	  records  type (uint8), payload size (uint32), payload
+	A record cut short by a crash ends the replay, everything before it is kept.
+	Version 1 records are the same without the mesh renderer's static flag.
+*/
+class SceneJournal
+{
+public:
+	enum class RecordType : uint8_t
+	{
+		Upsert = 1,
+		Remove = 2,
+	};
+
+	enum ComponentFlags : uint8_t
+	{
+		HasTag = 1 << 0,
+		HasTransform = 1 << 1,
+		HasMeshRenderer = 1 << 2,
+		HasLight = 1 << 3,
+	};
+
+	static const uint32_t Magic = 0x4E4A4353; // "SCJN"
+	static const uint32_t Version = 2;
+	static const size_t CompactSize = 16 << 20;
+
+	static std::string GetPath(std::string scenePath);
+	static bool Append(std::shared_ptr<Scene> scene, std::string path);
+	// false when there is no journal or its header is not one this build reads
+	static bool Replay(std::shared_ptr<Scene> scene, std::string path);
+	static bool NeedsCompaction(std::string path);
+	static void Clear(std::string path);
+	// renames a journal Replay refused next to it, so it is never folded into a save or cleared and
+	// the scene starts a fresh one, returns the new path or an empty string if it could not be moved
+	static std::string SetAside(std::string path);
+private:
+	static void WriteEntity(BinaryWriter& out, std::shared_ptr<Entity> entity);
+	// resource handles are written by id, locking them would load every resource on each save
+	static boost::uuids::uuid ParseId(const std::string& id);
+};
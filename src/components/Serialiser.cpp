@@ -2,8 +2,11 @@
 #include "Scene.h"
 #include "Shader.h"
 #include <fstream>
+#include <filesystem>
 #include "ResourceManager.h"
 #include "Resource.h"
+#include "YAMLUtil.h"
+#include "MeshSimplifier.h"
 
 
 namespace YAML {
@@ -17,13 +20,7 @@ namespace YAML {
         }
 
         static bool decode(const Node& node, glm::vec2& rhs) {
-            if (!node.IsSequence() || node.size() != 2) {
-                return false;
-            }
-
-            rhs.x = node[0].as<float>();
-            rhs.y = node[1].as<float>();
-            return true;
+            return YAMLUtil::ParseFlow(node, &rhs.x, 2);
         }
     };
 
@@ -38,14 +35,7 @@ namespace YAML {
         }
 
         static bool decode(const Node& node, glm::vec3& rhs) {
-            if (!node.IsSequence() || node.size() != 3) {
-                return false;
-            }
-
-            rhs.x = node[0].as<float>();
-            rhs.y = node[1].as<float>();
-            rhs.z = node[2].as<float>();
-            return true;
+            return YAMLUtil::ParseFlow(node, &rhs.x, 3);
         }
     };
 
@@ -61,14 +51,7 @@ namespace YAML {
         }
 
         static bool decode(const Node& node, glm::vec4& rhs) {
-            if (!node.IsSequence() || node.size() != 4) {
-                return false;
-            }
-            rhs.x = node[0].as<float>();
-            rhs.y = node[1].as<float>();
-            rhs.z = node[2].as<float>();
-            rhs.w = node[3].as<float>();
-            return true;
+            return YAMLUtil::ParseFlow(node, &rhs.x, 4);
         }
     };
 
@@ -91,7 +74,7 @@ namespace YAML {
 
             for (int i = 0; i < 4; i++) {
                 for (int j = 0; j < 4; j++) {
-                    rhs[i][j] = node[i * 4 + j].as<float>();
+                    rhs[i][j] = YAMLUtil::ParseFloat(node[i * 4 + j]);
                 }
             }
             return true;
@@ -99,32 +82,22 @@ namespace YAML {
     };
 
     YAML::Emitter& operator<<(YAML::Emitter& out, const glm::vec2& v) {
-        out << YAML::Flow;
-        out << YAML::BeginSeq << v.x << v.y << YAML::EndSeq;
+        YAMLUtil::EmitFlow(out, &v.x, 2);
         return out;
     }
 
     YAML::Emitter& operator<<(YAML::Emitter& out, const glm::vec3& v) {
-        out << YAML::Flow;
-        out << YAML::BeginSeq << v.x << v.y << v.z << YAML::EndSeq;
+        YAMLUtil::EmitFlow(out, &v.x, 3);
         return out;
     }
 
     YAML::Emitter& operator<<(YAML::Emitter& out, const glm::vec4& v) {
-        out << YAML::Flow;
-        out << YAML::BeginSeq << v.x << v.y << v.z << v.w << YAML::EndSeq;
+        YAMLUtil::EmitFlow(out, &v.x, 4);
         return out;
     }
 
     YAML::Emitter& operator<<(YAML::Emitter& out, const glm::mat4& m) {
-        out << YAML::Flow;
-        out << YAML::BeginSeq;
-        for (int i = 0; i < m.length(); i++) {
-            for (int j = 0; j < m[i].length(); j++) {
-                out << m[i][j];
-            }
-        }
-        out << YAML::EndSeq;
+        YAMLUtil::EmitFlow(out, &m[0][0], 16);
         return out;
     }
 }
@@ -136,73 +109,189 @@ SceneSerialiser::SceneSerialiser(std::shared_ptr<Scene> scene) : scene(scene)
 
 bool SceneSerialiser::Serialise(std::string folder)
 {
-    YAML::Emitter out;
-    out << YAML::BeginMap;
-    out << YAML::Key << "Scene" << YAML::Value << scene.lock()->name;
-    out << YAML::Key << "Entities" << YAML::Value;
-    
-    out << YAML::BeginSeq;
-    for (auto entity : scene.lock()->entities)
+    std::shared_ptr<Scene> scene = this->scene.lock();
+    if (!scene) return false;
+    return Write(TakeSnapshot(scene), folder + scene->name + ".scene");
+}
+
+std::future<bool> SceneSerialiser::SerialiseAsync(std::string folder)
+{
+    std::shared_ptr<Scene> scene = this->scene.lock();
+    if (!scene)
+    {
+        std::promise<bool> failed;
+        failed.set_value(false);
+        return failed.get_future();
+    }
+    // only the snapshot is taken here, formatting and file io happen on the worker
+    std::string path = folder + scene->name + ".scene";
+    return std::async(std::launch::async, [snapshot = TakeSnapshot(scene), path]()
+        {
+            return Write(snapshot, path);
+        }
+    );
+}
+
+SceneSnapshot SceneSerialiser::TakeSnapshot(std::shared_ptr<Scene> scene)
+{
+    SceneSnapshot snapshot;
+    snapshot.name = scene->name;
+    snapshot.entities.reserve(scene->entities.size());
+    for (auto& entity : scene->entities)
     {
         if (!entity) continue;
-        SerialiseEntity(out, entity);
+        EntitySnapshot e;
+        e.uuid = entity->uuid;
+
+        TagComponent* tag = entity->GetComponent<TagComponent>();
+        if (tag)
+        {
+            e.hasTag = true;
+            e.name = tag->name;
+        }
+
+        TransformComponent* transform = entity->GetComponent<TransformComponent>();
+        if (transform)
+        {
+            e.hasTransform = true;
+            e.translation = transform->translation;
+            e.rotation = transform->rotation;
+            e.scale = transform->scale;
+            std::shared_ptr<Entity> parent = transform->parent.lock();
+            if (parent)
+            {
+                e.hasParent = true;
+                e.parent = parent->uuid;
+            }
+            for (auto& child : transform->children)
+            {
+                e.children.push_back(child->uuid);
+            }
+        }
+
+        MeshRendererComponent* meshRenderer = entity->GetComponent<MeshRendererComponent>();
+        if (meshRenderer)
+        {
+            e.hasMeshRenderer = true;
+            for (auto& mesh : meshRenderer->meshes)
+            {
+                e.meshes.push_back(mesh.GetId());
+            }
+            for (auto& material : meshRenderer->materials)
+            {
+                e.materials.push_back(material.GetId());
+            }
+            e.isStatic = meshRenderer->isStatic;
+        }
+
+        LightComponent* light = entity->GetComponent<LightComponent>();
+        if (light)
+        {
+            e.hasLight = true;
+            e.lightType = (int)light->type;
+            e.lightColor = light->color;
+            e.lightIntensity = light->intensity;
+            e.lightRange = light->range;
+            e.lightInnerAngle = light->innerAngle;
+            e.lightOuterAngle = light->outerAngle;
+        }
+        snapshot.entities.push_back(std::move(e));
     }
-    out << YAML::EndSeq;
-    out << YAML::EndMap;
+    return snapshot;
+}
 
-    std::string path = folder + scene.lock()->name + ".scene";
-    std::ofstream fout(path);
-    fout << out.c_str();
+bool SceneSerialiser::Write(const SceneSnapshot& snapshot, std::string path)
+{
+    // the emitter streams into a large file buffer instead of building the whole document in memory,
+    // the real file is only replaced once the temp file is complete
+    std::string tempPath = path + ".tmp";
+    std::vector<char> buffer(WriteBufferSize);
+    std::ofstream fout;
+    fout.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    fout.open(tempPath, std::ios::binary | std::ios::trunc);
+    if (!fout.is_open())
+    {
+        std::cout << "Failed to write scene " << tempPath << std::endl;
+        return false;
+    }
+
+    {
+        YAML::Emitter out(fout);
+        out << YAML::BeginMap;
+        out << YAML::Key << "Scene" << YAML::Value << snapshot.name;
+        out << YAML::Key << "Entities" << YAML::Value;
+
+        out << YAML::BeginSeq;
+        for (auto& entity : snapshot.entities)
+        {
+            SerialiseEntity(out, entity);
+        }
+        out << YAML::EndSeq;
+        out << YAML::EndMap;
+    }
     fout.close();
+
+    std::error_code error;
+    if (fout.fail())
+    {
+        std::cout << "Failed to write scene " << tempPath << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+    {
+        std::cout << "Failed to replace scene " << path << ": " << error.message() << std::endl;
+        return false;
+    }
     return true;
 }
 
-bool SceneSerialiser::SerialiseEntity(YAML::Emitter& out, std::shared_ptr<Entity> entity)
+bool SceneSerialiser::SerialiseEntity(YAML::Emitter& out, const EntitySnapshot& entity)
 {
     out << YAML::BeginMap;
-    out << YAML::Key << "Entity" << YAML::Value << entity->uuid;
+    out << YAML::Key << "Entity" << YAML::Value << std::string(entity.uuid);
     SerialiseTag(out, entity);
     SerialiseTransform(out, entity);
     SerialiseMeshRenderer(out, entity);
+    SerialiseLight(out, entity);
     out << YAML::EndMap;
     return true;
 }
 
-bool SceneSerialiser::SerialiseTag(YAML::Emitter& out, std::shared_ptr<Entity> entity)
+bool SceneSerialiser::SerialiseTag(YAML::Emitter& out, const EntitySnapshot& entity)
 {
-    TagComponent* tag = entity->GetComponent<TagComponent>();
-    if (tag)
+    if (entity.hasTag)
     {
         out << YAML::Key << "Tag" << YAML::Value;
         out << YAML::BeginMap;
-        out << YAML::Key << "Name" << YAML::Value << tag->name;
+        out << YAML::Key << "Name" << YAML::Value << entity.name;
         out << YAML::EndMap;
         return true;
     }
     return false;
 }
 
-bool SceneSerialiser::SerialiseTransform(YAML::Emitter& out, std::shared_ptr<Entity> entity)
+bool SceneSerialiser::SerialiseTransform(YAML::Emitter& out, const EntitySnapshot& entity)
 {
-    TransformComponent* transform = entity->GetComponent<TransformComponent>();
-    if (transform)
+    if (entity.hasTransform)
     {
         out << YAML::Key << "Transform" << YAML::Value;
         out << YAML::BeginMap;
-        out << YAML::Key << "Translation" << YAML::Value << transform->translation;
-        out << YAML::Key << "Rotation" << YAML::Value << transform->rotation;
-        out << YAML::Key << "Scale" << YAML::Value << transform->scale;
-        if (!transform->parent.expired())
+        out << YAML::Key << "Translation" << YAML::Value << entity.translation;
+        out << YAML::Key << "Rotation" << YAML::Value << entity.rotation;
+        out << YAML::Key << "Scale" << YAML::Value << entity.scale;
+        if (entity.hasParent)
         {
-            out << YAML::Key << "Parent" << YAML::Value << transform->parent.lock()->uuid;
+            out << YAML::Key << "Parent" << YAML::Value << std::string(entity.parent);
         }
 
         out << YAML::Key << "Children" << YAML::Value;
         out << YAML::Flow;
         out << YAML::BeginSeq;
-        for (int i = 0; i < transform->children.size(); i++)
+        for (auto& child : entity.children)
         {
-            out << transform->children[i]->uuid;
+            out << std::string(child);
         }
         out << YAML::EndSeq;
         out << YAML::EndMap;
@@ -211,10 +300,9 @@ bool SceneSerialiser::SerialiseTransform(YAML::Emitter& out, std::shared_ptr<Ent
     return false;
 }
 
-bool SceneSerialiser::SerialiseMeshRenderer(YAML::Emitter& out, std::shared_ptr<Entity> entity)
+bool SceneSerialiser::SerialiseMeshRenderer(YAML::Emitter& out, const EntitySnapshot& entity)
 {
-    MeshRendererComponent* meshRenderer = entity->GetComponent<MeshRendererComponent>();
-    if (meshRenderer)
+    if (entity.hasMeshRenderer)
     {
         out << YAML::Key << "MeshRenderer" << YAML::Value;
         out << YAML::BeginMap;
@@ -222,22 +310,45 @@ bool SceneSerialiser::SerialiseMeshRenderer(YAML::Emitter& out, std::shared_ptr<
         out << YAML::Key << "Meshes" << YAML::Value;
         out << YAML::Flow;
         out << YAML::BeginSeq;
-        for (int i = 0; i < meshRenderer->meshes.size(); i++)
+        for (auto& mesh : entity.meshes)
         {
-            out << meshRenderer->meshes[i].lock()->uuid;
+            out << mesh;
         }
         out << YAML::EndSeq;
 
         out << YAML::Key << "Materials" << YAML::Value;
         out << YAML::BeginSeq;
-        OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
-        ResourceManager& resources = ResourceManager::GetSingleton();
-        for (int i = 0; i < meshRenderer->materials.size(); i++)
+        for (auto& material : entity.materials)
         {
-            out << meshRenderer->materials[i].lock()->uuid;
+            out << material;
         }
         out << YAML::EndSeq;
 
+        if (entity.isStatic)
+        {
+            out << YAML::Key << "Static" << YAML::Value << true;
+        }
+
+        out << YAML::EndMap;
+        return true;
+    }
+    return false;
+}
+
+static const char* LightTypeNames[] = { "Point", "Spot", "Directional" };
+
+bool SceneSerialiser::SerialiseLight(YAML::Emitter& out, const EntitySnapshot& entity)
+{
+    if (entity.hasLight)
+    {
+        out << YAML::Key << "Light" << YAML::Value;
+        out << YAML::BeginMap;
+        out << YAML::Key << "Type" << YAML::Value << LightTypeNames[entity.lightType];
+        out << YAML::Key << "Color" << YAML::Value << entity.lightColor;
+        out << YAML::Key << "Intensity" << YAML::Value << entity.lightIntensity;
+        out << YAML::Key << "Range" << YAML::Value << entity.lightRange;
+        out << YAML::Key << "InnerAngle" << YAML::Value << entity.lightInnerAngle;
+        out << YAML::Key << "OuterAngle" << YAML::Value << entity.lightOuterAngle;
         out << YAML::EndMap;
         return true;
     }
@@ -246,7 +357,7 @@ bool SceneSerialiser::SerialiseMeshRenderer(YAML::Emitter& out, std::shared_ptr<
 
 std::shared_ptr<Scene> SceneSerialiser::Deserialise(std::string path)
 {
-    YAML::Node file = YAML::LoadFile(path);
+    YAML::Node file = YAMLUtil::LoadFile(path);
     YAML::Node sceneNode = file["Scene"];
     YAML::Node entitiesNode = file["Entities"];
 
@@ -283,6 +394,8 @@ void SceneSerialiser::DeserialiseComponents(YAML::Node& node, std::shared_ptr<Sc
     if (tranform) entity->AddComponent(tranform);
     std::shared_ptr<MeshRendererComponent> meshRenderer = DeserialiseMeshRenderer(node["MeshRenderer"]);
     if (meshRenderer) entity->AddComponent(meshRenderer);
+    std::shared_ptr<LightComponent> light = DeserialiseLight(node["Light"]);
+    if (light) entity->AddComponent(light);
 }
 
 std::shared_ptr<TagComponent> SceneSerialiser::DeserialiseTag(YAML::Node& node)
@@ -325,23 +438,41 @@ std::shared_ptr<MeshRendererComponent> SceneSerialiser::DeserialiseMeshRenderer(
 {
     if (!node.IsDefined()) return nullptr;
     //OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
-    ResourceManager& resources = ResourceManager::GetSingleton();
     std::vector<std::string> meshIds = node["Meshes"].as<std::vector<std::string>>();
     std::vector<std::string> materials = node["Materials"].as<std::vector<std::string>>();
     std::shared_ptr<MeshRendererComponent> meshRenderer = std::make_shared<MeshRendererComponent>();
-    // getmesh
+    // resources load when the mesh renderer is first drawn
     for (int i = 0; i < meshIds.size(); i++)
     {
-        meshRenderer->meshes.push_back(resources.GetMesh(meshIds[i]));
+        meshRenderer->meshes.push_back(ResourceHandle<Mesh>(meshIds[i]));
     }
     //meshRenderer->geometryIndices = geometries;
     for (int i = 0; i < materials.size(); i++)
     {
-        meshRenderer->materials.push_back(resources.GetMaterialInstance(materials[i]));
+        meshRenderer->materials.push_back(ResourceHandle<MaterialInstance>(materials[i]));
     }
+    // scenes written before static casters existed have no key, everything in them moves
+    meshRenderer->isStatic = node["Static"] && node["Static"].as<bool>();
     return meshRenderer;
 }
 
+std::shared_ptr<LightComponent> SceneSerialiser::DeserialiseLight(YAML::Node& node)
+{
+    if (!node.IsDefined()) return nullptr;
+    std::shared_ptr<LightComponent> light = std::make_shared<LightComponent>();
+    std::string type = node["Type"].as<std::string>();
+    for (int i = 0; i < 3; i++)
+    {
+        if (type == LightTypeNames[i]) light->type = (LightType)i;
+    }
+    light->color = node["Color"].as<glm::vec3>();
+    light->intensity = node["Intensity"].as<float>();
+    light->range = node["Range"].as<float>();
+    light->innerAngle = node["InnerAngle"].as<float>();
+    light->outerAngle = node["OuterAngle"].as<float>();
+    return light;
+}
+
 MaterialSerialiser::MaterialSerialiser(std::shared_ptr<Material> material)
 {
     this->material = material;
@@ -387,7 +518,7 @@ bool MaterialSerialiser::SerialiseAttribute(YAML::Emitter& out, MaterialAttribut
     case MaterialAttributeType::Float:
     {
         out << YAML::Key << "Type" << YAML::Value << "Float";
-        out << YAML::Key << "Value" << YAML::Value << attribute.floatValue;
+        out << YAML::Key << "Value" << YAML::Value << YAMLUtil::FormatFloat(attribute.floatValue);
         break;
     }
     case MaterialAttributeType::Int:
@@ -441,7 +572,7 @@ bool MaterialSerialiser::SerialiseAttribute(YAML::Emitter& out, MaterialAttribut
 
 void MaterialSerialiser::Deserialise(std::string path)
 {
-    YAML::Node file = YAML::LoadFile(path);
+    YAML::Node file = YAMLUtil::LoadFile(path);
     YAML::Node materialNode = file["Material"];
     YAML::Node uuidNode = file["UUID"];
     YAML::Node shaderNode = file["Shader"];
@@ -487,7 +618,7 @@ MaterialAttribute MaterialSerialiser::DeserialiseAttribute(YAML::Node& node)
     }
     case MaterialAttributeType::Float:
     {
-        float floatValue = valueNode.as<float>();
+        float floatValue = YAMLUtil::ParseFloat(valueNode);
         return MaterialAttribute(attributeName, floatValue);
     }
     case MaterialAttributeType::Int:
@@ -576,7 +707,7 @@ bool MaterialInstanceSerialiser::SerialiseAttribute(YAML::Emitter& out, Material
     }
     case MaterialAttributeType::Float:
     {
-        out << YAML::Key << "Value" << YAML::Value << attribute.floatValue;
+        out << YAML::Key << "Value" << YAML::Value << YAMLUtil::FormatFloat(attribute.floatValue);
         break;
     }
     case MaterialAttributeType::Bool:
@@ -618,7 +749,7 @@ void MaterialInstanceSerialiser::Deserialise(std::string path)
     //OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
     ResourceManager& resources = ResourceManager::GetSingleton();
 
-    YAML::Node file = YAML::LoadFile(path);
+    YAML::Node file = YAMLUtil::LoadFile(path);
     YAML::Node materialInstanceNode = file["Material Instance"];
     YAML::Node materialNode = file["Material"];
     YAML::Node uuidNode = file["UUID"];
@@ -668,7 +799,7 @@ MaterialAttribute MaterialInstanceSerialiser::DeserialiseAttribute(YAML::Node& n
     }
     case MaterialAttributeType::Float:
     {
-        float floatValue = valueNode.as<float>();
+        float floatValue = YAMLUtil::ParseFloat(valueNode);
         return MaterialAttribute(attributeName, floatValue);
     }
     case MaterialAttributeType::Int:
@@ -743,7 +874,7 @@ void TextureSerialiser::Deserialise(std::string path)
     //OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
     ResourceManager& resources = ResourceManager::GetSingleton();
 
-    YAML::Node file = YAML::LoadFile(path);
+    YAML::Node file = YAMLUtil::LoadFile(path);
     YAML::Node textureNode = file["Texture"];
     YAML::Node uuidNode = file["UUID"];
     YAML::Node filepathNode = file["Filepath"];
@@ -791,7 +922,7 @@ bool ShaderSerialiser::SerialiseShaderData(YAML::Emitter& out, GLuint type, Shad
 
 void ShaderSerialiser::Deserialise(std::string path)
 {
-    YAML::Node file = YAML::LoadFile(path);
+    YAML::Node file = YAMLUtil::LoadFile(path);
     YAML::Node shaderNode = file["Shader"];
     YAML::Node uuidNode = file["UUID"];
     YAML::Node dataNodes = file["Data"];
@@ -826,85 +957,185 @@ MeshSerialiser::MeshSerialiser(std::shared_ptr<Mesh> mesh)
 
 bool MeshSerialiser::Serialise(std::string folder)
 {
-    YAML::Emitter out;
-    out << YAML::BeginMap;
-    out << YAML::Key << "Mesh" << YAML::Value << mesh.lock()->name;
-    out << YAML::Key << "UUID" << YAML::Value << mesh.lock()->uuid;
-    out << YAML::Key << "Vertices" << YAML::Value;
+    std::shared_ptr<Mesh> mesh = this->mesh.lock();
+    std::string out = Format(mesh->name, mesh->uuid, mesh->bounds, *mesh->data);
 
-    out << YAML::BeginSeq;
-    std::vector<Vertex>& vertices = mesh.lock()->data->vertices;
-    for (int i = 0; i < vertices.size(); i++)
+    std::string path = folder + mesh->name + ".mesh";
+    std::ofstream fout(path, std::ios::binary);
+    fout.write(out.data(), out.size());
+    fout.close();
+    return true;
+}
+
+std::string MeshSerialiser::Format(const std::string& name, const std::string& uuid, const AABB& bounds, MeshData& data)
+{
+    // only the header goes through the emitter, the vertex and index lists are
+    // formatted straight into the output as flow sequences
+    YAML::Emitter header;
+    header << YAML::BeginMap;
+    header << YAML::Key << "Mesh" << YAML::Value << name;
+    header << YAML::Key << "UUID" << YAML::Value << uuid;
+    header << YAML::EndMap;
+
+    std::string out = header.c_str();
+    // read by the asset database, so entities can be bounded before the vertices are loaded
+    if (bounds.IsValid())
+    {
+        float values[6] = { bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z };
+        out += "\nBounds: ";
+        YAMLUtil::AppendFlow(out, values, 6);
+    }
+    out += "\nVertices:\n";
+    std::vector<Vertex>& vertices = data.vertices;
+    out.reserve(out.size() + vertices.size() * 200);
+    for (size_t i = 0; i < vertices.size(); i++)
     {
         SerialiseVertex(out, vertices[i]);
     }
-    out << YAML::EndSeq;
 
-    std::vector<unsigned short>& indices = mesh.lock()->data->indices;
-    out << YAML::Key << "Indices" << YAML::Value;
-    out << YAML::Flow;
-    out << indices;
-    out << YAML::EndMap;
-    std::string path = folder + mesh.lock()->name + ".mesh";
-    std::ofstream fout(path);
-    fout << out.c_str();
-    fout.close();
-    return true;
+    std::vector<unsigned short>& indices = data.indices;
+    out += "Indices: [";
+    char buffer[8];
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (i > 0) out += ", ";
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), indices[i]).ptr - buffer);
+    }
+    out += "]\n";
+
+    // simplified index lists, one flow sequence per level of detail
+    std::vector<std::vector<unsigned short>>& lods = data.lods;
+    out += "LODs:\n";
+    for (auto& lod : lods)
+    {
+        out += "  - [";
+        for (size_t i = 0; i < lod.size(); i++)
+        {
+            if (i > 0) out += ", ";
+            out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), lod[i]).ptr - buffer);
+        }
+        out += "]\n";
+    }
+    if (lods.empty()) out.replace(out.size() - 1, 1, " []\n");
+    return out;
 }
 
-bool MeshSerialiser::SerialiseVertex(YAML::Emitter& out, Vertex& vertex)
+bool MeshSerialiser::SerialiseVertex(std::string& out, Vertex& vertex)
 {
-    out << YAML::Flow;
-    out << YAML::BeginSeq;
-    out << vertex.position;
-    out << vertex.normal;
-    out << vertex.vertTangent;
-    out << vertex.vertBitangent;
-    out << vertex.color;
-    out << vertex.uv;
-    out << YAML::EndSeq;
+    out += "  - [";
+    YAMLUtil::AppendFlow(out, &vertex.position.x, 3);
+    out += ", ";
+    YAMLUtil::AppendFlow(out, &vertex.normal.x, 3);
+    out += ", ";
+    YAMLUtil::AppendFlow(out, &vertex.vertTangent.x, 3);
+    out += ", ";
+    YAMLUtil::AppendFlow(out, &vertex.vertBitangent.x, 3);
+    out += ", ";
+    YAMLUtil::AppendFlow(out, &vertex.color.x, 4);
+    out += ", ";
+    YAMLUtil::AppendFlow(out, &vertex.uv.x, 2);
+    out += "]\n";
     return true;
 }
 
-void MeshSerialiser::Deserialise(std::string path)
+std::shared_ptr<MeshData> MeshSerialiser::Parse(const YAML::Node& file, const std::string& path)
 {
-    YAML::Node file = YAML::LoadFile(path);
-    YAML::Node meshNode = file["Mesh"];
-    YAML::Node uuidNode = file["UUID"];
     YAML::Node vertexNodes = file["Vertices"];
     YAML::Node indexNodes = file["Indices"];
 
-    std::string meshName = meshNode.as<std::string>();
-    std::string uuid = uuidNode.as<std::string>();
-
     std::shared_ptr<MeshData> meshData = std::make_shared<MeshData>();
 
-    for (int i = 0; i < vertexNodes.size(); i++)
+    meshData->vertices.resize(vertexNodes.size());
+    for (size_t i = 0; i < vertexNodes.size(); i++)
     {
-         meshData->vertices.push_back(DeserialiseVertex(vertexNodes[i]));
+        // a short or malformed vertex would upload whatever the memory held, the mesh is not loaded at all
+        if (!DeserialiseVertex(vertexNodes[i], meshData->vertices[i]))
+        {
+            std::cout << "Mesh " << path << " has a malformed vertex " << i << std::endl;
+            return nullptr;
+        }
     }
 
     meshData->indices = indexNodes.as<std::vector<unsigned short>>();
-    //OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
-    ResourceManager& resources = ResourceManager::GetSingleton();
+    // meshes written before levels of detail existed have none until AddLods has rewritten them
+    YAML::Node lodNodes = file["LODs"];
+    if (lodNodes.IsSequence())
+    {
+        for (size_t i = 0; i < lodNodes.size(); i++)
+        {
+            meshData->lods.push_back(lodNodes[i].as<std::vector<unsigned short>>());
+        }
+    }
+    return meshData;
+}
 
-    
+void MeshSerialiser::Deserialise(std::string path)
+{
+    YAML::Node file = YAMLUtil::LoadFile(path);
+    std::string meshName = file["Mesh"].as<std::string>();
+    std::string uuid = file["UUID"].as<std::string>();
+
+    std::shared_ptr<MeshData> meshData = Parse(file, path);
+    if (!meshData) return;
+    ResourceManager& resources = ResourceManager::GetSingleton();
     resources.LoadMeshWithId(meshName, meshData, uuid);
+}
 
+bool MeshSerialiser::AddLods(std::string path)
+{
+    YAML::Node file;
+    try
+    {
+        file = YAML::LoadFile(path);
+    }
+    catch (YAML::Exception& e)
+    {
+        std::cout << "Failed to parse mesh " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    if (file["LODs"].IsSequence()) return true;
+    std::shared_ptr<MeshData> meshData = Parse(file, path);
+    if (!meshData) return false;
+
+    MeshSimplifier::GenerateLods(*meshData);
+    AABB bounds;
+    for (auto& vertex : meshData->vertices)
+    {
+        bounds.Grow(vertex.position);
+    }
+    std::string out = Format(file["Mesh"].as<std::string>(), file["UUID"].as<std::string>(), bounds, *meshData);
+
+    // same temp file and rename as the scene writers, a crash mid write leaves the old file intact
+    std::string tempPath = path + ".tmp";
+    std::ofstream fout(tempPath, std::ios::binary | std::ios::trunc);
+    fout.write(out.data(), out.size());
+    fout.close();
+    std::error_code error;
+    if (fout.fail())
+    {
+        std::cout << "Failed to write mesh " << tempPath << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+    {
+        std::cout << "Failed to replace mesh " << path << ": " << error.message() << std::endl;
+        return false;
+    }
+    std::cout << "Added levels of detail to " << path << std::endl;
+    return true;
 }
 
-Vertex&& MeshSerialiser::DeserialiseVertex(YAML::Node& node)
+bool MeshSerialiser::DeserialiseVertex(const YAML::Node& node, Vertex& vertex)
 {
-    return Vertex(
-        {
-            node[0].as<glm::vec3>(),
-            node[1].as<glm::vec3>(),
-            node[2].as<glm::vec3>(),
-            node[3].as<glm::vec3>(),
-            node[4].as<glm::vec4>(),
-            node[5].as<glm::vec2>()
-        }
-    );
+    if (!node.IsSequence() || node.size() != 6) return false;
+    return YAMLUtil::ParseFlow(node[0], &vertex.position.x, 3)
+        && YAMLUtil::ParseFlow(node[1], &vertex.normal.x, 3)
+        && YAMLUtil::ParseFlow(node[2], &vertex.vertTangent.x, 3)
+        && YAMLUtil::ParseFlow(node[3], &vertex.vertBitangent.x, 3)
+        && YAMLUtil::ParseFlow(node[4], &vertex.color.x, 4)
+        && YAMLUtil::ParseFlow(node[5], &vertex.uv.x, 2);
 }
 
 ModelSerialiser::ModelSerialiser(std::shared_ptr<Model> model)
@@ -956,7 +1187,7 @@ void ModelSerialiser::Deserialise(std::string path)
     //OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
     ResourceManager& resources = ResourceManager::GetSingleton();
 
-    YAML::Node file = YAML::LoadFile(path);
+    YAML::Node file = YAMLUtil::LoadFile(path);
     std::shared_ptr<Model> model = DeserialiseModel(file);
     resources.models.push_back(model);
     //resources.modelMap[model->uuid] = renderer.models.size() - 1;
@@ -975,15 +1206,11 @@ std::shared_ptr<Model> ModelSerialiser::DeserialiseModel(YAML::Node& node)
     std::string modelName = modelNode.as<std::string>();
     std::string uuid = uuidNode.as<std::string>();
 
-    //renderer.LoadModelWithId()
-    std::shared_ptr<ModelData> modelData = std::make_shared<ModelData>();
-
+    std::shared_ptr<Model> model = resources.LoadModelWithId(modelName, uuid);
     for (int i = 0; i < meshNodes.size(); i++)
     {
-        modelData->meshes.push_back(resources.GetMesh(meshNodes[i].as<std::string>())->data);
+        model->meshes.push_back(resources.GetMesh(meshNodes[i].as<std::string>()));
     }
-
-    std::shared_ptr<Model> model = resources.LoadModelWithId(modelName, modelData, uuid);
     for (int i = 0; i < childrenNodes.size(); i++)
     {
         model->children.push_back(DeserialiseModel(childrenNodes[i]));
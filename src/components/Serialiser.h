@@ -2,23 +2,66 @@
 #include "OpenGLRenderer.h"
 #include "yaml-cpp/yaml.h"
 #include "Util.h"
+#include "UUID.h"
+#include <future>
 
 class Scene;
 class Entity;
 class TagComponent;
 class TransformComponent;
 class MeshRendererComponent;
+class LightComponent;
 class Shader;
 
+// Plain copy of the scene taken on the main thread, it can be written out on
+// another thread while the editor keeps changing the live scene.
+struct EntitySnapshot
+{
+	Util::UUID uuid;
+	bool hasTag = false;
+	std::string name;
+	bool hasTransform = false;
+	glm::vec3 translation;
+	glm::vec3 rotation;
+	glm::vec3 scale;
+	bool hasParent = false;
+	Util::UUID parent;
+	std::vector<Util::UUID> children;
+	bool hasMeshRenderer = false;
+	// handle ids, taken without locking so a save never loads a resource
+	std::vector<std::string> meshes;
+	std::vector<std::string> materials;
+	bool isStatic = false;
+	bool hasLight = false;
+	int lightType = 0;
+	glm::vec3 lightColor;
+	float lightIntensity = 0;
+	float lightRange = 0;
+	float lightInnerAngle = 0;
+	float lightOuterAngle = 0;
+};
+
+struct SceneSnapshot
+{
+	std::string name;
+	std::vector<EntitySnapshot> entities;
+};
+
 class SceneSerialiser
 {
 public:
+	static const size_t WriteBufferSize = 1 << 20;
+
 	SceneSerialiser(std::shared_ptr<Scene> scene);
 	bool Serialise(std::string folder);
-	bool SerialiseEntity(YAML::Emitter& out, std::shared_ptr<Entity> entity);
-	bool SerialiseTag(YAML::Emitter& out, std::shared_ptr<Entity> entity);
-	bool SerialiseTransform(YAML::Emitter& out, std::shared_ptr<Entity> entity);
-	bool SerialiseMeshRenderer(YAML::Emitter& out, std::shared_ptr<Entity> entity);
+	std::future<bool> SerialiseAsync(std::string folder);
+	static SceneSnapshot TakeSnapshot(std::shared_ptr<Scene> scene);
+	static bool Write(const SceneSnapshot& snapshot, std::string path);
+	static bool SerialiseEntity(YAML::Emitter& out, const EntitySnapshot& entity);
+	static bool SerialiseTag(YAML::Emitter& out, const EntitySnapshot& entity);
+	static bool SerialiseTransform(YAML::Emitter& out, const EntitySnapshot& entity);
+	static bool SerialiseMeshRenderer(YAML::Emitter& out, const EntitySnapshot& entity);
+	static bool SerialiseLight(YAML::Emitter& out, const EntitySnapshot& entity);
 	
 	static std::shared_ptr<Scene> Deserialise(std::string path);
 	static std::shared_ptr<Entity> DeserialiseEntity(YAML::Node& node);
@@ -26,6 +69,7 @@ public:
 	static std::shared_ptr<TagComponent> DeserialiseTag(YAML::Node& node);
 	static std::shared_ptr<TransformComponent> DeserialiseTransform(YAML::Node& node, std::shared_ptr<Scene> scene);
 	static std::shared_ptr<MeshRendererComponent> DeserialiseMeshRenderer(YAML::Node& node);
+	static std::shared_ptr<LightComponent> DeserialiseLight(YAML::Node& node);
 private:
 	std::weak_ptr<Scene> scene;
 };
@@ -88,10 +132,18 @@ public:
 	std::weak_ptr<Mesh> mesh;
 
 	bool Serialise(std::string folder);
-	bool SerialiseVertex(YAML::Emitter& out, Vertex& vertex);
+	static bool SerialiseVertex(std::string& out, Vertex& vertex);
+	// the text of a mesh file
+	static std::string Format(const std::string& name, const std::string& uuid, const AABB& bounds, MeshData& data);
 
 	static void Deserialise(std::string path);
-	static Vertex&& DeserialiseVertex(YAML::Node& node);
+	// vertices and indices of a parsed mesh file, null when a vertex is malformed
+	static std::shared_ptr<MeshData> Parse(const YAML::Node& file, const std::string& path);
+	// gives a mesh file written before levels of detail existed its LODs and bounds, once, so loading
+	// never simplifies, false when the file could not be read or rewritten
+	static bool AddLods(std::string path);
+	// false when any attribute is missing or not the right number of floats
+	static bool DeserialiseVertex(const YAML::Node& node, Vertex& vertex);
 };
 
 class ModelSerialiser
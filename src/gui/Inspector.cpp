@@ -1,7 +1,8 @@
 #include "Inspector.h"
 
-static void DrawVec3Control(const std::string& label, glm::vec3& values, float resetValue = 0.0f, float columnWidth = 100.0f)
+static bool DrawVec3Control(const std::string& label, glm::vec3& values, float resetValue = 0.0f, float columnWidth = 100.0f)
 {
+	bool changed = false;
 	ImGuiIO& io = ImGui::GetIO();
 	auto boldFont = io.Fonts->Fonts[0];
 
@@ -23,12 +24,15 @@ static void DrawVec3Control(const std::string& label, glm::vec3& values, float r
 	ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4{ 0.8f, 0.1f, 0.15f, 1.0f });
 	ImGui::PushFont(boldFont);
 	if (ImGui::Button("X", buttonSize))
+	{
 		values.x = resetValue;
+		changed = true;
+	}
 	ImGui::PopFont();
 	ImGui::PopStyleColor(3);
 
 	ImGui::SameLine();
-	ImGui::DragFloat("##X", &values.x, 0.1f, 0.0f, 0.0f, "%.2f");
+	changed |= ImGui::DragFloat("##X", &values.x, 0.1f, 0.0f, 0.0f, "%.2f");
 	ImGui::PopItemWidth();
 	ImGui::SameLine();
 
@@ -37,12 +41,15 @@ static void DrawVec3Control(const std::string& label, glm::vec3& values, float r
 	ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4{ 0.2f, 0.7f, 0.2f, 1.0f });
 	ImGui::PushFont(boldFont);
 	if (ImGui::Button("Y", buttonSize))
+	{
 		values.y = resetValue;
+		changed = true;
+	}
 	ImGui::PopFont();
 	ImGui::PopStyleColor(3);
 
 	ImGui::SameLine();
-	ImGui::DragFloat("##Y", &values.y, 0.1f, 0.0f, 0.0f, "%.2f");
+	changed |= ImGui::DragFloat("##Y", &values.y, 0.1f, 0.0f, 0.0f, "%.2f");
 	ImGui::PopItemWidth();
 	ImGui::SameLine();
 
@@ -51,12 +58,15 @@ static void DrawVec3Control(const std::string& label, glm::vec3& values, float r
 	ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4{ 0.1f, 0.25f, 0.8f, 1.0f });
 	ImGui::PushFont(boldFont);
 	if (ImGui::Button("Z", buttonSize))
+	{
 		values.z = resetValue;
+		changed = true;
+	}
 	ImGui::PopFont();
 	ImGui::PopStyleColor(3);
 
 	ImGui::SameLine();
-	ImGui::DragFloat("##Z", &values.z, 0.1f, 0.0f, 0.0f, "%.2f");
+	changed |= ImGui::DragFloat("##Z", &values.z, 0.1f, 0.0f, 0.0f, "%.2f");
 	ImGui::PopItemWidth();
 
 	ImGui::PopStyleVar();
@@ -64,6 +74,7 @@ static void DrawVec3Control(const std::string& label, glm::vec3& values, float r
 	ImGui::Columns(1);
 
 	ImGui::PopID();
+	return changed;
 }
 
 
@@ -78,6 +89,8 @@ void Inspector::Update(float deltaTime, std::shared_ptr<Entity> entity)
 	ImGui::Separator();
 	DrawMeshRenderer(entity);
 	ImGui::Separator();
+	DrawLight(entity);
+	ImGui::Separator();
 	DrawAddComponent(entity);
 	ImGui::End();
 }
@@ -96,7 +109,10 @@ void Inspector::DrawTag(std::shared_ptr<Entity> entity)
 		ImGui::Text("Tag");
 		ImGui::SameLine();
 		ImGui::PushItemWidth(-1);
-		ImGui::InputText("##label", str, 128);
+		if (ImGui::InputText("##label", str, 128))
+		{
+			entity->MarkDirty();
+		}
 		ImGui::PopItemWidth();
 		tagComponent->name = str;
 	}
@@ -111,9 +127,13 @@ void Inspector::DrawTransform(std::shared_ptr<Entity> entity)
 		if (ImGui::TreeNodeEx("Transform Component"))
 		{
 			float width = ImGui::GetContentRegionAvail().x / 3.0f;
-			DrawVec3Control("Translation", transformComponent->translation, 0.0f, width);
-			DrawVec3Control("Rotation", transformComponent->rotation, 0.0f, width);
-			DrawVec3Control("Scale", transformComponent->scale, 1.0f, width);
+			bool changed = DrawVec3Control("Translation", transformComponent->translation, 0.0f, width);
+			changed |= DrawVec3Control("Rotation", transformComponent->rotation, 0.0f, width);
+			changed |= DrawVec3Control("Scale", transformComponent->scale, 1.0f, width);
+			if (changed)
+			{
+				entity->MarkDirty();
+			}
 			ImGui::TreePop();
 		}
 	}
@@ -124,6 +144,7 @@ void Inspector::DrawMaterial(std::shared_ptr<MaterialInstance> material)
 	if (ImGui::TreeNodeEx("Material"))
 	{
 		if (!material->modifiable) ImGui::BeginDisabled();
+		bool changed = false;
 		for (int i = 0; i < material->parameters.size(); i++)
 		{
 			MaterialAttribute& attribute = material->parameters[i];
@@ -142,12 +163,12 @@ void Inspector::DrawMaterial(std::shared_ptr<MaterialInstance> material)
 					//int index = renderer.textureMap[attribute.textureValue.lock()->uuid];
 					int index = resources.GetTextureIndex(attribute.textureValue.lock()->uuid);
 
-					ImGui::Combo(attribute.name.c_str(), &index, textureNames.data(), textureNames.size());
+					changed |= ImGui::Combo(attribute.name.c_str(), &index, textureNames.data(), textureNames.size());
 					attribute.textureValue = resources.textures[index];
 
 					float width = ImGui::GetContentRegionAvail().x;
 					float aspect = attribute.textureValue.lock()->size.x / attribute.textureValue.lock()->size.y;
-					ImGui::Image((void*)(attribute.textureValue.lock()->id), ImVec2(width, width / aspect));
+					ImGui::Image((ImTextureID)(intptr_t)attribute.textureValue.lock()->id, ImVec2(width, width / aspect));
 					ImGui::TreePop();
 				}
 				break;
@@ -159,19 +180,19 @@ void Inspector::DrawMaterial(std::shared_ptr<MaterialInstance> material)
 			case MaterialAttributeType::Vector2:
 				break;
 			case MaterialAttributeType::Vector3:
-				ImGui::DragFloat3(attribute.name.c_str(), &attribute.vector3Value.x);
+				changed |= ImGui::DragFloat3(attribute.name.c_str(), &attribute.vector3Value.x);
 				break;
 			case MaterialAttributeType::Vector4:
 				break;
 			case MaterialAttributeType::Mat4:
 				break;
 			case MaterialAttributeType::Color:
-				ImGui::ColorEdit3(attribute.name.c_str(), &attribute.vector3Value.x);
+				changed |= ImGui::ColorEdit3(attribute.name.c_str(), &attribute.vector3Value.x);
 				break;
 			case MaterialAttributeType::Bool:
 			{
 				bool b = attribute.intValue;
-				ImGui::Checkbox(attribute.name.c_str(), &b);
+				changed |= ImGui::Checkbox(attribute.name.c_str(), &b);
 				attribute.intValue = b;
 				break;
 			}
@@ -180,11 +201,46 @@ void Inspector::DrawMaterial(std::shared_ptr<MaterialInstance> material)
 			}
 					
 		}
+		if (changed)
+		{
+			material->dirty = true;
+		}
 		if (!material->modifiable) ImGui::EndDisabled();
 		ImGui::TreePop();
 	}
 }
 
+bool Inspector::DrawMaterialPicker(ResourceHandle<MaterialInstance>& material, std::string id)
+{
+	ResourceManager& resources = ResourceManager::GetSingleton();
+	std::vector<const AssetRecord*> records = AssetDatabase::GetSingleton().GetRecords(ResourceManager::ResourceType::Material);
+	std::string preview = material.IsLoaded() ? material.lock()->name : "";
+	for (auto record : records)
+	{
+		if (preview.empty() && record->uuid == material.GetId()) preview = std::filesystem::path(record->path).stem().string();
+	}
+
+	bool changed = false;
+	if (ImGui::BeginCombo(ImGui::GetUniqueName("Material Instance", id).c_str(), preview.c_str()))
+	{
+		for (auto record : records)
+		{
+			std::string name = std::filesystem::path(record->path).stem().string();
+			if (ImGui::Selectable(ImGui::GetUniqueName(name, record->uuid).c_str(), record->uuid == material.GetId()))
+			{
+				std::shared_ptr<MaterialInstance> picked = resources.GetMaterialInstance(record->uuid);
+				if (picked && record->uuid != material.GetId())
+				{
+					material = picked;
+					changed = true;
+				}
+			}
+		}
+		ImGui::EndCombo();
+	}
+	return changed;
+}
+
 void Inspector::DrawMesh(std::shared_ptr<Mesh> mesh)
 {
 	if (ImGui::TreeNodeEx("Mesh"))
@@ -209,6 +265,10 @@ void Inspector::DrawMeshRenderer(std::shared_ptr<Entity> entity)
 		{
 			//OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
 			ResourceManager& resources = ResourceManager::GetSingleton();
+			if (ImGui::Checkbox("Static", &meshRendererComponent->isStatic))
+			{
+				entity->MarkDirty();
+			}
 			for (int i = 0; i < meshRendererComponent->meshes.size(); i++)
 			{
 				std::string str = ImGui::GetUniqueName("Mesh", std::to_string(i));
@@ -217,6 +277,10 @@ void Inspector::DrawMeshRenderer(std::shared_ptr<Entity> entity)
 					std::shared_ptr<Mesh> mesh = meshRendererComponent->meshes[i].lock();
 					DrawMesh(mesh);
 
+					if (DrawMaterialPicker(meshRendererComponent->materials[i], str))
+					{
+						entity->MarkDirty();
+					}
 					std::shared_ptr<MaterialInstance> material = meshRendererComponent->materials[i].lock();
 					DrawMaterial(material);
 
@@ -232,13 +296,24 @@ void Inspector::DrawMeshRenderer(std::shared_ptr<Entity> entity)
 
 			if (ImGui::BeginPopup(str.c_str())) 
 			{
-				for (int i = 0; i < resources.meshes.size(); i++)
+				// every mesh in the project is listed, it is loaded once picked
+				for (auto record : AssetDatabase::GetSingleton().GetRecords(ResourceManager::ResourceType::Mesh))
 				{
-					if (ImGui::Selectable(ImGui::GetUniqueName(resources.meshes[i]->name.c_str(), resources.meshes[i]->uuid).c_str()))
+					std::string name = std::filesystem::path(record->path).stem().string();
+					if (ImGui::Selectable(ImGui::GetUniqueName(name, record->uuid).c_str()))
 					{
-						meshRendererComponent->meshes.push_back(resources.meshes[i]);
-
-						meshRendererComponent->materials.push_back(resources.materialInstances[0]);
+						std::shared_ptr<Mesh> mesh = resources.GetMesh(record->uuid);
+						// starts with a material that is already loaded, the first one on disk otherwise
+						std::shared_ptr<MaterialInstance> material = resources.materialInstances.empty() ? nullptr : resources.materialInstances[0];
+						std::vector<const AssetRecord*> materials = AssetDatabase::GetSingleton().GetRecords(ResourceManager::ResourceType::Material);
+						if (!material && !materials.empty()) material = resources.GetMaterialInstance(materials[0]->uuid);
+						if (mesh && material)
+						{
+							meshRendererComponent->meshes.push_back(mesh);
+
+							meshRendererComponent->materials.push_back(material);
+							entity->MarkDirty();
+						}
 						ImGui::CloseCurrentPopup();
 					}
 				}
@@ -249,6 +324,37 @@ void Inspector::DrawMeshRenderer(std::shared_ptr<Entity> entity)
 	}
 }
 
+void Inspector::DrawLight(std::shared_ptr<Entity> entity)
+{
+	LightComponent* lightComponent = entity->GetComponent<LightComponent>();
+	if (lightComponent)
+	{
+		if (ImGui::TreeNodeEx("Light Component"))
+		{
+			const char* types[] = { "Point", "Spot", "Directional" };
+			int type = (int)lightComponent->type;
+			bool changed = ImGui::Combo("Type", &type, types, 3);
+			lightComponent->type = (LightType)type;
+			changed |= ImGui::ColorEdit3("Color", &lightComponent->color.x);
+			changed |= ImGui::DragFloat("Intensity", &lightComponent->intensity, 0.1f, 0.0f, FLT_MAX);
+			if (lightComponent->type != LightType::Directional)
+			{
+				changed |= ImGui::DragFloat("Range", &lightComponent->range, 0.1f, 0.001f, FLT_MAX);
+			}
+			if (lightComponent->type == LightType::Spot)
+			{
+				changed |= ImGui::DragFloat("Inner Angle", &lightComponent->innerAngle, 0.1f, 0.0f, lightComponent->outerAngle);
+				changed |= ImGui::DragFloat("Outer Angle", &lightComponent->outerAngle, 0.1f, lightComponent->innerAngle, 179.0f);
+			}
+			if (changed)
+			{
+				entity->MarkDirty();
+			}
+			ImGui::TreePop();
+		}
+	}
+}
+
 void Inspector::DrawAddComponent(std::shared_ptr<Entity> entity)
 {
 	std::string str = ImGui::GetUniqueName("Add Component", entity->uuid);
@@ -260,6 +366,7 @@ void Inspector::DrawAddComponent(std::shared_ptr<Entity> entity)
 	if (ImGui::BeginPopup(str.c_str())) // <-- use last item id as popup id
 	{
 		DrawAddMeshRendererComponent(entity);
+		DrawAddLightComponent(entity);
 		ImGui::EndPopup();
 	}
 }
@@ -278,3 +385,16 @@ void Inspector::DrawAddMeshRendererComponent(std::shared_ptr<Entity> entity)
 	}
 }
 
+void Inspector::DrawAddLightComponent(std::shared_ptr<Entity> entity)
+{
+	LightComponent* lightComponent = entity->GetComponent<LightComponent>();
+	if (!lightComponent)
+	{
+		if (ImGui::Selectable(ImGui::GetUniqueName("Light", entity->uuid).c_str()))
+		{
+			entity->AddComponent(std::make_shared<LightComponent>());
+			ImGui::CloseCurrentPopup();
+		}
+	}
+}
+
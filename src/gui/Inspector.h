@@ -6,6 +6,8 @@
 #include "imgui_internal.h"
 #include "Resource.h"
 #include "ResourceManager.h"
+#include "AssetDatabase.h"
+#include <filesystem>
 
 class Inspector
 {
@@ -17,11 +19,15 @@ public:
 	void DrawTag(std::shared_ptr<Entity> entity);
 	void DrawTransform(std::shared_ptr<Entity> entity);
 	void DrawMaterial(std::shared_ptr<MaterialInstance> material);
+	// lists every material in the asset database, the picked one is loaded then, true when it changed
+	bool DrawMaterialPicker(ResourceHandle<MaterialInstance>& material, std::string id);
 	void DrawMesh(std::shared_ptr<Mesh> mesh);
 	void DrawMeshRenderer(std::shared_ptr<Entity> entity);
+	void DrawLight(std::shared_ptr<Entity> entity);
 
 	void DrawAddComponent(std::shared_ptr<Entity> entity);
 	void DrawAddMeshRendererComponent(std::shared_ptr<Entity> entity);
+	void DrawAddLightComponent(std::shared_ptr<Entity> entity);
 	template <typename T>
 	std::vector<char*> GetResourceNames(std::vector<std::shared_ptr<T>>& resources)
 	{
@@ -0,0 +1,67 @@
+#include "ProfilerWindow.h"
+
+void ProfilerWindow::Update([[maybe_unused]] float deltaTime)
+{
+	Profiler& profiler = Profiler::GetSingleton();
+	ImGui::Begin("Profiler");
+
+	ImGui::Checkbox("Enabled", &profiler.enabled);
+	ImGui::SameLine();
+	if (ImGui::Button("Dump CSV"))
+	{
+		profiler.WriteCSV(capturePath);
+	}
+	ImGui::Text("CPU %.3fms  GPU %.3fms  (dropped %llu)",
+		profiler.GetTotal(profiler.latest, "Pass", false),
+		profiler.GetTotal(profiler.latest, "Pass", true),
+		profiler.droppedFrames);
+
+	DrawHistory();
+	ImGui::Spacing(2);
+	DrawSamples("Pass");
+	ImGui::Spacing(2);
+	DrawSamples("Material");
+	ImGui::End();
+}
+
+void ProfilerWindow::DrawSamples(std::string category)
+{
+	Profiler& profiler = Profiler::GetSingleton();
+	if (ImGui::BeginTable(category.c_str(), 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		ImGui::TableSetupColumn(category.c_str());
+		ImGui::TableSetupColumn("Count");
+		ImGui::TableSetupColumn("CPU ms");
+		ImGui::TableSetupColumn("GPU ms");
+		ImGui::TableHeadersRow();
+		for (auto& sample : profiler.latest.samples)
+		{
+			if (sample.category != category) continue;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text(sample.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%d", sample.count);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", sample.cpuMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", sample.gpuMs);
+		}
+		ImGui::EndTable();
+	}
+}
+
+void ProfilerWindow::DrawHistory()
+{
+	Profiler& profiler = Profiler::GetSingleton();
+	std::vector<float> cpu(profiler.history.size());
+	std::vector<float> gpu(profiler.history.size());
+	for (size_t i = 0; i < profiler.history.size(); i++)
+	{
+		cpu[i] = profiler.GetTotal(profiler.history[i], "Pass", false);
+		gpu[i] = profiler.GetTotal(profiler.history[i], "Pass", true);
+	}
+	float width = ImGui::GetContentRegionAvail().x;
+	ImGui::PlotLines("##cpu", cpu.data(), cpu.size(), 0, "CPU ms", 0.0f, FLT_MAX, ImVec2(width, 60));
+	ImGui::PlotLines("##gpu", gpu.data(), gpu.size(), 0, "GPU ms", 0.0f, FLT_MAX, ImVec2(width, 60));
+}
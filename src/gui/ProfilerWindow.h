@@ -0,0 +1,13 @@
+#pragma once
+#include "GUI.h"
+#include "Profiler.h"
+
+class ProfilerWindow
+{
+public:
+	ProfilerWindow() = default;
+	void Update(float deltaTime);
+	void DrawSamples(std::string category);
+	void DrawHistory();
+	std::string capturePath = "profiler.csv";
+};
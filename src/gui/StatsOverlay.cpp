@@ -0,0 +1,62 @@
+#include "StatsOverlay.h"
+
+void StatsOverlay::Update([[maybe_unused]] float deltaTime, ImVec2 position)
+{
+	if (!visible) return;
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	RenderStats& stats = renderer.lastStats;
+
+	ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings
+		| ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDocking;
+	ImGui::SetNextWindowPos(ImVec2(position.x + 8, position.y + 8));
+	ImGui::SetNextWindowBgAlpha(0.35f);
+	if (ImGui::Begin("Render Stats", &visible, flags))
+	{
+		ImGui::Text("Draw calls:      %d", stats.drawCalls);
+		ImGui::Text("Triangles:       %lld", stats.triangles);
+		ImGui::Text("Culled:          %d", stats.culled);
+		ImGui::Text("Occluded:        %d", stats.occluded);
+		ImGui::Text("Lights:          %d", stats.lights);
+		ImGui::Text("Shadow casters:  %d", stats.shadowCasters);
+		ImGui::Text("Passes:          %d (%d culled)", stats.passes, stats.culledPasses);
+		if (renderer.dynamicResolution.enabled)
+		{
+			DynamicResolution& resolution = renderer.dynamicResolution;
+			if (renderer.antiAliasing == OpenGLRenderer::AntiAliasing::Temporal)
+			{
+				ImGui::Text("Resolution:      %.0f%% TAA (%.2fms GPU)", resolution.scale * 100.0f, resolution.gpuMs);
+			}
+			else
+			{
+				ImGui::Text("Resolution:      %.0f%% %dx MSAA (%.2fms GPU)", resolution.scale * 100.0f, resolution.GetSamples(), resolution.gpuMs);
+			}
+		}
+		ImGui::Text("State changes:   %d", stats.GetStateChanges());
+		ImGui::Text("  Programs:      %d", stats.programBinds);
+		ImGui::Text("  Textures:      %d", stats.textureBinds);
+		ImGui::Text("  Vertex arrays: %d", stats.vertexArrayBinds);
+		ImGui::Text("  Framebuffers:  %d", stats.framebufferBinds);
+		ImGui::Text("Redundant binds: %d", stats.redundantCalls);
+		ImGui::Text("Materials:       %d", stats.materialBinds);
+		ImGui::Text("Uniforms:        %d (%lld bytes)", stats.uniformUploads, stats.uniformBytes);
+		ImGui::Text("Buffer uploads:  %lld bytes", stats.bufferUploadBytes);
+		ResourceManager& resources = ResourceManager::GetSingleton();
+		ImGui::Text("Resident:        %zu / %zu KB", resources.GetMemoryUsage() / 1024, resources.memoryBudget / 1024);
+		DrawHistory();
+	}
+	ImGui::End();
+}
+
+void StatsOverlay::DrawHistory()
+{
+	OpenGLRenderer& renderer = OpenGLRenderer::GetSingleton();
+	std::vector<float> drawCalls(renderer.statsHistory.size());
+	std::vector<float> stateChanges(renderer.statsHistory.size());
+	for (size_t i = 0; i < renderer.statsHistory.size(); i++)
+	{
+		drawCalls[i] = renderer.statsHistory[i].drawCalls;
+		stateChanges[i] = renderer.statsHistory[i].GetStateChanges();
+	}
+	ImGui::PlotLines("##drawcalls", drawCalls.data(), drawCalls.size(), 0, "Draw calls", 0.0f, FLT_MAX, ImVec2(240, 40));
+	ImGui::PlotLines("##statechanges", stateChanges.data(), stateChanges.size(), 0, "State changes", 0.0f, FLT_MAX, ImVec2(240, 40));
+}
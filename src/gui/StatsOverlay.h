@@ -0,0 +1,13 @@
+#pragma once
+#include "GUI.h"
+#include "OpenGLRenderer.h"
+#include "ResourceManager.h"
+
+class StatsOverlay
+{
+public:
+	StatsOverlay() = default;
+	void Update(float deltaTime, ImVec2 position);
+	void DrawHistory();
+	bool visible = true;
+};